@@ -0,0 +1,317 @@
+/*****************************************************************************
+
+  bpbench.cpp @ Breakpointer
+  end-to-end benchmark on the data of simbam: runs breakpointer, breakmis
+  and breakvali (or breakvali.pl) one after the other, and reports for each stage the
+  wall time, the reads per second, the peak RSS and the recall of the
+  planted deletions and insertions (an event is found when a region of
+  the stage's output lies within a read length of one of its breakpoints)
+  together with the share of the regions that lie at a planted event.
+  It fails when a stage fails or its recall is below --min-recall, or
+  below the recall of a summary saved by an earlier run (--compare), so
+  that speed work can not silently cost sensitivity.
+
+  usage: bpbench -b BINDIR -p PREFIX [options] (see bpbench -h)
+
+  Breakpointer is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License.
+
+******************************************************************************/
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <string>
+#include <getopt.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+using namespace std;
+
+struct event {
+  string chr;
+  unsigned int start;
+  unsigned int end;
+  bool del;
+};
+
+struct stage {
+  string name;
+  string cmd;
+  string output;
+  unsigned long long reads;    // input reads of the stage
+  unsigned int chrcol;         // columns of the regions in the output
+  unsigned int startcol;
+  unsigned int endcol;
+  double wall;
+  long rss;                    // kb
+  int status;
+  unsigned int regions;
+  unsigned int near;           // regions at a planted breakpoint
+  unsigned int foundel, foundins;
+};
+
+inline double now();
+inline void usage(const char *name);
+inline void run_stage(struct stage &st);
+inline void recall(struct stage &st, const vector <struct event> &events, unsigned int tolerance);
+inline double stage_recall(const struct stage &st, unsigned int ndel, unsigned int nins);
+
+int main (int argc, char *argv[]) {
+
+  string bindir, prefix, outdir = ".", bpargs, bmargs, compare;
+  unsigned int readlen = 0;
+  double minrecall = 0;
+
+  const struct option long_options[] = {
+    {"bin",1,0,'b'},
+    {"prefix",1,0,'p'},
+    {"outdir",1,0,'o'},
+    {"readlen",1,0,'l'},
+    {"bpargs",1,0,'a'},
+    {"bmargs",1,0,'m'},
+    {"min-recall",1,0,'r'},
+    {"compare",1,0,'c'},
+    {"help",0,0,'h'},
+    {0,0,0,0}
+  };
+
+  int c;
+  while ((c = getopt_long_only(argc, argv, "hb:p:o:l:a:m:r:c:", long_options, NULL)) != -1) {
+    switch (c) {
+    case 'b': bindir    = optarg; break;
+    case 'p': prefix    = optarg; break;
+    case 'o': outdir    = optarg; break;
+    case 'l': readlen   = atoi(optarg); break;
+    case 'a': bpargs    = optarg; break;
+    case 'm': bmargs    = optarg; break;
+    case 'r': minrecall = atof(optarg); break;
+    case 'c': compare   = optarg; break;
+    default:  usage(argv[0]); exit(0);
+    }
+  }
+  if (bindir == "" || prefix == "") {
+    usage(argv[0]);
+    exit(1);
+  }
+
+  // the planted events and the read counts
+  vector <struct event> events;
+  unsigned long long nreads = 0, nunmapped = 0;
+  unsigned int minlen = 0, maxlen = 0, ndel = 0, nins = 0;
+  ifstream evf((prefix + ".events").c_str());
+  if (!evf) {
+    cerr << "can not read " << prefix << ".events, make it with simbam" << endl;
+    exit(1);
+  }
+  string line;
+  while (getline(evf, line)) {
+    istringstream ss(line);
+    if (line.compare(0, 6, "#reads") == 0) {
+      string key;
+      unsigned long long mapped, repeat;
+      ss >> key >> nreads >> key >> mapped >> key >> nunmapped >> key >> repeat >> key >> minlen >> maxlen;
+      continue;
+    }
+    if (line.empty() || line[0] == '#') continue;
+    struct event ev;
+    string type;
+    ss >> ev.chr >> ev.start >> ev.end >> type;
+    if (type != "DEL" && type != "INS") continue;   // repeats are no events
+    ev.del = (type == "DEL");
+    if (ev.del) ndel++;
+    else nins++;
+    events.push_back(ev);
+  }
+  if (nreads == 0) {
+    cerr << prefix << ".events has no read counts" << endl;
+    exit(1);
+  }
+
+  string bam = prefix + ".bam";
+  string base = outdir + "/bench";
+  ostringstream rl;
+  rl << readlen;
+  string op_readlen = (readlen != 0) ? " --readlen " + rl.str() : "";
+  ostringstream vl;
+  vl << (readlen != 0 ? readlen : minlen);     // breakvali scans the first readlen-24 seeds of a read
+
+  vector <struct stage> stages(3);
+  stages[0].name   = "breakpointer";
+  stages[0].cmd    = bindir + "/breakpointer --mapping " + bam + op_readlen + " " + bpargs + " >" + base + ".endskew 2>" + base + ".breakpointer.log";
+  stages[0].output = base + ".endskew";
+  stages[0].reads  = nreads;
+  stages[0].chrcol = 0; stages[0].startcol = 1; stages[0].endcol = 2;
+  stages[1].name   = "breakmis";
+  stages[1].cmd    = bindir + "/breakmis --region " + base + ".endskew --mapping " + bam + op_readlen + " " + bmargs + " >" + base + ".endskew.mis.gff 2>" + base + ".breakmis.log";
+  stages[1].output = base + ".endskew.mis.gff";
+  stages[1].reads  = nreads;
+  stages[1].chrcol = 0; stages[1].startcol = 3; stages[1].endcol = 4;
+  bool valibin = (access((bindir + "/breakvali").c_str(), X_OK) == 0);   // else the script
+  stages[2].name   = valibin ? "breakvali" : "breakvali.pl";
+  stages[2].cmd    = (valibin ? bindir + "/breakvali" : "perl " + bindir + "/breakvali.pl") + " --umr " + prefix + ".umr.fq --readlen " + vl.str() + " --ermis " + base + ".endskew.mis.gff >" + base + ".vali.gff 2>" + base + ".breakvali.log";
+  stages[2].output = base + ".vali.gff";
+  stages[2].reads  = nunmapped;
+  stages[2].chrcol = 0; stages[2].startcol = 3; stages[2].endcol = 4;
+
+  bool failed = false;
+  for (unsigned int s = 0; s < stages.size(); s++) {
+    stages[s].status = -1;
+    stages[s].wall   = 0;
+  }
+  for (unsigned int s = 0; s < stages.size(); s++) {
+    cerr << "running " << stages[s].cmd << endl;
+    run_stage(stages[s]);
+    if (stages[s].status != 0) {
+      cerr << stages[s].name << " failed with status " << stages[s].status << endl;
+      failed = true;
+      break;
+    }
+    recall(stages[s], events, maxlen);
+  }
+
+  // earlier recall to hold on to
+  map <string, double> before;
+  if (compare != "") {
+    ifstream cf(compare.c_str());
+    while (getline(cf, line)) {
+      if (line.empty() || line[0] == '#') continue;
+      istringstream ss(line);
+      string name;
+      double wall, rate, rss, regions, rec;
+      if (ss >> name >> wall >> rate >> rss >> regions >> rec) before[name] = rec;
+    }
+  }
+
+  string summary = base + ".summary.tsv";
+  FILE *sf = fopen(summary.c_str(), "w");
+  fprintf(stdout, "%-14s %10s %12s %12s %9s %8s %8s %8s %8s\n", "#stage", "wall(s)", "reads/s", "peakRSS(MB)", "regions", "at_event", "recall", "DEL", "INS");
+  if (sf != NULL) fprintf(sf, "#stage\twall\treads_per_s\tpeak_rss_mb\tregions\trecall\tat_event\tdel_found\tins_found\n");
+  for (unsigned int s = 0; s < stages.size(); s++) {
+    const struct stage &st = stages[s];
+    if (st.status != 0 || st.wall == 0) continue;
+    double rec = stage_recall(st, ndel, nins);
+    double at = (st.regions > 0) ? (double)st.near / st.regions : 0;
+    fprintf(stdout, "%-14s %10.2f %12.0f %12.1f %9u %8.3f %8.3f %4u/%-3u %4u/%-3u\n", st.name.c_str(), st.wall, st.reads / st.wall,
+            st.rss / 1024., st.regions, at, rec, st.foundel, ndel, st.foundins, nins);
+    if (sf != NULL) fprintf(sf, "%s\t%.3f\t%.0f\t%.1f\t%u\t%.4f\t%.4f\t%u\t%u\n", st.name.c_str(), st.wall, st.reads / st.wall,
+                            st.rss / 1024., st.regions, rec, at, st.foundel, st.foundins);
+    if (rec < minrecall) {
+      cerr << st.name << ": recall " << rec << " is below " << minrecall << endl;
+      failed = true;
+    }
+    if (before.count(st.name) && rec + 5e-5 < before[st.name]) {  // the summary has 4 decimals
+      cerr << st.name << ": recall " << rec << " dropped from " << before[st.name] << " in " << compare << endl;
+      failed = true;
+    }
+  }
+  if (sf != NULL) fclose(sf);
+  cerr << "summary written to " << summary << endl;
+
+  return failed ? 1 : 0;
+}
+
+inline double now() {
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+inline void usage(const char *name) {
+  fprintf(stdout, "\nbpbench (end-to-end benchmark on simbam data) @ BreakPointer\n\n");
+  fprintf(stdout, "Usage: %s options\n\n", name);
+  fprintf(stdout, "-b --bin        <string> directory with breakpointer, breakmis, breakvali (or breakvali.pl) and lib/.\n");
+  fprintf(stdout, "-p --prefix     <string> the simbam output prefix (PREFIX.bam, PREFIX.umr.fq, PREFIX.events).\n");
+  fprintf(stdout, "-o --outdir     <string> where the outputs and the summary go (default: .).\n");
+  fprintf(stdout, "-l --readlen    <int>    pass --readlen to the stages (default: variable read length).\n");
+  fprintf(stdout, "-a --bpargs     <string> more options for breakpointer, e.g. \"--engine prefix --threads 4\".\n");
+  fprintf(stdout, "-m --bmargs     <string> more options for breakmis.\n");
+  fprintf(stdout, "-r --min-recall <float>  fail when the recall of a stage is below this (default: 0).\n");
+  fprintf(stdout, "-c --compare    <string> fail when the recall of a stage is below the one in this earlier summary.\n");
+  fprintf(stdout, "-h --help                print the help message.\n\n");
+}
+
+inline void run_stage(struct stage &st) {  // wall time and peak RSS of the command
+
+  st.wall = 0;
+  st.rss  = 0;
+  double t0 = now();
+  pid_t pid = fork();
+  if (pid == 0) {
+    execl("/bin/sh", "sh", "-c", st.cmd.c_str(), (char *)NULL);
+    _exit(127);
+  }
+  int status = 0;
+  struct rusage ru;
+  if (pid < 0 || wait4(pid, &status, 0, &ru) < 0) {
+    st.status = -1;
+    return;
+  }
+  st.wall   = now() - t0;
+  st.rss    = ru.ru_maxrss;
+  st.status = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+}
+
+inline void recall(struct stage &st, const vector <struct event> &events, unsigned int tolerance) {
+
+  map <string, vector <unsigned int> > bps;  // planted breakpoints of each chromosome, sorted
+  for (unsigned int e = 0; e < events.size(); e++) {
+    bps[events[e].chr].push_back(events[e].start);
+    bps[events[e].chr].push_back(events[e].end);
+  }
+  for (map <string, vector <unsigned int> >::iterator it = bps.begin(); it != bps.end(); it++) {
+    sort(it->second.begin(), it->second.end());
+  }
+
+  map <string, vector < pair<unsigned int, unsigned int> > > regions;
+  st.regions = 0;
+  st.near    = 0;
+  ifstream in(st.output.c_str());
+  string line;
+  while (getline(in, line)) {
+    if (line.empty() || line[0] == '#') continue;
+    vector <string> cols;
+    istringstream ss(line);
+    string col;
+    while (getline(ss, col, '\t')) cols.push_back(col);
+    if (cols.size() <= st.endcol) continue;
+    unsigned int start = atoi(cols[st.startcol].c_str());
+    unsigned int end   = atoi(cols[st.endcol].c_str());
+    regions[cols[st.chrcol]].push_back(make_pair(start, end));
+    st.regions++;
+    const vector <unsigned int> &b = bps[cols[st.chrcol]];
+    vector <unsigned int>::const_iterator next = lower_bound(b.begin(), b.end(), (start > tolerance) ? start - tolerance : 0);
+    if (next != b.end() && *next <= end + tolerance) st.near++;
+  }
+
+  st.foundel  = 0;
+  st.foundins = 0;
+  for (unsigned int e = 0; e < events.size(); e++) {
+    const struct event &ev = events[e];
+    const vector < pair<unsigned int, unsigned int> > &rs = regions[ev.chr];
+    unsigned int ends[2] = {ev.start, ev.end};
+    bool found = false;
+    for (unsigned int b = 0; b < 2 && !found; b++) {
+      unsigned int lo = (ends[b] > tolerance) ? ends[b] - tolerance : 0;
+      unsigned int hi = ends[b] + tolerance;
+      for (unsigned int r = 0; r < rs.size() && !found; r++) {
+        found = (rs[r].first <= hi && rs[r].second >= lo);
+      }
+    }
+    if (found && ev.del) st.foundel++;
+    if (found && !ev.del) st.foundins++;
+  }
+}
+
+inline double stage_recall(const struct stage &st, unsigned int ndel, unsigned int nins) {
+  if (ndel + nins == 0) return 1;
+  return (double)(st.foundel + st.foundins) / (ndel + nins);
+}
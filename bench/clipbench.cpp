@@ -0,0 +1,133 @@
+/*****************************************************************************
+
+  clipbench.cpp @ Breakpointer
+  per-read cost of the quality clipping: the old per base loop, comparing
+  the encoding name for every base, against qual_trim of qualclip.h. Both
+  must give the same clipleft / clipright on every read, for the three
+  encodings and read lengths of 36-250bp with low quality stretches.
+
+  usage: clipbench [reads (default 2000000)]
+
+  Breakpointer is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License.
+
+******************************************************************************/
+
+#include <iostream>
+#include <cstdlib>
+#include <cstdio>
+#include <vector>
+#include <string>
+#include <sys/time.h>
+#include "qualclip.h"
+
+using namespace std;
+
+inline double now() {
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+inline bool old_clip(const string &qual_clip, const string &read_qual, unsigned int real_length, unsigned int &clipleft, unsigned int &clipright) {
+
+  // mismatch.h before qualclip.h
+  clipleft = 10000;
+  clipright = 10000;
+  unsigned int qpos = 0;
+  unsigned int qsize = 0;
+  for (; qpos < real_length; qpos++){
+    int qual_now;
+    if (qual_clip == "phred33")  qual_now = int(read_qual[qpos]) - 33;
+    else if (qual_clip == "phred64")  qual_now = int(read_qual[qpos]) - 64;
+    else if (qual_clip == "solexa64") qual_now = int(read_qual[qpos]) - 64;
+    else qual_now = int(read_qual[qpos]) - 33;
+
+    if (qual_now >= 5) {
+      qsize++;
+      if (qsize >= 5) {
+        if (clipleft == 10000) {clipleft = (qpos + 1) - qsize;}
+        clipright = real_length - (qpos + 1);
+      }
+    }
+    else
+      qsize = 0;
+  }
+  if (clipleft == 10000)  clipleft  = real_length;
+  if (clipright == 10000) clipright = real_length;
+  return (clipleft != 0 || clipright != 0);
+}
+
+int main (int argc, char *argv[]) {
+
+  unsigned int nreads = (argc > 1) ? atoi(argv[1]) : 2000000;
+  const unsigned int distinct = 8192;  // reads cycled through
+  const char *encodings[3] = {"phred33", "phred64", "solexa64"};
+  const unsigned int lengths[5] = {36, 64, 76, 100, 250};
+
+  srand(17);
+  int failed = 0;
+  for (unsigned int e = 0; e < 3; e++) {
+
+    int offset = (e == 0) ? 33 : 64;
+    vector <string> quals(distinct);
+    for (unsigned int i = 0; i < distinct; i++) {
+      unsigned int len = lengths[rand() % 5];
+      string &q = quals[i];
+      q.resize(len);
+      for (unsigned int j = 0; j < len; j++) q[j] = offset + 5 + rand() % 35;
+      unsigned int bad = rand() % 6;          // low quality stretches, also at the ends
+      for (unsigned int b = 0; b < bad; b++) {
+        unsigned int at = rand() % len, n = 1 + rand() % 12;
+        for (unsigned int j = at; j < len && j < at + n; j++) q[j] = offset + rand() % 5;
+      }
+      if (rand() % 64 == 0) q.assign(len, (char)0xff);  // qualities not stored
+    }
+
+    string qual_clip = encodings[e];
+    int minqual = qual_min(qual_clip);
+
+    double t0 = now();
+    unsigned long long sum_old = 0;
+    for (unsigned int i = 0; i < nreads; i++) {
+      const string &q = quals[i % distinct];
+      unsigned int cl, cr;
+      old_clip(qual_clip, q, q.size(), cl, cr);
+      sum_old += cl + cr;
+    }
+    double t1 = now();
+
+    unsigned long long sum_new = 0;
+    for (unsigned int i = 0; i < nreads; i++) {
+      const string &q = quals[i % distinct];
+      unsigned int cl, cr;
+      qual_trim(q.data(), q.size(), minqual, cl, cr);
+      sum_new += cl + cr;
+    }
+    double t2 = now();
+
+    for (unsigned int i = 0; i < distinct; i++) {
+      const string &q = quals[i];
+      unsigned int cl1, cr1, cl2, cr2;
+      bool s1 = old_clip(qual_clip, q, q.size(), cl1, cr1);
+      bool s2 = qual_trim(q.data(), q.size(), minqual, cl2, cr2);
+      if (s1 != s2 || cl1 != cl2 || cr1 != cr2) {
+        fprintf(stderr, "ERROR: %s read %u: old %u,%u new %u,%u\n", encodings[e], i, cl1, cr1, cl2, cr2);
+        failed = 1;
+        break;
+      }
+    }
+
+    printf("%-9s old %8.1f ns/read   qualclip.h %8.1f ns/read   (checksums %llu %llu)\n", encodings[e],
+           (t1 - t0) * 1e9 / nreads, (t2 - t1) * 1e9 / nreads, sum_old, sum_new);
+  }
+
+#if defined(__AVX2__)
+  printf("kernel: AVX2\n");
+#elif defined(__SSE2__)
+  printf("kernel: SSE2\n");
+#else
+  printf("kernel: scalar\n");
+#endif
+  return failed;
+}
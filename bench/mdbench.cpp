@@ -0,0 +1,192 @@
+/*****************************************************************************
+
+  mdbench.cpp @ Breakpointer
+  per-read cost of decoding the mismatch tag: the old GetTag copy, split
+  into a vector <string> and atoi, against md_find / md_parse of mdtag.h
+  over the raw tag bytes. Reads with 0, 1 and 5-8 mismatches are timed
+  separately, a few of them with a deletion run.
+
+  usage: mdbench [reads per class (default 2000000)] [read length (default 100)]
+
+  Breakpointer is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License.
+
+******************************************************************************/
+
+#include <iostream>
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include <algorithm>
+#include <string>
+#include <sstream>
+#include <sys/time.h>
+#include "strutil.h"
+#include "mdtag.h"
+
+using namespace std;
+
+struct cigop {
+  char Type;
+  unsigned int Length;
+};
+
+struct simread {
+  string tags;                 // raw tag block: NM, MD and XT
+  vector <struct cigop> cigar;
+  unsigned int length;
+  bool deletion;
+};
+
+inline double now() {
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+inline void sim_read(struct simread &rd, unsigned int length, unsigned int nmis, bool deletion) {
+
+  // mismatch offsets in the read, ascending, and a deletion somewhere in the middle
+  vector <unsigned int> mis;
+  for (unsigned int i = 0; i < nmis; i++) mis.push_back(rand() % length);
+  sort(mis.begin(), mis.end());
+  mis.erase(unique(mis.begin(), mis.end()), mis.end());
+  unsigned int delat = length / 2 + rand() % 10;
+  unsigned int dellen = 1 + rand() % 4;
+
+  string md;
+  unsigned int run = 0;
+  unsigned int m = 0;
+  for (unsigned int q = 0; q < length; q++) {
+    if (deletion && q == delat) {
+      md += int2str(run) + "^" + string(dellen, "ACGT"[rand() % 4]);
+      run = 0;
+    }
+    if (m < mis.size() && mis[m] == q) {
+      md += int2str(run);
+      md += "ACGT"[rand() % 4];
+      run = 0;
+      m++;
+    }
+    else run++;
+  }
+  md += int2str(run);
+
+  rd.tags.clear();
+  rd.tags.append("NMc", 3);
+  rd.tags += (char)(mis.size() + (deletion ? dellen : 0));
+  rd.tags.append("MDZ", 3);
+  rd.tags.append(md.c_str(), md.size() + 1);
+  rd.tags.append("XTAU", 4);
+
+  rd.cigar.clear();
+  struct cigop op = {'M', length};
+  if (deletion) {
+    op.Length = delat;
+    rd.cigar.push_back(op);
+    struct cigop del = {'D', dellen};
+    rd.cigar.push_back(del);
+    op.Length = length - delat;
+  }
+  rd.cigar.push_back(op);
+  rd.length = length;
+  rd.deletion = deletion;
+}
+
+inline bool tag_copy(const string &tags, const char *tag, string &value) {
+  // what GetTag(string) does: find the tag and copy its value out
+  const char *p = md_find(tags, tag);
+  if (p == NULL) return false;
+  value = p;
+  return true;
+}
+
+int main (int argc, char *argv[]) {
+
+  unsigned int nreads = (argc > 1) ? atoi(argv[1]) : 2000000;
+  unsigned int length = (argc > 2) ? atoi(argv[2]) : 100;
+  const unsigned int distinct = 4096;  // reads cycled through per class
+
+  srand(13);
+  const char *names[3] = {"0 mismatches", "1 mismatch", "5-8 mismatches"};
+  int failed = 0;
+
+  for (unsigned int c = 0; c < 3; c++) {
+
+    vector <struct simread> reads(distinct);
+    for (unsigned int i = 0; i < distinct; i++) {
+      unsigned int nmis = (c == 0) ? 0 : (c == 1) ? 1 : 5 + rand() % 4;
+      sim_read(reads[i], length, nmis, i % 16 == 0);
+    }
+
+    // old: copy the tag, split on the bases, atoi each piece
+    double t0 = now();
+    unsigned long long sum_old = 0;
+    for (unsigned int i = 0; i < nreads; i++) {
+      const struct simread &rd = reads[i % distinct];
+      string MD;
+      vector <string> tagMD;
+      if (tag_copy(rd.tags, "MD", MD)) {
+        splitstring(MD, tagMD, "ACGTN^");
+        if (tagMD.size() > 1) {
+          tagMD.pop_back();
+          unsigned int pos = 0;
+          vector <string>::iterator mditer = tagMD.begin();
+          for (; mditer != tagMD.end(); mditer++) {
+            pos += (atoi((*mditer).c_str()) + 1);
+            sum_old += pos;
+          }
+        }
+      }
+    }
+    double t1 = now();
+
+    // mdtag.h: one pass over the raw bytes into a reused buffer
+    unsigned long long sum_new = 0;
+    vector <struct mdhit> hits;
+    for (unsigned int i = 0; i < nreads; i++) {
+      const struct simread &rd = reads[i % distinct];
+      const char *MD = md_find(rd.tags, "MD");
+      if (MD != NULL) md_parse(MD, rd.cigar, hits);
+      else hits.clear();
+      vector <struct mdhit>::const_iterator hit = hits.begin();
+      for (; hit != hits.end(); hit++) sum_new += hit->qpos;
+    }
+    double t2 = now();
+
+    // the two agree on reads without a deletion; with one, the old offsets are off after it
+    for (unsigned int i = 0; i < distinct; i++) {
+      const struct simread &rd = reads[i];
+      if (rd.deletion) continue;
+      string MD;
+      vector <string> tagMD;
+      vector <unsigned int> old;
+      tag_copy(rd.tags, "MD", MD);
+      splitstring(MD, tagMD, "ACGTN^");
+      if (tagMD.size() > 1) {
+        tagMD.pop_back();
+        unsigned int pos = 0;
+        for (unsigned int j = 0; j < tagMD.size(); j++) {
+          pos += atoi(tagMD[j].c_str()) + 1;
+          old.push_back(pos);
+        }
+      }
+      md_parse(md_find(rd.tags, "MD"), rd.cigar, hits);
+      bool same = (old.size() == hits.size());
+      for (unsigned int j = 0; same && j < old.size(); j++) {
+        same = (old[j] == hits[j].qpos && old[j] == hits[j].rpos + 1);
+      }
+      if (!same) {
+        fprintf(stderr, "ERROR: the decoders disagree on %s\n", md_find(rd.tags, "MD"));
+        failed = 1;
+        break;
+      }
+    }
+
+    printf("%-16s old %8.1f ns/read   mdtag.h %8.1f ns/read   (checksums %llu %llu)\n", names[c],
+           (t1 - t0) * 1e9 / nreads, (t2 - t1) * 1e9 / nreads, sum_old, sum_new);
+  }
+
+  return failed;
+}
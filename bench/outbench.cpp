@@ -0,0 +1,236 @@
+/*****************************************************************************
+
+  outbench.cpp @ Breakpointer
+  per-line cost of the text output: the --indiprint trace and the region
+  lines as fprintf to an unbuffered stderr and printf, and the gff line as
+  a tag of int2str / flo2str stringstreams written to an ostream with endl,
+  against the formatting of outbuf.h into an outfile. The old and the new
+  text of every line must be the same (checked in memory first), the
+  timed runs write to /dev/null.
+
+  usage: outbench [lines (default 1000000)]
+
+  Breakpointer is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License.
+
+******************************************************************************/
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <cstdlib>
+#include <cstdio>
+#include <vector>
+#include <string>
+#include <sys/time.h>
+#include "strutil.h"
+#include "outbuf.h"
+
+using namespace std;
+
+struct line {
+  string chr;
+  unsigned int start, end, depth, deps, depe, coverage, mismatch, realmis;
+  float ratio1, ratio2, fscore, confi, mirate;
+  double score;
+};
+
+inline double now() {
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+inline void old_gff(ostream &out, line &l) {
+
+  // mismatch.h before outbuf.h
+  string chrom = l.chr;
+  unsigned int dis = l.end - l.start + 1;
+  string tag = "ID="+chrom+":"+int2str(l.start)+";SIZE="+int2str(dis)+";DEPTH="+int2str(l.coverage)+";EndsRatio="+flo2str(l.ratio1)+";StartsRatio="+flo2str(l.ratio2)+";BinomialScore="+flo2str(l.fscore)+";MIS="+int2str(l.mismatch)+";realMIS="+int2str(l.realmis)+";MISRATE="+flo2str(l.mirate)+";seedseq=RME";
+  out << chrom <<"\t"<< "Breakpointer" <<"\t"<< "Depth-Skewed" <<"\t"<< l.start <<"\t"<< l.end <<"\t"<< setprecision(3) << l.confi <<"\t"<< "+" <<"\t"<< "." <<"\t"<< tag << endl;
+}
+
+inline void new_gff(string &out, const line &l) {
+  out += l.chr;
+  out += "\tBreakpointer\tDepth-Skewed\t";
+  out_uint(out, l.start);
+  out += '\t';
+  out_uint(out, l.end);
+  out += '\t';
+  out_general(out, l.confi, 3);
+  out += "\t+\t.\tID=";
+  out += l.chr;
+  out += ':';
+  out_uint(out, l.start);
+  out += ";SIZE=";
+  out_uint(out, l.end - l.start + 1);
+  out += ";DEPTH=";
+  out_uint(out, l.coverage);
+  out += ";EndsRatio=";
+  out_general(out, l.ratio1, 6);
+  out += ";StartsRatio=";
+  out_general(out, l.ratio2, 6);
+  out += ";BinomialScore=";
+  out_general(out, l.fscore, 6);
+  out += ";MIS=";
+  out_uint(out, l.mismatch);
+  out += ";realMIS=";
+  out_uint(out, l.realmis);
+  out += ";MISRATE=";
+  out_general(out, l.mirate, 6);
+  out += ";seedseq=RME\n";
+}
+
+inline void new_trace(string &out, const line &l) {
+  out += l.chr;
+  out += '\t';
+  out_int(out, (int)l.start);
+  out += '\t';
+  out_int(out, (int)l.end);
+  out += '\t';
+  out_int(out, (int)l.depth);
+  out += '\t';
+  out_int(out, (int)l.deps);
+  out += '\t';
+  out_int(out, (int)l.depe);
+  out += '\t';
+  out_fixed(out, l.ratio1, 3);
+  out += '\t';
+  out_fixed(out, l.ratio2, 3);
+  out += '\t';
+  out_fixed(out, l.score, 5);
+  out += '\n';
+}
+
+inline void new_region(string &out, const line &l) {
+  out += l.chr;
+  out += '\t';
+  out_int(out, (int)l.start);
+  out += '\t';
+  out_int(out, (int)l.end);
+  out += '\t';
+  out_int(out, (int)(l.end - l.start + 1));
+  out += '\t';
+  out_fixed(out, (float)l.depth, 3);
+  out += '\t';
+  out_fixed(out, l.ratio1, 3);
+  out += '\t';
+  out_fixed(out, l.ratio2, 3);
+  out += '\t';
+  out_fixed(out, l.fscore, 3);
+  out += '\n';
+}
+
+int main(int argc, char *argv[]) {
+
+  unsigned int nlines = (argc > 1) ? atoi(argv[1]) : 1000000;
+  srand(11);
+
+  vector <line> lines(nlines);
+  const char *chrs[] = {"chr1", "chr2", "chrX", "GL000192.1"};
+  for (unsigned int i = 0; i < nlines; i++) {
+    line &l = lines[i];
+    l.chr      = chrs[rand() % 4];
+    l.start    = 1 + rand() % 250000000;
+    l.end      = l.start + 19 + rand() % 200;
+    l.depth    = 2 + rand() % 300;
+    l.deps     = rand() % l.depth;
+    l.depe     = rand() % l.depth;
+    l.coverage = l.depth * (1 + rand() % 5);
+    l.mismatch = rand() % 80;
+    l.realmis  = rand() % 10;
+    l.ratio1   = (float)(l.deps + l.depe) / l.depth;
+    l.ratio2   = (l.deps + l.depe > 0) ? (float)l.deps / (l.deps + l.depe) : 0.f;
+    l.score    = 1. + (rand() % 1000000) / 7919.;
+    l.fscore   = l.score;
+    l.confi    = (rand() % 100000) / 97.f;
+    l.mirate   = (rand() % 64 == 0) ? (float)l.mismatch / 0.f : (float)l.mismatch / (l.coverage * l.ratio1);
+  }
+
+  // the same text first
+  int failed = 0;
+  for (unsigned int i = 0; i < nlines && !failed; i++) {
+    line &l = lines[i];
+    char buf[512];
+    string a, b;
+    snprintf(buf, sizeof(buf), "%s\t%d\t%d\t%d\t%d\t%d\t%.3f\t%.3f\t%.5f\n", l.chr.c_str(), l.start, l.end,
+             l.depth, l.deps, l.depe, l.ratio1, l.ratio2, l.score);
+    a = buf;
+    new_trace(b, l);
+    float depth = l.depth;
+    snprintf(buf, sizeof(buf), "%s\t%d\t%d\t%d\t%.3f\t%.3f\t%.3f\t%.3f\n", l.chr.c_str(), l.start, l.end,
+             l.end - l.start + 1, depth, l.ratio1, l.ratio2, l.fscore);
+    a += buf;
+    new_region(b, l);
+    ostringstream o;
+    old_gff(o, l);
+    a += o.str();
+    new_gff(b, l);
+    if (a != b) {
+      fprintf(stderr, "ERROR: line %u:\n%s--\n%s", i, a.c_str(), b.c_str());
+      failed = 1;
+    }
+  }
+
+  FILE *err = fopen("/dev/null", "w");
+  setvbuf(err, NULL, _IONBF, 0);       // as stderr
+  FILE *out = fopen("/dev/null", "w");
+  ofstream gff("/dev/null");
+
+  double t0 = now();
+  for (unsigned int i = 0; i < nlines; i++) {
+    line &l = lines[i];
+    fprintf(err, "%s\t%d\t%d\t%d\t%d\t%d\t%.3f\t%.3f\t%.5f\n", l.chr.c_str(), l.start, l.end,
+            l.depth, l.deps, l.depe, l.ratio1, l.ratio2, l.score);
+  }
+  double t1 = now();
+  for (unsigned int i = 0; i < nlines; i++) {
+    line &l = lines[i];
+    float depth = l.depth;
+    fprintf(out, "%s\t%d\t%d\t%d\t%.3f\t%.3f\t%.3f\t%.3f\n", l.chr.c_str(), l.start, l.end,
+            l.end - l.start + 1, depth, l.ratio1, l.ratio2, l.fscore);
+  }
+  double t2 = now();
+  for (unsigned int i = 0; i < nlines; i++) old_gff(gff, lines[i]);
+  double t3 = now();
+
+  struct outfile of;
+  outfile_open(of, out, false);
+  double t4 = now();
+  for (unsigned int i = 0; i < nlines; i++) {
+    new_trace(of.buf, lines[i]);
+    outfile_check(of);
+  }
+  double t5 = now();
+  for (unsigned int i = 0; i < nlines; i++) {
+    new_region(of.buf, lines[i]);
+    outfile_check(of);
+  }
+  double t6 = now();
+  for (unsigned int i = 0; i < nlines; i++) {
+    new_gff(of.buf, lines[i]);
+    outfile_check(of);
+  }
+  outfile_close(of);
+  double t7 = now();
+
+  struct outfile oz;
+  outfile_open(oz, out, true);
+  double t8 = now();
+  for (unsigned int i = 0; i < nlines; i++) {
+    new_gff(oz.buf, lines[i]);
+    outfile_check(oz);
+  }
+  outfile_close(oz);
+  double t9 = now();
+
+  double n = nlines / 1e9;
+  printf("trace   fprintf(stderr) %8.1f ns/line   outbuf.h %8.1f ns/line\n", (t1 - t0) / n, (t5 - t4) / n);
+  printf("region  printf          %8.1f ns/line   outbuf.h %8.1f ns/line\n", (t2 - t1) / n, (t6 - t5) / n);
+  printf("gff     ostream, endl   %8.1f ns/line   outbuf.h %8.1f ns/line   bgzip %8.1f ns/line\n", (t3 - t2) / n, (t7 - t6) / n, (t9 - t8) / n);
+
+  fclose(err);
+  fclose(out);
+  return failed;
+}
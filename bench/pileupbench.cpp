@@ -0,0 +1,142 @@
+/*****************************************************************************
+
+  pileupbench.cpp @ Breakpointer
+  per-read cost of the piling-up read filter: the old string keys in a
+  std::set / std::map against the packed keys of pileup.h.
+
+  usage: pileupbench [reads (default 20000000)] [mean reads per start (default 4)]
+
+  Breakpointer is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License.
+
+******************************************************************************/
+
+#include <iostream>
+#include <cstdlib>
+#include <cstdio>
+#include <vector>
+#include <set>
+#include <map>
+#include <string>
+#include <sstream>
+#include <sys/time.h>
+#include "pileup.h"
+
+using namespace std;
+
+struct simread {
+  unsigned int start;
+  unsigned int end;
+  bool reverse;
+};
+
+inline string int2str(unsigned int &i){
+  string s;
+  stringstream ss(s);
+  ss << i;
+  return ss.str();
+}
+
+inline double now() {
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+int main (int argc, char *argv[]) {
+
+  unsigned int nreads = (argc > 1) ? atoi(argv[1]) : 20000000;
+  unsigned int perstart = (argc > 2) ? atoi(argv[2]) : 4;
+
+  // a coordinate sorted stream with a few exact duplicates per start
+  vector <struct simread> reads(nreads);
+  srand(11);
+  unsigned int pos = 10000;
+  for (unsigned int i = 0; i < nreads; i++) {
+    if (rand() % perstart == 0) pos += 1 + rand() % 3;
+    reads[i].start   = pos;
+    reads[i].end     = pos + 99 - (rand() % 4 == 0 ? rand() % 30 : 0);
+    reads[i].reverse = rand() % 2;
+  }
+
+  // breakpointer: std::set <string>
+  double t0 = now();
+  unsigned int kept_set = 0;
+  {
+    set <string> pileup;
+    unsigned int oldstart = 0;
+    for (unsigned int i = 0; i < nreads; i++) {
+      unsigned int s = reads[i].start, e = reads[i].end;
+      string strand = reads[i].reverse ? "-" : "+";
+      string alignSum = int2str(s) + int2str(e) + strand;
+      if (s != oldstart) {
+        pileup.clear();
+        pileup.insert(alignSum);
+      }
+      else {
+        if (pileup.count(alignSum)) continue;
+        else pileup.insert(alignSum);
+      }
+      oldstart = s;
+      kept_set++;
+    }
+  }
+  double t1 = now();
+
+  // breakmis: std::map <string, unsigned int>
+  unsigned int kept_map = 0;
+  {
+    map <string, unsigned int> pileup;
+    unsigned int oldstart = 0;
+    for (unsigned int i = 0; i < nreads; i++) {
+      unsigned int s = reads[i].start, e = reads[i].end;
+      string strand = reads[i].reverse ? "-" : "+";
+      string alignSum = int2str(s) + int2str(e) + strand;
+      if (s != oldstart) {
+        pileup.clear();
+        pileup.insert(map<string, unsigned int>::value_type(alignSum, 1));
+      }
+      else {
+        if (pileup.count(alignSum)) continue;
+        pileup.insert(map<string, unsigned int>::value_type(alignSum, 1));
+      }
+      oldstart = s;
+      kept_map++;
+    }
+  }
+  double t2 = now();
+
+  // pileup.h: packed keys, flat table
+  unsigned int kept_packed = 0;
+  {
+    struct pileup pileup;
+    pileup_init(pileup, 64);
+    unsigned int oldstart = 0;
+    for (unsigned int i = 0; i < nreads; i++) {
+      unsigned int s = reads[i].start, e = reads[i].end;
+      uint64_t alignSum = pileup_key(s, e, reads[i].reverse);
+      if (s != oldstart) {
+        pileup_clear(pileup);
+        pileup_insert(pileup, alignSum, 1);
+      }
+      else {
+        if (pileup_find(pileup, alignSum)) continue;
+        pileup_insert(pileup, alignSum, 1);
+      }
+      oldstart = s;
+      kept_packed++;
+    }
+  }
+  double t3 = now();
+
+  printf("reads: %u, kept: %u %u %u\n", nreads, kept_set, kept_map, kept_packed);
+  printf("set<string>        %8.1f ns/read\n", (t1 - t0) * 1e9 / nreads);
+  printf("map<string,uint>   %8.1f ns/read\n", (t2 - t1) * 1e9 / nreads);
+  printf("packed pileup.h    %8.1f ns/read\n", (t3 - t2) * 1e9 / nreads);
+
+  if (kept_set != kept_packed || kept_map != kept_packed) {
+    fprintf(stderr, "ERROR: the filters disagree\n");
+    return 1;
+  }
+  return 0;
+}
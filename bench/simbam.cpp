@@ -0,0 +1,580 @@
+/*****************************************************************************
+
+  simbam.cpp @ Breakpointer
+  a simulated genome with planted deletions, insertions longer than the
+  reads and repeats, sequenced as single end reads and written as a
+  coordinate sorted BAM with MD, NM and XT (or NH) tags. A read is placed
+  by its longest stretch of the reference and compared base by base, so
+  reads across a breakpoint carry the mismatches an aligner would report
+  at their ends. Reads with too many mismatches, and the reads inside an
+  insertion, are unmapped: they go to the end of the BAM and to a fastq
+  file for breakvali. The planted events go to PREFIX.events for bpbench.
+
+  usage: simbam [options] (see simbam -h)
+  output: PREFIX.bam, PREFIX.umr.fq, PREFIX.events
+
+  Breakpointer is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License.
+
+******************************************************************************/
+
+#include <iostream>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <stdint.h>
+#include <getopt.h>
+#include <zlib.h>
+
+using namespace std;
+
+struct simopt {
+  string out;
+  unsigned int chroms;
+  unsigned int chrlen;
+  double coverage;
+  vector <unsigned int> lengths;
+  unsigned int deletions;      // per chromosome
+  unsigned int insertions;
+  unsigned int repeats;        // repeat families per chromosome
+  string tag;                  // XT (bwa) or NH
+  double error;
+  unsigned int maxmis;         // mismatches a mapped read may have
+  unsigned long long seed;
+  unsigned int blocksize;      // uncompressed bytes per BGZF block, 0 for 0xff00 (and no padded header)
+};
+
+struct event {
+  unsigned int pos;            // 0-based: a deletion removes [pos, pos+len), an insertion goes before pos
+  unsigned int len;
+  bool del;
+  string seq;                  // the inserted bases
+};
+
+struct repeat {
+  vector <unsigned int> copies;  // 0-based starts of the copies
+  unsigned int len;
+};
+
+struct rec {
+  uint32_t refid;              // -1 (unmapped) sorts last
+  int32_t pos;
+  size_t offset;               // in the record arena
+  uint32_t size;
+};
+
+struct bgzfout {
+  FILE *fp;
+  vector <char> buf;
+  size_t blocksize;
+  z_stream zs;
+};
+
+unsigned long long rng_state = 1;
+
+inline unsigned long long rnd();
+inline unsigned int rnd_below(unsigned int n);
+inline double rnd_unit();
+inline void usage(const char *name);
+inline bool place(vector < pair<unsigned int, unsigned int> > &used, unsigned int len, unsigned int chrlen, unsigned int gap, unsigned int &pos);
+inline void revcomp(string &seq);
+inline void bam_record(vector <char> &arena, int32_t refid, int32_t pos, const string &name, unsigned int flag, unsigned int mapq, unsigned int cigarlen, const string &seq, const string &qual, const string &tags);
+inline unsigned int reg2bin(int beg, int end);
+inline bool rec_before(const struct rec &a, const struct rec &b);
+inline bool event_before(const struct event &a, const struct event &b);
+inline void bgzf_init(struct bgzfout &bz, FILE *fp, size_t blocksize);
+inline void bgzf_write(struct bgzfout &bz, const char *data, size_t n);
+inline void bgzf_block(struct bgzfout &bz);
+inline void bgzf_finish(struct bgzfout &bz);
+
+int main (int argc, char *argv[]) {
+
+  struct simopt opt;
+  opt.out        = "sim";
+  opt.chroms     = 2;
+  opt.chrlen     = 2000000;
+  opt.coverage   = 30;
+  opt.deletions  = 20;
+  opt.insertions = 10;
+  opt.repeats    = 10;
+  opt.tag        = "XT";
+  opt.error      = 0.005;
+  opt.maxmis     = 4;
+  opt.seed       = 1;
+  opt.blocksize  = 0;
+  string lengths = "76";
+
+  const struct option long_options[] = {
+    {"out",1,0,'o'},
+    {"chroms",1,0,'c'},
+    {"chrlen",1,0,'n'},
+    {"coverage",1,0,'x'},
+    {"lengths",1,0,'l'},
+    {"deletions",1,0,'d'},
+    {"insertions",1,0,'i'},
+    {"repeats",1,0,'r'},
+    {"tag",1,0,'t'},
+    {"error",1,0,'e'},
+    {"maxmis",1,0,'m'},
+    {"seed",1,0,'s'},
+    {"blocksize",1,0,'b'},
+    {"help",0,0,'h'},
+    {0,0,0,0}
+  };
+
+  int c;
+  while ((c = getopt_long_only(argc, argv, "ho:c:n:x:l:d:i:r:t:e:m:s:b:", long_options, NULL)) != -1) {
+    switch (c) {
+    case 'o': opt.out        = optarg; break;
+    case 'c': opt.chroms     = atoi(optarg); break;
+    case 'n': opt.chrlen     = atoi(optarg); break;
+    case 'x': opt.coverage   = atof(optarg); break;
+    case 'l': lengths        = optarg; break;
+    case 'd': opt.deletions  = atoi(optarg); break;
+    case 'i': opt.insertions = atoi(optarg); break;
+    case 'r': opt.repeats    = atoi(optarg); break;
+    case 't': opt.tag        = optarg; break;
+    case 'e': opt.error      = atof(optarg); break;
+    case 'm': opt.maxmis     = atoi(optarg); break;
+    case 's': opt.seed       = strtoull(optarg, NULL, 10); break;
+    case 'b': opt.blocksize  = atoi(optarg); break;
+    default:  usage(argv[0]); exit(0);
+    }
+  }
+
+  for (char *tok = strtok(&lengths[0], ","); tok != NULL; tok = strtok(NULL, ",")) {
+    if (atoi(tok) >= 25) opt.lengths.push_back(atoi(tok));
+  }
+  if (opt.lengths.empty() || opt.chroms == 0 || (opt.tag != "XT" && opt.tag != "NH") || (opt.blocksize != 0 && (opt.blocksize < 1024 || opt.blocksize > 65536))) {
+    usage(argv[0]);
+    exit(1);
+  }
+  unsigned int maxlen = *max_element(opt.lengths.begin(), opt.lengths.end());
+  unsigned int minlen = *min_element(opt.lengths.begin(), opt.lengths.end());
+  double meanlen = 0;
+  for (unsigned int i = 0; i < opt.lengths.size(); i++) meanlen += opt.lengths[i];
+  meanlen /= opt.lengths.size();
+  if (opt.chrlen < 20 * maxlen + 10000) {
+    cerr << "chromosomes of " << opt.chrlen << "bp are too short for " << maxlen << "bp reads" << endl;
+    exit(1);
+  }
+  rng_state = opt.seed * 0x9E3779B97F4A7C15ULL + 1;
+
+  string bamname = opt.out + ".bam";
+  string umrname = opt.out + ".umr.fq";
+  string evname  = opt.out + ".events";
+  FILE *bamfp = fopen(bamname.c_str(), "wb");
+  FILE *umrfp = fopen(umrname.c_str(), "w");
+  FILE *evfp  = fopen(evname.c_str(), "w");
+  if (bamfp == NULL || umrfp == NULL || evfp == NULL) {
+    cerr << "can not write the output files " << opt.out << ".*" << endl;
+    exit(1);
+  }
+
+  vector <char> arena;         // all BAM records, sorted at the end
+  vector <struct rec> recs;
+  unsigned long long nreads = 0, nmapped = 0, nunmapped = 0, nrepeat = 0;
+  const char *bases = "ACGT";
+
+  fprintf(evfp, "#chr\tstart\tend\ttype\tlength\n");  // 1-based, insertions go after start
+
+  for (unsigned int ci = 0; ci < opt.chroms; ci++) {
+
+    char chrbuf[32];
+    sprintf(chrbuf, "chr%u", ci + 1);
+    string chr = chrbuf;
+
+    string ref(opt.chrlen, 'A');
+    for (unsigned int i = 0; i < opt.chrlen; i++) ref[i] = bases[rnd() & 3];
+
+    // repeats and events, kept apart from each other by more than two reads
+    vector < pair<unsigned int, unsigned int> > used;
+    unsigned int gap = 2 * maxlen + 500;
+    vector <struct repeat> repeats;
+    for (unsigned int r = 0; r < opt.repeats; r++) {
+      struct repeat rep;
+      rep.len = 2 * maxlen + rnd_below(maxlen);
+      string seq(rep.len, 'A');
+      for (unsigned int i = 0; i < rep.len; i++) seq[i] = bases[rnd() & 3];
+      unsigned int ncopies = 2 + rnd_below(3);
+      for (unsigned int k = 0; k < ncopies; k++) {
+        unsigned int pos;
+        if (!place(used, rep.len, opt.chrlen, gap, pos)) break;
+        ref.replace(pos, rep.len, seq);
+        rep.copies.push_back(pos);
+        fprintf(evfp, "%s\t%u\t%u\tREP\t%u\n", chr.c_str(), pos + 1, pos + rep.len, rep.len);
+      }
+      repeats.push_back(rep);
+    }
+
+    vector <struct event> events;
+    for (unsigned int e = 0; e < opt.deletions + opt.insertions; e++) {
+      struct event ev;
+      ev.del = (e < opt.deletions);
+      ev.len = ev.del ? 50 + rnd_below(951) : maxlen + 50 + rnd_below(2 * maxlen);
+      if (!place(used, ev.del ? ev.len : 1, opt.chrlen, gap, ev.pos)) break;
+      if (!ev.del) {
+        ev.seq.resize(ev.len);
+        for (unsigned int i = 0; i < ev.len; i++) ev.seq[i] = bases[rnd() & 3];
+      }
+      events.push_back(ev);
+    }
+    sort(events.begin(), events.end(), event_before);
+    for (unsigned int e = 0; e < events.size(); e++) {
+      const struct event &ev = events[e];
+      if (ev.del) fprintf(evfp, "%s\t%u\t%u\tDEL\t%u\n", chr.c_str(), ev.pos + 1, ev.pos + ev.len, ev.len);
+      else        fprintf(evfp, "%s\t%u\t%u\tINS\t%u\n", chr.c_str(), ev.pos, ev.pos, ev.len);
+    }
+
+    // the donor genome and where each of its bases sits on the reference (-1 inserted)
+    string donor;
+    vector <int32_t> dref;
+    donor.reserve(opt.chrlen);
+    dref.reserve(opt.chrlen);
+    unsigned int at = 0;
+    for (unsigned int e = 0; e <= events.size(); e++) {
+      unsigned int upto = (e < events.size()) ? events[e].pos : opt.chrlen;
+      for (; at < upto; at++) {
+        donor.push_back(ref[at]);
+        dref.push_back(at);
+      }
+      if (e == events.size()) break;
+      if (events[e].del) at += events[e].len;
+      else {
+        donor.append(events[e].seq);
+        dref.insert(dref.end(), events[e].len, -1);
+      }
+    }
+
+    unsigned long long n = (unsigned long long)(opt.coverage * donor.size() / meanlen);
+    for (unsigned long long r = 0; r < n; r++) {
+
+      unsigned int len = opt.lengths[rnd_below(opt.lengths.size())];
+      unsigned int start = rnd_below(donor.size() - len + 1);
+      bool reverse = rnd() & 1;
+      char namebuf[64];
+      sprintf(namebuf, "sim%u_%llu", ci + 1, r);
+
+      // the read as sequenced, qualities with a low tail now and then
+      string seq = donor.substr(start, len);
+      if (reverse) revcomp(seq);
+      string qual(len, 'I');
+      unsigned int tail = (rnd_below(10) == 0) ? 1 + rnd_below(10) : 0;
+      for (unsigned int i = 0; i < len; i++) {
+        bool low = (i >= len - tail);
+        qual[i] = low ? '#' : (char)(33 + 30 + rnd_below(11));
+        if (rnd_unit() < (low ? 0.05 : opt.error)) {
+          seq[i] = bases[(strchr(bases, seq[i]) - bases + 1 + rnd_below(3)) & 3];
+          if (!low) qual[i] = (char)(33 + 2 + rnd_below(14));
+        }
+      }
+      nreads++;
+
+      // place it by its longest stretch of the reference, forward strand from here
+      string fseq = seq, fqual = qual;
+      if (reverse) {
+        revcomp(fseq);
+        std::reverse(fqual.begin(), fqual.end());
+      }
+      unsigned int best = 0, bestlen = 0;
+      for (unsigned int i = 0; i < len; ) {
+        unsigned int j = i;
+        if (dref[start + i] >= 0) {
+          while (j + 1 < len && dref[start + j + 1] == dref[start + j] + 1) j++;
+          if (j - i + 1 > bestlen) {
+            best = i;
+            bestlen = j - i + 1;
+          }
+        }
+        i = j + 1;
+      }
+      int64_t pos = (bestlen > 0) ? (int64_t)dref[start + best] - best : -1;
+
+      string md;
+      unsigned int nm = 0;
+      bool mapped = (bestlen > 0 && pos >= 0 && pos + len <= opt.chrlen);
+      if (mapped) {
+        unsigned int run = 0;
+        char num[16];
+        for (unsigned int i = 0; i < len; i++) {
+          if (fseq[i] == ref[pos + i]) {
+            run++;
+            continue;
+          }
+          sprintf(num, "%u", run);
+          md += num;
+          md += ref[pos + i];
+          run = 0;
+          nm++;
+        }
+        sprintf(num, "%u", run);
+        md += num;
+        mapped = (nm <= opt.maxmis);
+      }
+
+      if (!mapped) {
+        fprintf(umrfp, "@%s\n%s\n+\n%s\n", namebuf, seq.c_str(), qual.c_str());
+        size_t offset = arena.size();
+        bam_record(arena, -1, -1, namebuf, 4, 0, 0, seq, qual, "");
+        struct rec rc = {(uint32_t)-1, -1, offset, (uint32_t)(arena.size() - offset)};
+        recs.push_back(rc);
+        nunmapped++;
+        continue;
+      }
+
+      // inside a repeat copy: any of the copies, a multiple hit
+      unsigned int hits = 1;
+      for (unsigned int f = 0; f < repeats.size() && hits == 1; f++) {
+        const struct repeat &rep = repeats[f];
+        for (unsigned int k = 0; k < rep.copies.size(); k++) {
+          if (pos >= rep.copies[k] && pos + len <= rep.copies[k] + rep.len && rep.copies.size() > 1) {
+            hits = rep.copies.size();
+            pos  = rep.copies[rnd_below(hits)] + (pos - rep.copies[k]);
+            break;
+          }
+        }
+      }
+      if (hits > 1) nrepeat++;
+
+      string tags;
+      if (opt.tag == "XT") {
+        tags += "XTA";
+        tags += (hits > 1) ? 'R' : 'U';
+      }
+      else {
+        tags += "NHC";
+        tags += (char)hits;
+      }
+      tags += "NMC";
+      tags += (char)nm;
+      tags += "MDZ";
+      tags += md;
+      tags += '\0';
+
+      size_t offset = arena.size();
+      bam_record(arena, ci, pos, namebuf, reverse ? 16 : 0, hits > 1 ? 0 : 60, len, fseq, fqual, tags);
+      struct rec rc = {ci, (int32_t)pos, offset, (uint32_t)(arena.size() - offset)};
+      recs.push_back(rc);
+      nmapped++;
+    }
+
+    cerr << chr << ": " << events.size() << " events, " << repeats.size() << " repeat families, " << n << " reads" << endl;
+  }
+
+  // the BAM: header, then the records by reference and position
+  stable_sort(recs.begin(), recs.end(), rec_before);
+
+  string text = "@HD\tVN:1.0\tSO:coordinate\n";
+  for (unsigned int ci = 0; ci < opt.chroms; ci++) {
+    char line[64];
+    sprintf(line, "@SQ\tSN:chr%u\tLN:%u\n", ci + 1, opt.chrlen);
+    text += line;
+  }
+  text += "@PG\tID:simbam\tPN:simbam\n";
+  if (opt.blocksize != 0) {    // a @CO line fills the first block, so the first record starts a block
+    size_t head = 12 + text.size();
+    for (unsigned int ci = 0; ci < opt.chroms; ci++) head += 9 + snprintf(NULL, 0, "chr%u", ci + 1);
+    if (head + 5 <= opt.blocksize) text += "@CO\t" + string(opt.blocksize - head - 5, 'x') + "\n";
+  }
+
+  struct bgzfout bz;
+  bgzf_init(bz, bamfp, (opt.blocksize != 0) ? opt.blocksize : 0xff00);
+  int32_t word = text.size();
+  bgzf_write(bz, "BAM\1", 4);
+  bgzf_write(bz, (char *)&word, 4);
+  bgzf_write(bz, text.data(), text.size());
+  word = opt.chroms;
+  bgzf_write(bz, (char *)&word, 4);
+  for (unsigned int ci = 0; ci < opt.chroms; ci++) {
+    char name[32];
+    sprintf(name, "chr%u", ci + 1);
+    word = strlen(name) + 1;
+    bgzf_write(bz, (char *)&word, 4);
+    bgzf_write(bz, name, word);
+    word = opt.chrlen;
+    bgzf_write(bz, (char *)&word, 4);
+  }
+  for (size_t i = 0; i < recs.size(); i++) bgzf_write(bz, &arena[recs[i].offset], recs[i].size);
+  bgzf_finish(bz);
+  fclose(bamfp);
+  fclose(umrfp);
+
+  fprintf(evfp, "#reads\t%llu\tmapped\t%llu\tunmapped\t%llu\trepeat\t%llu\tlengths\t%u\t%u\n",
+          nreads, nmapped, nunmapped, nrepeat, minlen, maxlen);
+  fclose(evfp);
+  cerr << nreads << " reads: " << nmapped << " mapped (" << nrepeat << " in repeats), " << nunmapped << " unmapped" << endl;
+  cerr << "written: " << bamname << " " << umrname << " " << evname << endl;
+  return 0;
+}
+
+inline unsigned long long rnd() {  // xorshift64*, the same data on every platform
+  rng_state ^= rng_state >> 12;
+  rng_state ^= rng_state << 25;
+  rng_state ^= rng_state >> 27;
+  return rng_state * 2685821657736338717ULL;
+}
+
+inline unsigned int rnd_below(unsigned int n) {
+  return (rnd() >> 32) % n;
+}
+
+inline double rnd_unit() {
+  return (rnd() >> 11) * (1.0 / 9007199254740992.0);
+}
+
+inline void usage(const char *name) {
+  fprintf(stdout, "\nsimbam (simulated BAM with planted events) @ BreakPointer\n\n");
+  fprintf(stdout, "Usage: %s options\n\n", name);
+  fprintf(stdout, "-o --out        <string> output prefix: PREFIX.bam, PREFIX.umr.fq and PREFIX.events (default: sim).\n");
+  fprintf(stdout, "-c --chroms     <int>    number of chromosomes (default: 2).\n");
+  fprintf(stdout, "-n --chrlen     <int>    length of each chromosome (default: 2000000).\n");
+  fprintf(stdout, "-x --coverage   <float>  read coverage (default: 30).\n");
+  fprintf(stdout, "-l --lengths    <string> comma separated read lengths, drawn evenly (default: 76).\n");
+  fprintf(stdout, "-d --deletions  <int>    deletions of 50-1000bp per chromosome (default: 20).\n");
+  fprintf(stdout, "-i --insertions <int>    insertions longer than the reads per chromosome (default: 10).\n");
+  fprintf(stdout, "-r --repeats    <int>    repeat families of 2-4 copies per chromosome (default: 10).\n");
+  fprintf(stdout, "-t --tag        <string> uniqueness tag, XT (bwa) or NH (default: XT).\n");
+  fprintf(stdout, "-e --error      <float>  substitution rate of the sequencing (default: 0.005).\n");
+  fprintf(stdout, "-m --maxmis     <int>    mismatches a read may have and still map (default: 4).\n");
+  fprintf(stdout, "-s --seed       <int>    random seed (default: 1).\n");
+  fprintf(stdout, "-b --blocksize  <int>    uncompressed bytes per BGZF block, 1024-65536 (default: 65280 as samtools),\n");
+  fprintf(stdout, "                         when given the header is padded to fill the first block. 65536 is what bamtools writes.\n");
+  fprintf(stdout, "-h --help                print the help message.\n\n");
+}
+
+inline bool place(vector < pair<unsigned int, unsigned int> > &used, unsigned int len, unsigned int chrlen, unsigned int gap, unsigned int &pos) {
+  for (unsigned int tries = 0; tries < 1000; tries++) {
+    pos = 5000 + rnd_below(chrlen - 10000 - len);
+    bool clash = false;
+    for (unsigned int u = 0; u < used.size() && !clash; u++) {
+      clash = (pos < used[u].second + gap && used[u].first < pos + len + gap);
+    }
+    if (!clash) {
+      used.push_back(make_pair(pos, pos + len));
+      return true;
+    }
+  }
+  return false;
+}
+
+inline void revcomp(string &seq) {
+  std::reverse(seq.begin(), seq.end());
+  for (unsigned int i = 0; i < seq.size(); i++) {
+    switch (seq[i]) {
+    case 'A': seq[i] = 'T'; break;
+    case 'C': seq[i] = 'G'; break;
+    case 'G': seq[i] = 'C'; break;
+    case 'T': seq[i] = 'A'; break;
+    }
+  }
+}
+
+inline void bam_record(vector <char> &arena, int32_t refid, int32_t pos, const string &name, unsigned int flag, unsigned int mapq, unsigned int cigarlen, const string &seq, const string &qual, const string &tags) {
+
+  static const char *codes = "=ACMGRSVTWYHKDBN";
+  unsigned int lseq = seq.size();
+  unsigned int ncigar = (cigarlen > 0) ? 1 : 0;
+  int32_t size = 32 + name.size() + 1 + 4 * ncigar + (lseq + 1) / 2 + lseq + tags.size();
+  unsigned int bin = (refid < 0) ? 4680 : reg2bin(pos, pos + cigarlen);
+
+  size_t at = arena.size();
+  arena.resize(at + 4 + size);
+  char *p = &arena[at];
+  int32_t core[9] = {size, refid, pos,
+                     (int32_t)((bin << 16) | (mapq << 8) | (name.size() + 1)),
+                     (int32_t)((flag << 16) | ncigar),
+                     (int32_t)lseq, -1, -1, 0};
+  memcpy(p, core, sizeof(core));
+  p += sizeof(core);
+  memcpy(p, name.c_str(), name.size() + 1);
+  p += name.size() + 1;
+  if (ncigar) {
+    uint32_t op = cigarlen << 4;   // M
+    memcpy(p, &op, 4);
+    p += 4;
+  }
+  for (unsigned int i = 0; i < lseq; i += 2) {
+    unsigned int hi = strchr(codes, seq[i]) - codes;
+    unsigned int lo = (i + 1 < lseq) ? strchr(codes, seq[i + 1]) - codes : 0;
+    *p++ = (char)((hi << 4) | lo);
+  }
+  for (unsigned int i = 0; i < lseq; i++) *p++ = qual[i] - 33;
+  memcpy(p, tags.data(), tags.size());
+}
+
+inline unsigned int reg2bin(int beg, int end) {
+  --end;
+  if (beg >> 14 == end >> 14) return ((1 << 15) - 1) / 7 + (beg >> 14);
+  if (beg >> 17 == end >> 17) return ((1 << 12) - 1) / 7 + (beg >> 17);
+  if (beg >> 20 == end >> 20) return ((1 << 9) - 1) / 7 + (beg >> 20);
+  if (beg >> 23 == end >> 23) return ((1 << 6) - 1) / 7 + (beg >> 23);
+  if (beg >> 26 == end >> 26) return ((1 << 3) - 1) / 7 + (beg >> 26);
+  return 0;
+}
+
+inline bool rec_before(const struct rec &a, const struct rec &b) {
+  if (a.refid != b.refid) return a.refid < b.refid;
+  return a.pos < b.pos;
+}
+
+inline bool event_before(const struct event &a, const struct event &b) {
+  return a.pos < b.pos;
+}
+
+inline void bgzf_init(struct bgzfout &bz, FILE *fp, size_t blocksize) {
+  bz.fp = fp;
+  bz.blocksize = blocksize;
+  bz.buf.reserve(blocksize);
+  memset(&bz.zs, 0, sizeof(bz.zs));
+  deflateInit2(&bz.zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY);
+}
+
+inline void bgzf_write(struct bgzfout &bz, const char *data, size_t n) {
+  while (n > 0) {
+    size_t k = bz.blocksize - bz.buf.size();
+    if (k > n) k = n;
+    bz.buf.insert(bz.buf.end(), data, data + k);
+    data += k;
+    n -= k;
+    if (bz.buf.size() == bz.blocksize) bgzf_block(bz);
+  }
+}
+
+inline void bgzf_block(struct bgzfout &bz) {  // one BGZF block of what is in buf (an empty one ends the file)
+
+  unsigned char out[65536];
+  size_t n = bz.buf.size();
+  while (1) {                      // 64kb that do not compress go in two blocks, 1kb less at a time (as bamtools)
+    deflateReset(&bz.zs);
+    bz.zs.next_in   = bz.buf.empty() ? (Bytef *)out : (Bytef *)&bz.buf[0];
+    bz.zs.avail_in  = n;
+    bz.zs.next_out  = out + 18;
+    bz.zs.avail_out = sizeof(out) - 18 - 8;
+    if (deflate(&bz.zs, Z_FINISH) == Z_STREAM_END) break;
+    if (n <= 1024) {
+      cerr << "BGZF block does not fit" << endl;
+      exit(1);
+    }
+    n -= 1024;
+  }
+  unsigned int clen = sizeof(out) - 18 - 8 - bz.zs.avail_out;
+  unsigned int bsize = 18 + clen + 8;
+  unsigned char head[18] = {31, 139, 8, 4, 0, 0, 0, 0, 0, 255, 6, 0, 66, 67, 2, 0,
+                            (unsigned char)((bsize - 1) & 0xff), (unsigned char)((bsize - 1) >> 8)};
+  memcpy(out, head, 18);
+  uint32_t crc = crc32(crc32(0L, Z_NULL, 0), bz.buf.empty() ? Z_NULL : (Bytef *)&bz.buf[0], n);
+  uint32_t isize = n;
+  memcpy(out + 18 + clen, &crc, 4);
+  memcpy(out + 18 + clen + 4, &isize, 4);
+  fwrite(out, 1, bsize, bz.fp);
+  bz.buf.erase(bz.buf.begin(), bz.buf.begin() + n);
+}
+
+inline void bgzf_finish(struct bgzfout &bz) {
+  while (!bz.buf.empty()) bgzf_block(bz);
+  bgzf_block(bz);                  // the empty end of file block
+  deflateEnd(&bz.zs);
+}
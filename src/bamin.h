@@ -0,0 +1,455 @@
+/*
+
+ Copyright (C) 2011 Sun Ruping <rs3412@columbia.edu>
+
+ This file is part of Breakpointer.
+
+ Breakpointer is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License.
+
+ bamin.h: the BAM input of breakpointer and breakmis. Without io threads
+ the alignments come from the bamtools BamMultiReader as before. With
+ --io-threads N each BAM file is read through bgzf.h (N threads inflating
+ its blocks) and the records are decoded here into BamAlignment: the core
+ fields, the CIGAR, the tags and, unless core only, the name, bases and
+ qualities (AlignedBases and Filename are left empty). The files are merged
+ by reference and position like the bamtools multi reader does for
+ coordinate sorted input: equal positions go first come first served and
+ the unmapped reads without a reference come last. A region jumps to the
+ first record of its 16kb window taken from the linear .bai index, or
+ from the same table filled by a scan of the file when there is no
+ index; the same windows give the compressed size of a stretch of a
+ reference (bamin_span). The unmapped reads without a reference at the
+ end of the file are reached the same way (bamin_unplaced): they start
+ where the last chunk of the index ends, or where the scan met the first
+ of them. The bamtools reader stays open for the header, the references
+ and the index files in both cases.
+
+*/
+
+#ifndef BREAKPOINTER_BAMIN_H
+#define BREAKPOINTER_BAMIN_H
+
+#include <api/BamMultiReader.h>
+#include <iostream>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <string>
+#include <stdint.h>
+#include "bgzf.h"
+
+#define BAMIN_UNPLACED -2                // the region of the reads without a reference
+
+struct bamfile {
+  struct bgzf bg;
+  std::string fname;
+  int32_t nref;
+  int64_t first;                       // virtual offset of the first record
+  std::vector <int64_t> refstart;      // virtual offset of the first record of each reference, -1 none
+  std::vector < std::vector <int64_t> > linear;  // .bai linear index: first record of each 16kb window, 0 none
+  int64_t unplaced;                    // virtual offset of the reads without a reference, -1 none
+  bool located;                        // refstart is filled in
+  std::vector <char> rec;              // the next record (without its block_size)
+  int32_t refid;                       // and its reference and position, for the merge
+  int32_t pos;
+  unsigned long long order;            // when it was read
+  bool has;
+};
+
+struct bamin {
+  BamTools::BamMultiReader reader;
+  unsigned int iothreads;              // 0: read through bamtools
+  std::vector <struct bamfile *> files;
+  int region;                          // reference of the region, -1 for the whole input, BAMIN_UNPLACED
+  int left;                            // left bound of the region
+  unsigned long long order;
+};
+
+inline void bamin_open(struct bamin &in, const std::vector <std::string> &fnames, unsigned int iothreads);
+inline void bamin_close(struct bamin &in);
+inline bool bamin_next(struct bamin &in, BamTools::BamAlignment &bam, bool core);
+inline bool bamin_region(struct bamin &in, int ref, int left, int right);
+inline int64_t bamin_span(struct bamin &in, int ref, int from, int to);
+inline bool bamin_rewind(struct bamin &in);
+inline bool bamin_unplaced(struct bamin &in);
+inline void bamfile_load(struct bamin &in, struct bamfile &bf);
+inline int64_t bamfile_window(const struct bamfile &bf, int ref, int left);
+inline void bamfile_locate(struct bamfile &bf);
+inline bool bamfile_bai(struct bamfile &bf, const std::string &fname);
+inline bool bam_before(const struct bamfile &a, const struct bamfile &b);
+inline int32_t bam_end(const char *rec);
+inline void bam_decode(const std::vector <char> &rec, BamTools::BamAlignment &bam, bool core);
+
+inline int32_t bam_int32(const char *p) {
+  int32_t v;
+  memcpy(&v, p, 4);
+  return v;
+}
+
+inline uint32_t bam_uint32(const char *p) {
+  uint32_t v;
+  memcpy(&v, p, 4);
+  return v;
+}
+
+inline uint16_t bam_uint16(const char *p) {
+  uint16_t v;
+  memcpy(&v, p, 2);
+  return v;
+}
+
+
+inline void bamin_open(struct bamin &in, const std::vector <std::string> &fnames, unsigned int iothreads) {
+
+  in.reader.Open(fnames);
+  in.iothreads = iothreads;
+  in.region = -1;
+  in.left   = 0;
+  in.order  = 0;
+  if (iothreads == 0) return;
+
+  for (unsigned int i = 0; i < fnames.size(); i++) {
+
+    struct bamfile *bf = new struct bamfile;
+    bf->fname   = fnames[i];
+    bf->located = false;
+    bf->has     = false;
+    if (!bgzf_open(bf->bg, fnames[i], iothreads)) {
+      std::cerr << "can not open the BAM file " << fnames[i] << std::endl;
+      exit(1);
+    }
+
+    char magic[4];                     // the header, the references are taken from bamtools
+    char word[4];
+    bool ok = (bgzf_read(bf->bg, magic, 4) == 4 && memcmp(magic, "BAM\1", 4) == 0);
+    if (ok) ok = (bgzf_read(bf->bg, word, 4) == 4);
+    if (ok) {
+      std::vector <char> text(bam_int32(word));
+      ok = (bgzf_read(bf->bg, text.empty() ? NULL : &text[0], text.size()) == text.size());
+    }
+    if (ok) ok = (bgzf_read(bf->bg, word, 4) == 4);
+    bf->nref = ok ? bam_int32(word) : 0;
+    for (int32_t r = 0; ok && r < bf->nref; r++) {
+      ok = (bgzf_read(bf->bg, word, 4) == 4);
+      if (ok) {
+        std::vector <char> name(bam_int32(word) + 4);  // the name and l_ref
+        ok = (bgzf_read(bf->bg, &name[0], name.size()) == name.size());
+      }
+    }
+    if (!ok) {
+      std::cerr << "not a BAM file: " << fnames[i] << std::endl;
+      exit(1);
+    }
+
+    bf->first = bgzf_tell(bf->bg);
+    in.files.push_back(bf);
+    bamfile_load(in, *bf);
+  }
+}
+
+inline void bamin_close(struct bamin &in) {
+  in.reader.Close();
+  for (unsigned int i = 0; i < in.files.size(); i++) {
+    bgzf_close(in.files[i]->bg);
+    delete in.files[i];
+  }
+  in.files.clear();
+}
+
+inline bool bamin_next(struct bamin &in, BamTools::BamAlignment &bam, bool core) {
+
+  if (in.iothreads == 0) {
+    if (core) return in.reader.GetNextAlignmentCore(bam);  //no name, bases, qualities or tags
+    return in.reader.GetNextAlignment(bam);
+  }
+
+  struct bamfile *next = NULL;
+  for (unsigned int i = 0; i < in.files.size(); i++) {
+    if (in.files[i]->has && (next == NULL || bam_before(*in.files[i], *next))) next = in.files[i];
+  }
+  if (next == NULL) return false;
+
+  bam_decode(next->rec, bam, core);
+  bamfile_load(in, *next);
+  return true;
+}
+
+inline bool bamin_region(struct bamin &in, int ref, int left, int right) {  // alignments of ref overlapping left onwards
+
+  if (in.iothreads == 0) return in.reader.SetRegion(ref, left, ref, right);
+
+  in.region = ref;
+  in.left   = left;
+  for (unsigned int i = 0; i < in.files.size(); i++) {
+    struct bamfile &bf = *in.files[i];
+    if (!bf.located) bamfile_locate(bf);
+    bf.has = false;
+    if (ref < 0 || ref >= (int)bf.refstart.size() || bf.refstart[ref] < 0) continue;  // nothing there
+    if (!bgzf_seek(bf.bg, bamfile_window(bf, ref, left))) return false;
+    bamfile_load(in, bf);
+  }
+  return true;
+}
+
+inline int64_t bamin_span(struct bamin &in, int ref, int from, int to) {
+
+  // compressed bytes of the records of ref between from and to, summed over the files, -1 if unknown
+  if (in.iothreads == 0) return -1;
+  int64_t bytes = 0;
+  for (unsigned int i = 0; i < in.files.size(); i++) {
+    struct bamfile &bf = *in.files[i];
+    if (!bf.located) bamfile_locate(bf);
+    if (ref < 0 || ref >= (int)bf.refstart.size() || bf.refstart[ref] < 0) continue;  // nothing there
+    if (ref >= (int)bf.linear.size()) return -1;
+    int64_t a = bamfile_window(bf, ref, from);
+    int64_t b = bamfile_window(bf, ref, to);
+    if (b > a) bytes += (b >> 16) - (a >> 16);   // the block offsets of the virtual offsets
+  }
+  return bytes;
+}
+
+inline bool bamin_rewind(struct bamin &in) {
+
+  if (in.iothreads == 0) return in.reader.Rewind();
+
+  in.region = -1;
+  for (unsigned int i = 0; i < in.files.size(); i++) {
+    struct bamfile &bf = *in.files[i];
+    bf.has = false;
+    if (!bgzf_seek(bf.bg, bf.first)) continue;
+    bamfile_load(in, bf);
+  }
+  return true;
+}
+
+inline bool bamin_unplaced(struct bamin &in) {  // the reads without a reference, jumped to
+
+  if (in.iothreads == 0) return false;
+
+  in.region = BAMIN_UNPLACED;
+  for (unsigned int i = 0; i < in.files.size(); i++) {
+    struct bamfile &bf = *in.files[i];
+    if (!bf.located) bamfile_locate(bf);
+    bf.has = false;
+    if (bf.unplaced < 0) continue;     // nothing there
+    if (!bgzf_seek(bf.bg, bf.unplaced)) return false;
+    bamfile_load(in, bf);
+  }
+  return true;
+}
+
+inline void bamfile_load(struct bamin &in, struct bamfile &bf) {  // the next record of the file inside the region
+
+  bf.has = false;
+  while (1) {
+
+    char word[4];
+    if (bgzf_read(bf.bg, word, 4) != 4) break;
+    int32_t size = bam_int32(word);
+    if (size < 32) break;
+    bf.rec.resize(size);
+    if (bgzf_read(bf.bg, &bf.rec[0], size) != (size_t)size) {
+      std::cerr << "truncated BAM record in " << bf.fname << std::endl;
+      break;
+    }
+
+    bf.refid = bam_int32(&bf.rec[0]);
+    bf.pos   = bam_int32(&bf.rec[4]);
+    if (in.region == BAMIN_UNPLACED && bf.refid != -1) continue;
+    if (in.region >= 0) {
+      if (bf.refid == -1 || bf.refid > in.region) break;            // after the region
+      if (bf.refid < in.region) continue;
+      if (bf.pos < in.left && bam_end(&bf.rec[0]) < in.left) continue;  // ends before it
+    }
+
+    bf.has   = true;
+    bf.order = in.order++;
+    break;
+  }
+  if (bf.bg.broken) {
+    std::cerr << "broken BGZF block in " << bf.fname << std::endl;
+    exit(1);
+  }
+}
+
+inline int64_t bamfile_window(const struct bamfile &bf, int ref, int left) {
+
+  // where the records of ref overlapping left onwards start: the nearest window at or before left with a record
+  int64_t offset = bf.refstart[ref];
+  if (ref < (int)bf.linear.size() && left > 0) {
+    const std::vector <int64_t> &lin = bf.linear[ref];
+    int w = left >> 14;
+    if (w >= (int)lin.size()) w = (int)lin.size() - 1;
+    for (; w >= 0 && lin[w] == 0; w--) {}
+    if (w >= 0 && lin[w] > offset) offset = lin[w];
+  }
+  return offset;
+}
+
+inline void bamfile_locate(struct bamfile &bf) {  // the first record of each reference
+
+  bf.refstart.assign(bf.nref, -1);
+  bf.linear.clear();
+  bf.located = true;
+
+  std::string bai = bf.fname + ".bai";
+  if (bamfile_bai(bf, bai)) return;
+  if (bf.fname.size() > 4 && bf.fname.compare(bf.fname.size() - 4, 4, ".bam") == 0) {
+    bai = bf.fname.substr(0, bf.fname.size() - 4) + ".bai";
+    if (bamfile_bai(bf, bai)) return;
+  }
+
+  std::cerr << "no .bai index for " << bf.fname << ", scanning it for the references" << std::endl;
+  bf.refstart.assign(bf.nref, -1);
+  bf.linear.assign(bf.nref, std::vector <int64_t> ());
+  bf.unplaced = -1;
+  bgzf_seek(bf.bg, bf.first);
+  while (1) {
+    int64_t offset = bgzf_tell(bf.bg);
+    char word[4];
+    if (bgzf_read(bf.bg, word, 4) != 4) break;
+    int32_t size = bam_int32(word);
+    if (size < 32) break;
+    bf.rec.resize(size);
+    if (bgzf_read(bf.bg, &bf.rec[0], size) != (size_t)size) break;
+    int32_t refid = bam_int32(&bf.rec[0]);
+    if (refid < 0) {                                                // the unmapped reads at the end
+      bf.unplaced = offset;
+      break;
+    }
+    if (refid >= bf.nref) continue;
+    if (bf.refstart[refid] < 0) bf.refstart[refid] = offset;
+    int32_t pos = bam_int32(&bf.rec[4]);
+    int32_t end = bam_end(&bf.rec[0]);
+    std::vector <int64_t> &lin = bf.linear[refid];                 // the windows the record overlaps
+    int32_t last = ((end > pos) ? end - 1 : pos) >> 14;
+    if (pos < 0 || last >= (1 << 20)) continue;
+    if ((int32_t)lin.size() <= last) lin.resize(last + 1, 0);
+    for (int32_t w = pos >> 14; w <= last; w++) {
+      if (lin[w] == 0) lin[w] = offset;
+    }
+  }
+  if (bf.bg.broken) {
+    std::cerr << "broken BGZF block in " << bf.fname << std::endl;
+    exit(1);
+  }
+}
+
+inline bool bamfile_bai(struct bamfile &bf, const std::string &fname) {
+
+  FILE *fp = fopen(fname.c_str(), "rb");
+  if (fp == NULL) return false;
+
+  char magic[4];
+  int32_t nref = 0;
+  bf.unplaced = bf.first;              // moved on by the chunks
+  bool ok = (fread(magic, 1, 4, fp) == 4 && memcmp(magic, "BAI\1", 4) == 0 && fread(&nref, 4, 1, fp) == 1);
+
+  for (int32_t r = 0; ok && r < nref; r++) {
+    int32_t nbin = 0;
+    ok = (fread(&nbin, 4, 1, fp) == 1);
+    for (int32_t b = 0; ok && b < nbin; b++) {
+      uint32_t bin;
+      int32_t nchunk;
+      ok = (fread(&bin, 4, 1, fp) == 1 && fread(&nchunk, 4, 1, fp) == 1 && nchunk >= 0);
+      std::vector <uint64_t> chunks(2 * nchunk);
+      if (ok && nchunk > 0) ok = (fread(&chunks[0], 8, chunks.size(), fp) == chunks.size());
+      if (!ok || bin == 37450 || r >= bf.nref) continue;            // 37450 holds the counts, no chunks
+      for (int32_t c = 0; c < nchunk; c++) {
+        if (bf.refstart[r] < 0 || (int64_t)chunks[2 * c] < bf.refstart[r]) bf.refstart[r] = chunks[2 * c];
+        if ((int64_t)chunks[2 * c + 1] > bf.unplaced) bf.unplaced = chunks[2 * c + 1];  // after the last placed record
+      }
+    }
+    int32_t nintv = 0;
+    if (ok) ok = (fread(&nintv, 4, 1, fp) == 1 && nintv >= 0);
+    if (ok && r < bf.nref) {
+      bf.linear.resize(bf.nref);
+      bf.linear[r].resize(nintv);
+      if (nintv > 0) ok = (fread(&bf.linear[r][0], 8, nintv, fp) == (size_t)nintv);
+    }
+    else if (ok) ok = (fseeko(fp, 8 * (off_t)nintv, SEEK_CUR) == 0);
+  }
+  fclose(fp);
+
+  if (!ok) {
+    std::cerr << "can not read the index " << fname << std::endl;
+    bf.refstart.assign(bf.nref, -1);
+    bf.linear.clear();
+  }
+  return ok;
+}
+
+inline bool bam_before(const struct bamfile &a, const struct bamfile &b) {
+  uint32_t ra = a.refid, rb = b.refid;  // -1 goes last
+  if (ra != rb) return ra < rb;
+  if (a.refid != -1 && a.pos != b.pos) return a.pos < b.pos;
+  return a.order < b.order;
+}
+
+inline int32_t bam_end(const char *rec) {  // end of the alignment on the reference, like GetEndPosition()
+  int32_t end = bam_int32(rec + 4);
+  unsigned int ncigar = bam_uint16(rec + 12);
+  const char *cigar = rec + 32 + (unsigned char)rec[8];
+  for (unsigned int i = 0; i < ncigar; i++) {
+    uint32_t op = bam_uint32(cigar + 4 * i);
+    switch (op & 15) {
+    case 0: case 2: case 3: case 7: case 8:  // M D N = X
+      end += op >> 4;
+    }
+  }
+  return end;
+}
+
+inline void bam_decode(const std::vector <char> &rec, BamTools::BamAlignment &bam, bool core) {
+
+  const char *p = &rec[0];
+  unsigned int lname  = (unsigned char)p[8];
+  unsigned int ncigar = bam_uint16(p + 12);
+  int32_t lseq        = bam_int32(p + 16);
+
+  bam.RefID         = bam_int32(p);
+  bam.Position      = bam_int32(p + 4);
+  bam.MapQuality    = (unsigned char)p[9];
+  bam.Bin           = bam_uint16(p + 10);
+  bam.AlignmentFlag = bam_uint16(p + 14);
+  bam.Length        = lseq;
+  bam.MateRefID     = bam_int32(p + 20);
+  bam.MatePosition  = bam_int32(p + 24);
+  bam.InsertSize    = bam_int32(p + 28);
+
+  const char *cigar = p + 32 + lname;
+  bam.CigarData.resize(ncigar);
+  for (unsigned int i = 0; i < ncigar; i++) {
+    uint32_t op = bam_uint32(cigar + 4 * i);
+    bam.CigarData[i].Type   = "MIDNSHP=X???????"[op & 15];
+    bam.CigarData[i].Length = op >> 4;
+  }
+
+  const unsigned char *seq  = (const unsigned char *)cigar + 4 * ncigar;
+  const unsigned char *qual = seq + (lseq + 1) / 2;
+  const char *tags = (const char *)qual + lseq;
+  bam.TagData.assign(tags, p + rec.size());  // also when core only: BuildCharData() has nothing to add here
+  bam.AlignedBases.clear();
+
+  if (core) {
+    bam.Name.clear();
+    bam.QueryBases.clear();
+    bam.Qualities.clear();
+    return;
+  }
+
+  bam.Name.assign(p + 32, lname > 0 ? lname - 1 : 0);
+  bam.QueryBases.resize(lseq);
+  for (int32_t i = 0; i < lseq; i++) {
+    bam.QueryBases[i] = "=ACMGRSVTWYHKDBN"[(seq[i >> 1] >> ((~i & 1) << 2)) & 15];
+  }
+  bam.Qualities.resize(lseq);
+  if (lseq > 0 && qual[0] == 0xff) bam.Qualities.assign(lseq, (char)0xff);  // not stored
+  else {
+    for (int32_t i = 0; i < lseq; i++) bam.Qualities[i] = qual[i] + 33;
+  }
+}
+
+#endif
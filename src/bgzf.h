@@ -0,0 +1,280 @@
+/*
+
+ Copyright (C) 2011 Sun Ruping <rs3412@columbia.edu>
+
+ This file is part of Breakpointer.
+
+ Breakpointer is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License.
+
+ bgzf.h: reading a BGZF (BAM) file with the blocks inflated on a pool of
+ threads. BGZF blocks are independent deflate streams, so the workers take
+ the next block from the file in turn (the file is read under the lock, the
+ blocks keep their order) and inflate it outside the lock. The blocks go
+ into a ring of BGZF_SLOTS slots per worker and the reader takes them back
+ in file order, so at most that many blocks are read ahead.
+
+*/
+
+#ifndef BREAKPOINTER_BGZF_H
+#define BREAKPOINTER_BGZF_H
+
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstring>
+#include <stdint.h>
+#include <pthread.h>
+#include <zlib.h>
+
+#define BGZF_SLOTS 4                   // blocks in flight per worker thread
+#define BGZF_FREE  0
+#define BGZF_BUSY  1
+#define BGZF_READY 2
+
+struct bgzfslot {
+  std::vector <unsigned char> raw;     // the compressed block
+  std::vector <char> data;             // the inflated block
+  int64_t coffset;                     // file offset of the block
+  int state;
+  bool last;                           // end of file (or a broken block) instead of a block
+};
+
+struct bgzf {
+  FILE *fp;
+  std::vector <struct bgzfslot> slots;
+  std::vector <pthread_t> workers;
+  pthread_mutex_t lock;
+  pthread_cond_t  more;                // workers wait for a free slot
+  pthread_cond_t  ready;               // the reader waits for its next block
+  unsigned long long claimed;          // blocks taken by the workers since the last seek
+  unsigned long long head;             // block the reader is on
+  int64_t foffset;                     // file offset of the next block to take
+  unsigned int busy;                   // workers inflating right now
+  bool ended;                          // no more blocks to take
+  bool seeking;
+  bool stop;
+  bool broken;
+  struct bgzfslot *cur;                // the reader's block
+  size_t pos;                          // and its position in there
+};
+
+inline bool bgzf_open(struct bgzf &bg, const std::string &fname, unsigned int threads);
+inline void bgzf_close(struct bgzf &bg);
+inline size_t bgzf_read(struct bgzf &bg, void *dest, size_t n);
+inline bool bgzf_seek(struct bgzf &bg, int64_t voffset);
+inline int64_t bgzf_tell(const struct bgzf &bg);
+inline bool bgzf_next(struct bgzf &bg);
+inline int bgzf_fetch(FILE *fp, std::vector <unsigned char> &raw);
+inline bool bgzf_inflate(z_stream &zs, struct bgzfslot &slot);
+inline void *bgzf_worker(void *arg);
+
+
+inline bool bgzf_open(struct bgzf &bg, const std::string &fname, unsigned int threads) {
+
+  bg.fp = fopen(fname.c_str(), "rb");
+  if (bg.fp == NULL) return false;
+  if (threads == 0) threads = 1;
+
+  bg.slots.resize(BGZF_SLOTS * threads);
+  for (unsigned int i = 0; i < bg.slots.size(); i++) {
+    bg.slots[i].state = BGZF_FREE;
+    bg.slots[i].last  = false;
+  }
+  bg.claimed = 0;
+  bg.head    = 0;
+  bg.foffset = 0;
+  bg.busy    = 0;
+  bg.ended   = false;
+  bg.seeking = false;
+  bg.stop    = false;
+  bg.broken  = false;
+  bg.cur     = NULL;
+  bg.pos     = 0;
+  pthread_mutex_init(&bg.lock, NULL);
+  pthread_cond_init(&bg.more, NULL);
+  pthread_cond_init(&bg.ready, NULL);
+
+  bg.workers.resize(threads);
+  for (unsigned int t = 0; t < threads; t++) {
+    pthread_create(&bg.workers[t], NULL, bgzf_worker, &bg);
+  }
+  return true;
+}
+
+inline void bgzf_close(struct bgzf &bg) {
+  pthread_mutex_lock(&bg.lock);
+  bg.stop = true;
+  pthread_cond_broadcast(&bg.more);
+  pthread_mutex_unlock(&bg.lock);
+  for (unsigned int t = 0; t < bg.workers.size(); t++) {
+    pthread_join(bg.workers[t], NULL);
+  }
+  pthread_mutex_destroy(&bg.lock);
+  pthread_cond_destroy(&bg.more);
+  pthread_cond_destroy(&bg.ready);
+  fclose(bg.fp);
+}
+
+inline size_t bgzf_read(struct bgzf &bg, void *dest, size_t n) {
+
+  char *out = (char *)dest;
+  size_t got = 0;
+  while (got < n) {
+    if (bg.cur == NULL || bg.pos >= bg.cur->data.size()) {
+      if (!bgzf_next(bg)) break;
+      continue;                        // an empty block
+    }
+    size_t k = bg.cur->data.size() - bg.pos;
+    if (k > n - got) k = n - got;
+    memcpy(out + got, &bg.cur->data[bg.pos], k);
+    bg.pos += k;
+    got += k;
+  }
+  return got;
+}
+
+inline bool bgzf_seek(struct bgzf &bg, int64_t voffset) {
+
+  pthread_mutex_lock(&bg.lock);
+  bg.seeking = true;
+  while (bg.busy > 0) pthread_cond_wait(&bg.ready, &bg.lock);  // let the blocks in hand finish
+  bg.foffset = voffset >> 16;
+  bool ok = (fseeko(bg.fp, bg.foffset, SEEK_SET) == 0);
+  for (unsigned int i = 0; i < bg.slots.size(); i++) bg.slots[i].state = BGZF_FREE;
+  bg.claimed = 0;
+  bg.head    = 0;
+  bg.ended   = !ok;
+  bg.cur     = NULL;
+  bg.pos     = 0;
+  bg.seeking = false;
+  pthread_cond_broadcast(&bg.more);
+  pthread_mutex_unlock(&bg.lock);
+
+  if (!ok || !bgzf_next(bg)) return false;
+  bg.pos = voffset & 0xffff;
+  return true;
+}
+
+inline int64_t bgzf_tell(const struct bgzf &bg) {
+  if (bg.cur == NULL) return bg.foffset << 16;
+  if (!bg.cur->last && bg.pos >= bg.cur->data.size()) {  // at the end of the block: the start of the next one,
+    return (bg.cur->coffset + (int64_t)bg.cur->raw.size()) << 16;  // a 65536 byte block has no offset of its end
+  }
+  return (bg.cur->coffset << 16) | bg.pos;
+}
+
+inline bool bgzf_next(struct bgzf &bg) {  // move on to the next block, false at the end of the file
+
+  if (bg.cur != NULL && bg.cur->last) return false;
+
+  pthread_mutex_lock(&bg.lock);
+  if (bg.cur != NULL) {                // give the slot back
+    bg.cur->state = BGZF_FREE;
+    bg.head++;
+    pthread_cond_broadcast(&bg.more);
+  }
+  struct bgzfslot &slot = bg.slots[bg.head % bg.slots.size()];
+  while (bg.claimed <= bg.head || slot.state != BGZF_READY) pthread_cond_wait(&bg.ready, &bg.lock);
+  pthread_mutex_unlock(&bg.lock);
+
+  bg.cur = &slot;
+  bg.pos = 0;
+  return !slot.last;
+}
+
+inline int bgzf_fetch(FILE *fp, std::vector <unsigned char> &raw) {  // 1 a block, 0 end of file, -1 broken
+
+  unsigned char head[12];
+  size_t got = fread(head, 1, 12, fp);
+  if (got == 0) return 0;
+  if (got < 12 || head[0] != 31 || head[1] != 139 || head[2] != 8 || (head[3] & 4) == 0) return -1;
+
+  unsigned int xlen = head[10] | (head[11] << 8);
+  raw.resize(12 + xlen);
+  memcpy(&raw[0], head, 12);
+  if (fread(&raw[12], 1, xlen, fp) != xlen) return -1;
+
+  unsigned int bsize = 0;              // the BC subfield holds the block size - 1
+  for (unsigned int x = 12; x + 4 <= 12 + xlen; ) {
+    unsigned int slen = raw[x + 2] | (raw[x + 3] << 8);
+    if (raw[x] == 66 && raw[x + 1] == 67 && slen == 2 && x + 6 <= 12 + xlen) {
+      bsize = (raw[x + 4] | (raw[x + 5] << 8)) + 1;
+      break;
+    }
+    x += 4 + slen;
+  }
+  if (bsize < 12 + xlen + 8) return -1;
+
+  raw.resize(bsize);
+  if (fread(&raw[12 + xlen], 1, bsize - 12 - xlen, fp) != bsize - 12 - xlen) return -1;
+  return 1;
+}
+
+inline bool bgzf_inflate(z_stream &zs, struct bgzfslot &slot) {
+
+  std::vector <unsigned char> &raw = slot.raw;
+  unsigned int xlen = raw[10] | (raw[11] << 8);
+  unsigned int tail = raw.size() - 8;
+  uint32_t crc   = raw[tail] | (raw[tail + 1] << 8) | (raw[tail + 2] << 16) | ((uint32_t)raw[tail + 3] << 24);
+  uint32_t isize = raw[tail + 4] | (raw[tail + 5] << 8) | (raw[tail + 6] << 16) | ((uint32_t)raw[tail + 7] << 24);
+  if (isize > 65536) return false;
+
+  slot.data.resize(isize);
+  if (isize == 0) return true;
+  inflateReset(&zs);
+  zs.next_in   = &raw[12 + xlen];
+  zs.avail_in  = tail - 12 - xlen;
+  zs.next_out  = (Bytef *)&slot.data[0];
+  zs.avail_out = isize;
+  if (inflate(&zs, Z_FINISH) != Z_STREAM_END || zs.avail_out != 0) return false;
+  return crc32(crc32(0L, Z_NULL, 0), (Bytef *)&slot.data[0], isize) == crc;
+}
+
+inline void *bgzf_worker(void *arg) {
+
+  struct bgzf &bg = *((struct bgzf *)arg);
+  z_stream zs;
+  memset(&zs, 0, sizeof(zs));
+  inflateInit2(&zs, -15);              // raw deflate, the gzip wrapper is parsed by hand
+
+  pthread_mutex_lock(&bg.lock);
+  while (1) {
+
+    while (!bg.stop && (bg.seeking || bg.ended || bg.claimed >= bg.head + bg.slots.size())) {
+      pthread_cond_wait(&bg.more, &bg.lock);
+    }
+    if (bg.stop) break;
+
+    struct bgzfslot &slot = bg.slots[bg.claimed % bg.slots.size()];
+    bg.claimed++;
+    slot.coffset = bg.foffset;
+    int fetched = bgzf_fetch(bg.fp, slot.raw);
+    if (fetched == 1) bg.foffset += slot.raw.size();
+    else bg.ended = true;
+    slot.last  = (fetched != 1);
+    slot.state = BGZF_BUSY;
+    if (fetched == -1) bg.broken = true;
+    bg.busy++;
+    pthread_mutex_unlock(&bg.lock);
+
+    bool ok = slot.last || bgzf_inflate(zs, slot);
+
+    pthread_mutex_lock(&bg.lock);
+    if (!ok) {                         // stop the file here
+      slot.last = true;
+      slot.data.clear();
+      bg.ended  = true;
+      bg.broken = true;
+    }
+    bg.busy--;
+    slot.state = BGZF_READY;
+    pthread_cond_broadcast(&bg.ready);
+  }
+  pthread_mutex_unlock(&bg.lock);
+
+  inflateEnd(&zs);
+  return NULL;
+}
+
+#endif
@@ -0,0 +1,129 @@
+/*
+
+ Copyright (C) 2011 Sun Ruping <rs3412@columbia.edu>
+
+ This file is part of Breakpointer.
+
+ Breakpointer is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License.
+
+ bincache.h: memoized binomial upper tails for the window scoring.
+ The window depths are small integers and the prob of a read length class
+ is fixed once the class is met (bincache_prob adds it then), so
+ P(X > k | n, prob) is computed once per (prob id, n, k) and looked up
+ afterwards. A row of the table (one n) is allocated the first time it is
+ needed, unfilled entries are NaN. Windows deeper than BINCACHE_MAXN, or
+ past the memory budget, go to pbinom directly.
+
+ Most scored windows end up below the threshold. binom_tail_floor gives a
+ cheap lower bound on the tail, and when the lower bound already shows
+ that the tail is >= 0.1 (score <= 1) the exact tail is never computed.
+
+*/
+
+#ifndef BREAKPOINTER_BINCACHE_H
+#define BREAKPOINTER_BINCACHE_H
+
+#include <vector>
+#include <limits>
+#include <cmath>
+
+#define BINCACHE_MAXN   4096          // deepest window kept in the table
+#define BINCACHE_BUDGET (1 << 24)     // at most this many entries (128Mb)
+#define TAIL_FLOOR      0.1001        // a tail >= this scores <= 1, with room for float rounding
+#define TAIL_TERMS      16            // pmf terms summed by binom_tail_floor
+
+double pbinom(double x, double n, double p, int lower_tail);  // mathstats.h
+
+struct bincache {
+  std::vector <double> probs;                                // prob of each id
+  std::vector < std::vector < std::vector <double> > > rows; // id -> n -> k (0..2n, starts and ends both count)
+  unsigned long long size;                                   // entries allocated
+  unsigned long long lookups;
+  unsigned long long hits;
+  unsigned long long skipped;                                // exact tails ruled out by binom_tail_floor
+};
+
+inline void bincache_init(struct bincache &bc, const std::vector <double> &probs);
+inline void bincache_prob(struct bincache &bc, unsigned int id, double prob);
+inline double bincache_tail(struct bincache &bc, unsigned int id, unsigned int k, unsigned int n);
+inline bool bincache_peek(struct bincache &bc, unsigned int id, unsigned int k, unsigned int n, double &p);
+inline double binom_tail_floor(unsigned int k, unsigned int n, double p);
+
+
+inline void bincache_init(struct bincache &bc, const std::vector <double> &probs) {
+  bc.probs = probs;
+  bc.rows.clear();
+  bc.rows.resize(probs.size());
+  bc.size    = 0;
+  bc.lookups = 0;
+  bc.hits    = 0;
+  bc.skipped = 0;
+}
+
+inline void bincache_prob(struct bincache &bc, unsigned int id, double prob) {  // a prob id known only later
+  if (id >= bc.probs.size()) {
+    bc.probs.resize(id + 1, std::numeric_limits<double>::quiet_NaN());
+    bc.rows.resize(id + 1);
+  }
+  bc.probs[id] = prob;
+}
+
+inline double bincache_tail(struct bincache &bc, unsigned int id, unsigned int k, unsigned int n) {
+
+  bc.lookups++;
+  if (n >= BINCACHE_MAXN || k > 2 * n) return pbinom(k, n, bc.probs[id], 0);
+
+  std::vector < std::vector <double> > &rows = bc.rows[id];
+  if (n >= rows.size()) rows.resize(n + 1);
+  std::vector <double> &row = rows[n];
+  if (row.empty()) {
+    if (bc.size + 2 * n + 1 > BINCACHE_BUDGET) return pbinom(k, n, bc.probs[id], 0);
+    row.assign(2 * n + 1, std::numeric_limits<double>::quiet_NaN());
+    bc.size += 2 * n + 1;
+  }
+
+  double &p = row[k];
+  if (p == p) {                       // not NaN, computed before
+    bc.hits++;
+    return p;
+  }
+  p = pbinom(k, n, bc.probs[id], 0);
+  return p;
+}
+
+inline bool bincache_peek(struct bincache &bc, unsigned int id, unsigned int k, unsigned int n, double &p) {
+  std::vector < std::vector <double> > &rows = bc.rows[id];
+  if (n >= rows.size() || rows[n].empty() || k >= rows[n].size()) return false;
+  p = rows[n][k];
+  return (p == p);
+}
+
+inline double binom_tail_floor(unsigned int k, unsigned int n, double p) {
+
+  // a lower bound on P(X > k), X ~ Binom(n, p). pbinom goes through bratio's
+  // small parameter branch for k == 0 and k == n-1, which does not agree with
+  // the binomial tail, so those (and k >= n) are always left to pbinom
+  if (k == 0 || k + 1 >= n || p <= 0. || p >= 1.) return 0.;
+  if (k + 1 <= floor(n * p * (1. - 1e-12))) return 0.5;  // below the median: P(X >= floor(np)) >= 1/2
+
+  // P(X = j) >= sqrt(n / (8j(n-j))) exp(-n D(j/n || p)) for 0 < j < n (Ash 1965),
+  // then the following terms by the exact ratio P(j+1)/P(j) = (n-j)/(j+1) * p/(1-p)
+  unsigned int j = k + 1;
+  double term;
+  if (j == n) term = pow(p, (double)n);
+  else {
+    double q = (double)j / n;
+    double d = q * log(q / p) + (1. - q) * log((1. - q) / (1. - p));
+    term = sqrt((double)n / (8. * j * (n - j))) * exp(-(double)n * d);
+  }
+  double sum  = term;
+  double odds = p / (1. - p);
+  for (unsigned int t = 1; t < TAIL_TERMS && j < n; t++, j++) {
+    term *= odds * (n - j) / (j + 1);
+    sum  += term;
+  }
+  return sum * (1. - 1e-9);           // slack for the rounding of log/exp
+}
+
+#endif
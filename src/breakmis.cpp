@@ -31,45 +31,82 @@ using namespace BamTools;
 #include <cstring>
 #include <sstream>
 #include <iomanip>
+#include <pthread.h>
 #include "ifbm.h"
 #include "mathstats.h"
+#include "pileup.h"
+#include "strutil.h"
+#include "mismatch.h"
+#include "bamin.h"
+#include "regindex.h"
+#include "regbin.h"
+#include "outbuf.h"
 
 using namespace std;
 
-struct SVread {
-  string name;
-  unsigned int start;
-  unsigned int end;
-  string strand;
-  string seq;
-  set <unsigned int> me;
+unsigned int readlen    = 0;     //preset read length, 0 for variable
+unsigned int onlyunique = 0;     //take only uniquely mapped reads
+struct misconf conf;             //read ends, clipping and mismatch tag
+struct outfile gffout;           //the gff on stdout
+
+//breakpointer-pipeline (pipeline.cpp): the screened regions for breakvali as well, and
+//the BAM files opened into bamkept and left open for it
+vector <struct misseed> *misseeds = NULL;
+struct bamin *bamkept = NULL;
+
+#define MIS_BATCH 1000           //with --threads: regions per batch before it may be cut
+#define MIS_GAP   1000           //and the gap to cut at when the read length is not preset
+#define MIS_JUMP    (1 << 18)    //jump across a gap of more compressed bytes than this (about 4 to 8 BGZF blocks)
+#define MIS_JUMPGAP (1 << 16)    //or, with no index at hand, across a gap of more bases
+
+//screening state of one BAM reader
+struct misscan {
+  struct pileup pileup;          //packed keys of piling-up reads
+  unsigned int oldstart;
+  struct misread mread;          //the current read
+  struct regindex index;         //overlap lookup over the regions
+  vector <unsigned int> hits;    //regions overlapping the current read
 };
 
-struct region {
-  string chr;
-  unsigned int start;
-  unsigned int end;
-  unsigned int dis;
-  float depth;
-  float ratio1;
-  float ratio2;
-  float score;
-  unsigned int coverage;
-  unsigned int mismatch;
-  map <unsigned int, unsigned int> mispos;
-  set <unsigned int> forbid;
-  map <unsigned int, unsigned int> posendcov;
-  vector <struct SVread> SVreads;
+//the region file, as breakpointer prints it or in binary form (breakpointer --binout)
+struct regionin {
+  istream *text;
+  struct regbin bin;             //mapped, if it is binary
+  size_t rec;                    //next record of bin
 };
 
+//a batch of regions of one chromosome for the --threads workers
+struct batch {
+  int chr_id;                    //-1 if the BAM files do not have it
+  bool last;                     //holds the last region of the region file
+  deque <struct region> regions;
+  string out;                    //the gff of its regions
+  vector <struct misseed> seeds; //and their fields for misseeds
+  unsigned int zone;             //see screen_regions
+  bool done;
+};
+
+//for the --threads workers: batches are handed out and printed in region file order
+struct jobs {
+  vector <string> fnames;
+  unsigned int iothreads;        //BGZF threads of each worker's reader
+  RefVector refs;
+  vector <struct batch *> batches;
+  unsigned int next;             //next batch to screen
+  bool eof;                      //all batches are in
+  pthread_mutex_t lock;
+  pthread_cond_t  more;          //a batch was added
+  pthread_cond_t  ready;         //a batch was screened
+};
 
 inline void ParseCigar(const vector<CigarOp> &cigar, vector<int> &blockStarts, vector<int> &blockEnds, unsigned int &alignmentEnd);
-inline void splitstring(const string &str, vector<string> &elements, const string &delimiter);
 inline void splitgfftag(const string &str, map <string, string> &elements, const string &delimiter, vector<string> &tag_want);
-inline void eatline(const string &str, deque <struct region> &regions_ref);
-inline string int2str(unsigned int &i);
-inline string flo2str(float &f);
-inline void print_mismatch(struct region &region);
+inline bool region_next(struct regionin &ri, deque <struct region> &regions);
+inline void eatchunk(struct regionin &ri, deque <struct region> &next, deque <struct region> &regions, unsigned int batch, unsigned int gap);
+inline void misscan_init(struct misscan &ms);
+inline unsigned int screen_regions(struct misscan &ms, struct bamin &in, int chr_id, int chr_len, deque <struct region> &regions, bool last, string &out, vector <struct misseed> *seeds);
+inline unsigned int jump_regions(const struct regindex &ri, struct bamin &in, int chr_id, unsigned int jump);
+void *screen_worker(void *arg);
 inline void finished(const unsigned int &where);
 
 int main (int argc, char *argv[]) {
@@ -77,31 +114,14 @@ int main (int argc, char *argv[]) {
   struct parameters *param = 0;
   param = interface(param, argc, argv);
 
-  unsigned int readlen = 0;
   if ( param->readlen ) readlen = param->readlen;  //argument readlength
   else cerr << "no readlength argument is given, using variable read length setting" << endl;
 
-  unsigned int endlen;
-  if (readlen == 0) endlen = 10;
-  else if (readlen < 50) endlen = 10;
-  else if (readlen >=50 && readlen <= 100) endlen = 15;
-  else endlen = 20;
-
-  string qual_clip = param->qual_clip;
-  if (qual_clip == "no")  cerr << "quality clipping is turned off." << endl;
-  else if (qual_clip == "phred33" || qual_clip == "phred64" || qual_clip == "solexa64")  cerr << "read quality type for clipping is set to: " << qual_clip << ".\n"; 
-  else{
-    qual_clip = "phred33";
-    cerr << "quality clipping is on, quality taken default: " << qual_clip << ".\n";
-  }
-
-  string mistag = param->mistag;  // tag for mismatch
-  if (mistag == "") mistag = "MD";
-  cerr << "mismatch tag in the bam file is: " << mistag << endl;
+  mis_config(conf, readlen, param->qual_clip, param->mistag);
+  onlyunique = param->unique;
 
-  string old_chr = "SRP";
-  unsigned int oldstart = 0;  
-  map <string, unsigned int> pileup;             //SET container of piling-up reads
+  unsigned int threads = 1;
+  if ( param->threads ) threads = param->threads;  // argument threads
  
 //-------------------------------------------------------------------------------------------------------+
 // end of file or filenames                                                                              |
@@ -158,77 +178,201 @@ int main (int argc, char *argv[]) {
 // end of file or filenames                                                                              |
 //-------------------------------------------------------------------------------------------------------+
 
-  BamMultiReader reader;
-  reader.Open(fnames);
-  BamAlignment bam;
+  unsigned int iothreads = param->iothreads;     // argument BGZF threads, 0 for bamtools
+  if (iothreads > 0) cerr << "BAM blocks are inflated with " << iothreads << " threads per file" << endl;
+
+  struct bamin own;
+  struct bamin &in = (bamkept != NULL) ? *bamkept : own;
+  bamin_open(in, fnames, iothreads);
 
   // get header & reference information
-  string header = reader.GetHeaderText();
-  RefVector refs = reader.GetReferenceData();
+  string header = in.reader.GetHeaderText();
+  RefVector refs = in.reader.GetReferenceData();
 
-  if ( !reader.LocateIndexes() )     // opens any existing index files that match our BAM files
-     reader.CreateIndexes();         // creates index files for BAM files that still lack one
+  if ( !in.reader.LocateIndexes() )     // opens any existing index files that match our BAM files
+     in.reader.CreateIndexes();         // creates index files for BAM files that still lack one
 
-  //regions for the input of region file
+  //regions for the input of region file, taken one chromosome (or batch) at a time
   ifstream region_f;
-  string line;
-  region_f.open(param->region_f, ios_base::in);  // the file is opened
+  bool streamed = (strcmp(param->region_f, "-") == 0);  // from stdin, as breakpointer writes them
+  if (!streamed) region_f.open(param->region_f, ios_base::in);  // the file is opened
+  struct regionin regions_in;
+  regions_in.text = streamed ? (istream *)&cin : (istream *)&region_f;
+  regions_in.bin.map = NULL;
+  regions_in.rec = 0;
+  if (!streamed && regbin_is(param->region_f)) {       // the records are taken from the mapped file as they are
+    if ( !regbin_open(regions_in.bin, param->region_f) ) {
+      cerr << "can not read the binary region file " << param->region_f << endl;
+      exit(1);
+    }
+    cerr << "binary region file: " << regions_in.bin.nrec << " regions" << endl;
+  }
+  unsigned int gap = (readlen != 0) ? readlen : MIS_GAP;
+  outfile_open(gffout, stdout, param->bgzip);
+
+  deque <struct region> next;              // first region of the next chromosome or batch
+  if (regions_in.bin.map != NULL) region_next(regions_in, next);
+  else {
+    string line;
+    getline(*regions_in.text, line); //get the first line
+    eatline(line, next);
+  }
 
-  deque <struct region> regions;
-  getline(region_f, line); //get the first line
-  eatline(line,regions);
+  if (threads > 1) {  // batches of regions on the workers, output in region file order
+
+    cerr << "screening the regions with " << threads << " threads" << endl;
+    if (bamkept == NULL) bamin_close(in);
+
+    struct jobs job;
+    job.fnames    = fnames;
+    job.iothreads = iothreads;
+    job.refs      = refs;
+    job.next      = 0;
+    job.eof       = false;
+    pthread_mutex_init(&job.lock, NULL);
+    pthread_cond_init(&job.more, NULL);
+    pthread_cond_init(&job.ready, NULL);
+
+    vector <pthread_t> workers(threads);
+    for (unsigned int t = 0; t < threads; t++) {
+      pthread_create(&workers[t], NULL, screen_worker, &job);
+    }
 
-  deque <struct region>::iterator it = regions.begin();
+    unsigned int printed = 0;
+    unsigned int zone = 1;
+    while (1) {
+
+      if ( !next.empty() && job.batches.size() - printed < 4 * threads ) {  // read ahead a few batches
+        struct batch *b = new struct batch;
+        eatchunk(regions_in, next, b->regions, MIS_BATCH, gap);
+        b->chr_id = in.reader.GetReferenceID(b->regions.front().chr);
+        b->last   = next.empty();
+        b->zone   = 0;
+        b->done   = false;
+        pthread_mutex_lock(&job.lock);
+        job.batches.push_back(b);
+        job.eof = next.empty();
+        pthread_cond_broadcast(&job.more);
+        pthread_mutex_unlock(&job.lock);
+        continue;
+      }
+      if (printed == job.batches.size()) break;
+
+      pthread_mutex_lock(&job.lock);       //print the next batch once it is done
+      while (job.batches[printed]->done == false) pthread_cond_wait(&job.ready, &job.lock);
+      struct batch *b = job.batches[printed];
+      pthread_mutex_unlock(&job.lock);
+      outfile_write(gffout, b->out);
+      if (misseeds != NULL) misseeds->insert(misseeds->end(), b->seeds.begin(), b->seeds.end());
+      if (b->last) zone = b->zone;
+      delete b;
+      job.batches[printed++] = NULL;
+    }
 
-  while ( it->chr != old_chr ) {     // a new chr come from the region file
+    for (unsigned int t = 0; t < threads; t++) {
+      pthread_join(workers[t], NULL);
+    }
+    pthread_mutex_destroy(&job.lock);
+    pthread_cond_destroy(&job.more);
+    pthread_cond_destroy(&job.ready);
+    region_f.close();
+    regbin_close(regions_in.bin);
+    outfile_close(gffout);
+    finished(zone);
+    return 0;
+  }
 
-    old_chr = it->chr;  // set the current chr as old chr
+  struct misscan ms;
+  misscan_init(ms);
+  deque <struct region> regions;           // regions of the current chromosome
 
-    int chr_id  = reader.GetReferenceID(it->chr);
+  while ( !next.empty() ) {     // a new chr (or, streamed, a batch) come from the region file
 
-    if (chr_id == -1) {  //reference not found
+    eatchunk(regions_in, next, regions, streamed ? MIS_BATCH : 0, gap);  // streamed, not waiting for the whole chr
+    bool last = next.empty();   // no more regions after this chromosome
+    if (streamed) {
+      pileup_clear(ms.pileup);  // the batches are independent, as on the workers
+      ms.oldstart = 0;
+    }
 
-      for (; it != regions.end() && it->chr == old_chr; ) {
-        print_mismatch(*it);       // print the old region info
-        it = regions.erase(it);             // erase the current region
-      }
+    int chr_id  = in.reader.GetReferenceID(regions.front().chr);
 
-      while ( regions.empty() ) {
-        getline(region_f, line);
-        if ( region_f.eof() ) finished(1);
-        eatline(line, regions);
-        it = regions.begin();
-        if (it->chr == old_chr){
-          print_mismatch(*it);
-          regions.clear();
-          continue;
-        }
-      }
+    if (chr_id == -1) {  //reference not found
+      for (unsigned int i = 0; i < regions.size(); i++) print_mismatch(regions[i], gffout.buf, misseeds);
+      outfile_check(gffout);
+      if (last) finished(1);
       continue;
     }
 
     // set to new chr
     int chr_len = refs.at(chr_id).RefLength;
-    if ( !reader.SetRegion(chr_id, 1, chr_id, chr_len) ) {
-        cerr << "bamtools count ERROR: Jump region failed " << it->chr << endl;
-        reader.Close();
+    unsigned int zone = screen_regions(ms, in, chr_id, chr_len, regions, last, gffout.buf, misseeds);
+    outfile_check(gffout);       // the gff of a chromosome (streamed, a batch) is held until then
+    if (last) finished(zone);
+
+  } //new chromosome from region file
+
+
+  //close everything
+  regions.clear();
+  if (bamkept == NULL) bamin_close(in);
+  region_f.close();
+  regbin_close(regions_in.bin);
+  outfile_close(gffout);
+
+  return 0;
+
+} //main
+
+inline void misscan_init(struct misscan &ms) {
+  pileup_init(ms.pileup, 64);
+  ms.oldstart = 0;
+}
+
+inline unsigned int screen_regions(struct misscan &ms, struct bamin &in, int chr_id, int chr_len, deque <struct region> &regions, bool last, string &out, vector <struct misseed> *seeds) {
+
+  // screens the regions (of one chromosome) with the alignments overlapping them and prints them in order.
+  // returns where it stopped: 2 all regions passed, 3 a read got to the last region of the region file
+  // (the regions it has not passed are not printed then), 4 the alignments of the chromosome ran out.
+  // Clusters of regions far apart are jumped to (see jump_regions), the reads of a jump starting
+  // at or before the end of the previous one were screened by it and are skipped
+  regindex_build(ms.index, regions);
+
+  BamAlignment bam;
+  struct misread &mread = ms.mread;
+  unsigned int done = 0;                   // regions before done are printed
+  unsigned int jump = 0;                   // first region of the next jump
+  unsigned int seen = 0;                   // reads starting at or before this are screened
+
+  while (done < regions.size()) {          // a new jump
+
+    unsigned int stop = jump_regions(ms.index, in, chr_id, jump);   // 0 for the last cluster
+    int left = (ms.index.start[jump] > 1) ? ms.index.start[jump] - 1 : 0;   // 0-based, the cluster start
+    if ( !bamin_region(in, chr_id, left, chr_len) ) {
+        cerr << "bamtools count ERROR: Jump region failed " << regions.front().chr << endl;
+        bamin_close(in);
         exit(1);
     }
 
-    while (reader.GetNextAlignment(bam)) {    //reading each alignment
+    bool more = false;                     // the jump stopped before the alignments ran out
+    while (done < regions.size() && bamin_next(in, bam, false)) {    //reading each alignment
 
       if (bam.IsMapped() == false) continue;  //skip unaligned reads
 
-      string read_qual =  bam.Qualities;
-      unsigned int real_length = read_qual.size();
+      unsigned int bamstart = bam.Position + 1;
+      if (bamstart <= seen) continue;                 // screened by the previous jump
+      if (stop != 0 && bamstart > stop) {             // past the cluster
+        more = true;
+        break;
+      }
+
+      unsigned int real_length = bam.Qualities.size();
 
       if (readlen != 0) {     // the length is preset
         if (real_length != readlen) //skip the read with different length
           continue;
       }
  
-      string queryB   = bam.QueryBases;
-    
       //skip multiple location reads
       unsigned int unique = 0;
       if ( bam.HasTag("NH") ) {
@@ -246,309 +390,112 @@ int main (int argc, char *argv[]) {
         }
       }
 
-      if (param->unique == 1) {
+      if (onlyunique == 1) {
         if (unique != 1) {                         // skipe uniquelly mapped reads 
           continue;
         }
       }
 
-
-      string strand = "+";
-      if (bam.IsReverseStrand()) strand = "-";
-
-      unsigned int alignmentStart, alignmentEnd;
-      alignmentStart = bam.Position+1;
-      alignmentEnd   = bam.GetEndPosition();
-      unsigned int readends1 = alignmentStart+endlen;
-      unsigned int readends2 = alignmentEnd-endlen;
-
-      // get clipping infomation
-      unsigned int clipleft = 0;
-      unsigned int clipright = 0;
-      bool clipStatus = false;
-      if (qual_clip != "no"){
-        clipleft = 10000;
-        clipright = 10000;
-        unsigned int qpos = 0;
-        unsigned int qsize = 0;
-        for (; qpos < real_length; qpos++){
-          int qual_now;
-          if (qual_clip == "phred33")  qual_now = int(read_qual[qpos]) - 33;
-          else if (qual_clip == "phred64")  qual_now = int(read_qual[qpos]) - 64;
-          else if (qual_clip == "solexa64") qual_now = int(read_qual[qpos]) - 64;
-          else qual_now = int(read_qual[qpos]) - 33;
-          // cerr << qual_now << " ";        
-
-          if (qual_now >= 5) {
-            qsize++;
-            if (qsize >= 5) {
-              if (clipleft == 10000) {clipleft = (qpos + 1) - qsize;}
-              clipright = real_length - (qpos + 1);
-            } 
-          } //qual_clip above threshold
-          else
-            qsize = 0;
-        }
-        if (clipleft == 10000)  clipleft  = real_length;
-        if (clipright == 10000) clipright = real_length;      
-        if (clipleft != 0 || clipright != 0) clipStatus = true;
-      }
-      // end: get clipping infomation
-
-      // decode the MD tag to get the mismatches
-      string MD;
-      vector <string> tagMD;
-      vector <unsigned int> mismatch;
-      vector <unsigned int> fbpos;
-      bool MisStatus = false;
-      if (bam.GetTag(mistag, MD)) {
-        splitstring(MD, tagMD, "ACGTN^");
-        if (tagMD.size() > 1) {
-          tagMD.pop_back();
-          unsigned int pos = 0;
-          vector <string>::iterator mditer = tagMD.begin();
-          for (; mditer != tagMD.end(); mditer++) {
-
-            pos += (atoi((*mditer).c_str()) + 1);              //get the position in the alignement
-
-            if (clipStatus == false) {  //clipStatus == false
-              if ( pos < endlen || pos > (real_length - endlen + 1) ) {           //mismatch in the ends
-                unsigned int mis = pos + (alignmentStart - 1);                // to genomic coordinates
-                mismatch.push_back(mis);
-                if (MisStatus == false) MisStatus = true;
-              }
-              else {                                                        //forbid this pos as a real mis pos
-                unsigned int forbidpos = pos + (alignmentStart - 1);
-                fbpos.push_back(forbidpos);
-                if (MisStatus == false) MisStatus = true;
-              }
-            }  //noclip
-
-            else {                     //clipStatus == true
-              if (pos > clipleft && pos < (real_length - clipright + 1)) {       // not in clipped region
-                if (pos < endlen || pos > (real_length - endlen + 1)) {
-                  unsigned int mis = pos + (alignmentStart - 1);             // to genomic coordinates
-                  mismatch.push_back(mis);
-                  if (MisStatus == false) MisStatus = true;
-                }
-                else {                                                       //forbid this pos as a real mis pos
-                  unsigned int forbidpos = pos + (alignmentStart - 1);
-                  fbpos.push_back(forbidpos);
-                  if (MisStatus == false) MisStatus = true;
-                }
-              } // not in clipped region
-            } // yes clip
-            
-          } //iterator of tagMD
-        }   //tagMD > 1
-      }     //get MD
-      // end: decode the MD tag to get the mismatches
+      // clipping and mismatches of the read
+      mis_read(conf, bam, real_length, mread);
+      unsigned int alignmentStart = mread.start;
+      unsigned int alignmentEnd   = mread.end;
 
       // skip piling up reads (taking into account: mismatches & clipping information)
-      string alignSum = int2str(alignmentStart) + int2str(alignmentEnd) + strand;
-
-      if (alignmentStart != oldstart){
-        pileup.clear();                      //clear pileup set
-        if (clipStatus == true)
-          pileup.insert(map<string, unsigned int>::value_type(alignSum, 0));                                   // 0: a clipped read
-        else{
-          if (tagMD.size() > 1) pileup.insert(map<string, unsigned int>::value_type(alignSum, 2));             // 2: a quality read with mismatches
-          else pileup.insert(map<string, unsigned int>::value_type(alignSum, 1));                              // 1: a quality read with no mismatches
-        }
-      }
-      else if (alignmentStart == oldstart) {
-        if (pileup.count(alignSum)) {                            // looks like a pileup
-          if ( clipStatus == false ){                            // a perfect read
-            if ( tagMD.size() > 1 ) {                            // a perfect read with mismatch
-              if (pileup[alignSum] == 2) continue;               // already got, skip
-              if (pileup[alignSum] == 1) pileup[alignSum] += 1;  // let this read in
-              if (pileup[alignSum] == 0) pileup[alignSum] += 2;  // let this read in
-            }
-            else {                                               // a perfect read with out mismatch
-              if (pileup[alignSum] == 2) continue;
-              if (pileup[alignSum] == 1) continue;
-              if (pileup[alignSum] == 0) pileup[alignSum] += 1;
-            }
-          }
-          else                                                   // a clipped read
-            continue;
-        }                                     // found pileup key
-        else{                                 // not found key
-          if ( clipStatus == true )           // a clipped read
-            pileup.insert(map<string, unsigned int>::value_type(alignSum, 0));
-          else{                               // a perfect read
-            if ( tagMD.size() > 1 ) pileup.insert(map<string, unsigned int>::value_type(alignSum, 2));
-            else pileup.insert(map<string, unsigned int>::value_type(alignSum, 1));
-          }
-        }
-      }
-      // end: skip piling up reads (taking into account: mismatches & clipping information)
-
-
-      oldstart = alignmentStart;
-      
-      // loop for all the regions
-      struct SVread tmpread;            // storing current read
-      tmpread.name  = bam.Name;
-      tmpread.start = alignmentStart;
-      tmpread.end   = alignmentEnd;
-      tmpread.strand= strand;
-      tmpread.seq   = queryB;
-
-      deque <struct region>::iterator iter = regions.begin();
-
-      if ( iter->start > alignmentEnd ) continue;    // skip reads not overlapping with the first region
-
-      while ( iter->chr == old_chr && iter->start <= alignmentEnd && iter != regions.end() ) {
-
-        bool endinside = false;
-        bool misinside = false;
-
-        if (iter->end < alignmentStart) {            // the region end is beyond the alignmentStart
-          print_mismatch(*iter);            // print out 
-          iter = regions.erase(iter);                // this region should be removed 
-          if ( regions.empty() ){                    // regions is empty
-            getline(region_f, line);                 // get a line of region file
-            if ( ! region_f.eof() ){
-              eatline(line, regions);                // eat a line and put it into the duque
-              iter = regions.begin();
-            }
-            else finished(2);
-          }
-          continue;
-        }
+      if (mis_piled(ms.pileup, ms.oldstart, mread)) continue;
 
-        if (iter->end >= alignmentStart && iter->start <= alignmentEnd) {  //overlapping, should add some coverage
+      // the regions ending before this read are final
+      while (done < regions.size() && regions[done].end < alignmentStart) {
+        print_mismatch(regions[done], out, seeds);  // print out
+        regions[done] = region();                // and free its reads
+        done++;
+      }
+      if (done == regions.size()) return 2;      // nothing left on this chr
 
-          iter->coverage++;          
-          tmpread.me.clear();
+      regindex_find(ms.index, done, alignmentStart, alignmentEnd, ms.hits);
+      if (ms.hits.empty()) continue;
 
-          //add end coverage to each pos, two pairs: alignmentStart-readends1 & readends2-alignmentEnd
-          unsigned int region_pos;
-          if (alignmentStart <= iter->start) {
-            if (readends1 < iter->start && readends2 > iter->start) region_pos = readends2;
-            else region_pos = iter->start;
-          }
-          else  region_pos = alignmentStart;
-          for (; region_pos <= iter->end; region_pos++){
-            if (region_pos > alignmentEnd) 
-              break;
-            if ((region_pos >= alignmentStart && region_pos <= readends1) || (region_pos >= readends2 && region_pos <= alignmentEnd)) {
-              if (! (iter->posendcov).count(region_pos) ) 
-                iter->posendcov.insert( map <unsigned int, unsigned int>::value_type(region_pos, 1) );
-              else
-                (iter->posendcov)[region_pos] ++;
-            }
-          } //add end coverage
-
-          if ((alignmentStart >= iter->start && alignmentStart <= iter->end) || (alignmentEnd >= iter->start && alignmentEnd <= iter->end)) {
-            endinside   = true;     // current read is ending inside the region
-          }          
-
-          if (MisStatus == true) {  // do some mismatch counting
-
-            vector <unsigned int>::iterator misiter = mismatch.begin();
-            for(; misiter != mismatch.end(); misiter++) {
-              if (*misiter >= iter->start && *misiter <= iter->end) {  //mismatches found
-
-                iter->mismatch++;
-
-                tmpread.me.insert(*misiter);
-                misinside = true;        // current read has ME
-
-                if (! (iter->mispos).count(*misiter) )
-                  iter->mispos.insert( map <unsigned int, unsigned int>::value_type(*misiter, 1) );
-                else
-                  (iter->mispos)[*misiter] ++;
-              }
-            }  //iterator of mismatch(es)
-
-            vector <unsigned int>::iterator fbiter = fbpos.begin();     // forbidden positions
-            for(; fbiter != fbpos.end(); fbiter++){
-              if (*fbiter >= iter->start && *fbiter <= iter->end) {
-                if (! (iter->forbid).count(*fbiter) )
-                  iter->forbid.insert(*fbiter);     // insert the forbidden pos 
-              }
-            }  // iterator of fbpos
-          }    // the read has mismatch(es)
-        }      // overlapping
-
-        if (endinside == true && misinside == true) {
-          (iter->SVreads).push_back(tmpread);         // store current read if end inside and mis inside
-        }
+      // as before, the end of the region file is noticed once a read gets to its last region
+      if (last && ms.hits.front() == regions.size() - 1) return 3;
 
-        if ( (iter+1) != regions.end() ) 
-          iter++;                                     // if this region is not the last element in the deque
-        else {                                        // the last element
-          getline(region_f, line);                    // get a line of region file
-          if ( ! region_f.eof() ){
-            eatline(line, regions);                   // eat a line and put it into the duque
-            iter = regions.end();
-            iter--;
-          }
-          else  finished(3);
-        }
-      
-      } //while the read is overlapping a region
+      vector <unsigned int>::iterator hit = ms.hits.begin();
+      for (; hit != ms.hits.end(); hit++) {
+        mis_count(regions[*hit], mread, conf.endlen);  //overlapping, should add some coverage
+      }
 
     } //read a new bam
 
-    
-    // bam alignments in this region have been read, need to loop back
-    it = regions.begin();                    //reset to beginning
-    for (; it != regions.end() && it->chr == old_chr; ) {  // there are some regions left
-      print_mismatch(*it);          // print the old region info
-      it = regions.erase(it);                // erase the current region
-    }
+    if (!more) break;                      // the alignments of this chr ran out
+    seen = stop;
+    while (jump < regions.size() && ms.index.start[jump] <= stop) jump++;
 
-    while ( regions.empty() ) {
+  } //next jump
 
-      getline(region_f, line);
-      if ( region_f.eof() )  finished(4);
-      eatline(line, regions);
-      it = regions.begin();
-      if (it->chr == old_chr){
-        print_mismatch(*it);
-        regions.clear();
-        continue;
-      }
-    } // region is empty
-
-  } //new chromosome from region file
-
-
-  //close everything
-  regions.clear();
-  reader.Close();
-  region_f.close();
+  // bam alignments in this region have been read, print the regions left
+  for (; done < regions.size(); done++) {
+    print_mismatch(regions[done], out, seeds);
+  }
+  return 4;
+}
 
+inline unsigned int jump_regions(const struct regindex &ri, struct bamin &in, int chr_id, unsigned int jump) {
+
+  // the cluster of regions from jump on that is streamed through, returns where it ends (0 for the
+  // end of the chromosome). A gap is streamed across unless a jump is cheaper: with the 16kb windows
+  // of the index at hand when it holds more than MIS_JUMP compressed bytes, else when it is longer
+  // than MIS_JUMPGAP bases
+  for (unsigned int k = jump; k + 1 < ri.start.size(); k++) {
+    unsigned int from = ri.maxend[k];
+    unsigned int to   = ri.start[k+1];
+    if (to <= from + 1) continue;          // no gap
+    int64_t bytes = bamin_span(in, chr_id, from, to - 1);
+    if (bytes > MIS_JUMP || (bytes < 0 && to - from > MIS_JUMPGAP)) return from;
+  }
   return 0;
+}
 
-} //main
+void *screen_worker(void *arg) {
 
-inline string int2str(unsigned int &i){
-  string s;
-  stringstream ss(s);
-  ss << i;
-  return ss.str();
-}
+  struct jobs &job = *((struct jobs *)arg);
 
-inline string flo2str(float &f){
-  string s;
-  stringstream ss(s);
-  ss << f;
-  return ss.str();
-}
+  struct bamin in;
+  bamin_open(in, job.fnames, job.iothreads);
+  in.reader.LocateIndexes();        // the main thread has made sure the indexes exist
+  struct misscan ms;
+  misscan_init(ms);
 
-inline void splitstring(const string &str, vector<string> &elements, const string &delimiter) {
-  string::size_type lastPos = str.find_first_not_of(delimiter, 0);
-  string::size_type pos     = str.find_first_of(delimiter, lastPos);
+  while (1) {
 
-  while (string::npos != pos || string::npos != lastPos) {
-    elements.push_back(str.substr(lastPos, pos - lastPos));
-    lastPos = str.find_first_not_of(delimiter, pos);
-    pos = str.find_first_of(delimiter, lastPos);
+    pthread_mutex_lock(&job.lock);
+    while (job.next >= job.batches.size() && !job.eof) pthread_cond_wait(&job.more, &job.lock);
+    if (job.next >= job.batches.size()) {
+      pthread_mutex_unlock(&job.lock);
+      break;
+    }
+    struct batch *b = job.batches[job.next++];
+    pthread_mutex_unlock(&job.lock);
+
+    string &out = b->out;
+    vector <struct misseed> *seeds = (misseeds != NULL) ? &b->seeds : NULL;
+    if (b->chr_id == -1) {          //reference not found
+      for (unsigned int i = 0; i < b->regions.size(); i++) print_mismatch(b->regions[i], out, seeds);
+      b->zone = 1;
+    }
+    else {
+      pileup_clear(ms.pileup);      // the batches are independent
+      ms.oldstart = 0;
+      b->zone = screen_regions(ms, in, b->chr_id, job.refs.at(b->chr_id).RefLength, b->regions, b->last, out, seeds);
+    }
+    b->regions.clear();
+
+    pthread_mutex_lock(&job.lock);
+    b->done = true;
+    pthread_cond_broadcast(&job.ready);
+    pthread_mutex_unlock(&job.lock);
   }
+
+  bamin_close(in);
+  return NULL;
 }
 
 inline void splitgfftag(const string &str, map <string, string> &elements, const string &delimiter, vector<string> &tag_want) {
@@ -579,52 +526,6 @@ inline void splitgfftag(const string &str, map <string, string> &elements, const
   }
 }
 
-inline void eatline(const string &str, deque <struct region> &regions_ref) {
-  
-  vector <string> line_content;
-  //split line and then put it into a deque
-
-  splitstring(str, line_content, "\t");
-  vector <string>::iterator iter = line_content.begin();
-  unsigned int i;
-  struct region tmp;
-
-  for(i = 1; iter != line_content.end(); iter++, i++){
-    switch (i) {
-    case 1: // chr
-      tmp.chr = *iter;
-      continue;
-    case 2: // start
-      tmp.start = atoi((*iter).c_str());
-      continue;
-    case 3: // end
-      tmp.end = atoi((*iter).c_str());
-      continue;
-    case 4: // dis
-      tmp.dis = atoi((*iter).c_str());
-      continue;
-    case 5: // depth
-      tmp.depth = atof((*iter).c_str());
-      continue;
-    case 6: // ratio1
-      tmp.ratio1 = atof((*iter).c_str());
-      continue;
-    case 7: // ratio2
-      tmp.ratio2 = atof((*iter).c_str());
-      continue;
-    case 8: // score
-      tmp.score = atof((*iter).c_str());
-      continue;
-    default:
-      break;
-    }
-  }
-  tmp.coverage = 0;
-  tmp.mismatch = 0;
-  regions_ref.push_back(tmp);
-
-}
-
 inline void ParseCigar(const vector<CigarOp> &cigar, vector<int> &blockStarts, vector<int> &blockLengths, unsigned int &alignmentEnd) {
 
   int currPosition = 0;
@@ -663,136 +564,54 @@ inline void ParseCigar(const vector<CigarOp> &cigar, vector<int> &blockStarts, v
   alignmentEnd = currPosition;
 }
 
-inline void print_mismatch(struct region &region){  // do some mismatch screening thresholding to reach high accuracy
+inline void eatchunk(struct regionin &ri, deque <struct region> &next, deque <struct region> &regions, unsigned int batch, unsigned int gap) {
 
-  unsigned int realmis      = 0;
-  unsigned int totalmispos  = 0;
-  float        totalendbase = 0;  
-
-  map <unsigned int, unsigned int>::iterator posenditer = region.posendcov.begin();
-  for (; posenditer != region.posendcov.end(); posenditer++){
-    totalendbase += posenditer->second;
-  }
-  float leasterr = 0.01;
-  float n_emis = region.mismatch;
-  float localerr = n_emis/totalendbase;
-  float baserr = max(leasterr, localerr);
-  double mismatch_score = 0.;
-
-  map <unsigned int, unsigned int>::iterator iter = region.mispos.begin();  
-  for(;iter != region.mispos.end(); iter++){
-    if (! region.forbid.count(iter->first) ) { // not found in forbidden pos
-      totalmispos++; 
-      mismatch_score += pbinom(iter->second, (region.posendcov)[iter->first], baserr, 0);
-      if ( iter->second >= 2 ) {
-        realmis++;
-      } // frequency > 2
-    }   // forbidden pos
-  }     // for each mis pos
-
-  unsigned int max_nme = 0;
-  map <unsigned int, vector <struct SVread> > topreads;
-  vector <struct SVread>::iterator riter = region.SVreads.begin();
-  for (; riter != region.SVreads.end(); riter++){
-    set <unsigned int>::iterator miter = riter->me.begin();
-    unsigned int nme = 0;
-    while ( miter != riter->me.end() ) {
-      if ( ! region.forbid.count(*miter) ) {
-        nme ++;
-        miter++;
-      }
-      else {
-        riter->me.erase(miter++);  // clean non-end mis
-      }
+  // the regions of next's chromosome go to regions, next gets the first region of the
+  // following chromosome (empty at the end of the region file). With batch > 0 the regions
+  // are also cut once there are batch of them and the next one starts > gap after them all
+  regions.clear();
+  regions.push_back(next.front());
+  next.clear();
+
+  unsigned int maxend = regions.front().end;
+  while ( region_next(ri, regions) ) {
+    struct region &reg = regions.back();
+    if (reg.chr != regions.front().chr || (batch > 0 && regions.size() > batch && reg.start > maxend + gap)) {
+      next.push_back(reg);
+      regions.pop_back();
+      break;
     }
-    topreads[nme].push_back(*riter);    
-    if ( nme > max_nme ) max_nme = nme;
-  } // current SVread
-
-  string seedseq = "RME";    // decide the seed sequence 
-  if (max_nme > 0) {
-    if (topreads[max_nme].size() == 1){
-      vector <struct SVread>::iterator topiter = topreads[max_nme].begin();
-      set <unsigned int>::iterator meiter = (topiter->me).begin();
-      if ( (*meiter - topiter->start) < (topiter->end - *meiter) ) {
-        if (topiter->seq == "NA") seedseq = (topiter->name)+"["+(topiter->strand)+"p]";
-        else seedseq = (topiter->seq).substr(0,25);
-      }
-      else {
-        if (topiter->seq == "NA") seedseq = (topiter->name)+"["+(topiter->strand)+"s]";
-        else seedseq = (topiter->seq).substr((topiter->seq).length()-25,25);
-      }
-    }  
-    else {
-      vector <struct SVread>::iterator topiter  = topreads[max_nme].begin();
-      vector <struct SVread>::iterator topiter2 = topreads[max_nme].end();
-      topiter2--;
-      if (topiter->start >= region.start && topiter->end > region.end) { // the first top read is starting in the region
-         if (topiter->seq == "NA") seedseq = (topiter->name)+"["+(topiter->strand)+"p]";
-         else seedseq = (topiter->seq).substr(0,25);       
-      }
-      else if (topiter2->start < region.start && topiter2->end <= region.end) {
-         if (topiter->seq == "NA") seedseq = (topiter->name)+"["+(topiter->strand)+"s]";
-         else seedseq = (topiter2->seq).substr((topiter2->seq).length()-25,25);
-      }
-      else {
-        // where is the changing point? if ratio2 > 0.5 take the start, else take the end
-        vector <struct SVread>::iterator toprem = topiter;
-        for (; topiter != topreads[max_nme].end(); topiter++) {
+    if (reg.end > maxend) maxend = reg.end;
+  }
+}
 
-          set <unsigned int>::iterator meiter  = (topiter->me).begin(); // the first mis
-          set <unsigned int>::iterator meiter2 = (topiter->me).end();   // the last  mis
-          meiter2--;
+inline bool region_next(struct regionin &ri, deque <struct region> &regions) {
 
-          if ( topiter->end <= region.end && (*meiter - topiter->start) > (topiter->end - *meiter) ) {
-            toprem = topiter;
-          }
-          if ( topiter->start >= region.start && (*meiter2 - topiter->start) < (topiter->end - *meiter2)) {  // now its turning
-              if ( region.ratio2 > 0.5 ) {
-                if (topiter->seq == "NA") seedseq = (topiter->name)+"["+(topiter->strand)+"p]";
-                else seedseq = (topiter->seq).substr(0,25);
-              }
-              else {
-                if (topiter->seq == "NA") seedseq = (topiter->name)+"["+(topiter->strand)+"s]";
-                else seedseq = (toprem->seq).substr((toprem->seq).length()-25,25);
-              }
-              break;
-          } // turning
-        } // for top iter
-
-        if (seedseq == "RME"){
-          if (toprem->seq == "NA") seedseq = (toprem->name)+"["+(toprem->strand)+"s]";
-          else seedseq = (toprem->seq).substr((toprem->seq).length()-25,25);
-        }
+  // one more region at the back of regions, false at the end of the region file
+  if (ri.bin.map == NULL) {
+    string line;
+    if ( !getline(*ri.text, line) || ri.text->eof() ) return false;
+    eatline(line, regions);
+    return true;
+  }
 
-      } //else
-    } // > 1
-  } //max_nme > 0
-
-  float fdepth = region.coverage;
-  float edepth = fdepth*(region.ratio1);
-  float mirate = (region.mismatch)/edepth;
-
-  string chrom        = region.chr.c_str();
-  if (chrom.substr(0,3) != "chr") chrom = "chr"+chrom;
-  string source       = "Breakpointer";
-  string type         = "Depth-Skewed";
-  unsigned int start  = region.start;
-  unsigned int end    = region.end;
-  float confi         = mismatch_score;
-  string strand       = "+";
-  string phase        = ".";
-  string tag          = "ID="+chrom+":"+int2str(start)+";SIZE="+int2str(region.dis)+";DEPTH="+int2str(region.coverage)+";EndsRatio="+flo2str(region.ratio1)+";StartsRatio="+flo2str(region.ratio2)+";BinomialScore="+flo2str(region.score)+";MIS="+int2str(region.mismatch)+";realMIS="+int2str(realmis)+";MISRATE="+flo2str(mirate)+";seedseq="+seedseq;
-
-  if ( totalmispos > 1 )  //screen for number of positions where there are mismatches
-    if ( region.coverage >= 5 )  //screen for coverage
-     //if ( !(region.coverage > 100 && region.score < 1.1) ) // filter out hard to say stuff just for XLMR project!!!!!
-      //if ( realmis > 0 || (mirate > 1 && region.coverage >= 10 && region.mismatch < 50) ) //screen for realmis and mirate
-        cout << chrom <<"\t"<< source <<"\t"<< type <<"\t"<< start <<"\t"<< end <<"\t"<< setprecision(3) << confi <<"\t"<< strand <<"\t"<< phase <<"\t"<< tag << endl;
+  if (ri.rec == ri.bin.nrec) return false;
+  const struct regrec &rec = ri.bin.recs[ri.rec++];
+  struct region tmp;
+  tmp.chr    = (rec.refid >= 0 && (size_t)rec.refid < ri.bin.names.size()) ? ri.bin.names[rec.refid] : "*";
+  tmp.start  = rec.start;
+  tmp.end    = rec.end;
+  tmp.dis    = rec.dis;
+  tmp.depth  = regbin_round(rec.depth);    // as read back from the text form, the gff stays the same
+  tmp.ratio1 = regbin_round(rec.ratio1);
+  tmp.ratio2 = regbin_round(rec.ratio2);
+  tmp.score  = regbin_round(rec.score);
+  tmp.coverage = 0;
+  tmp.mismatch = 0;
+  regions.push_back(tmp);
+  return true;
 }
 
-
 inline void finished(const unsigned int &where){
   cerr << "Finished: end of region file, Zone: " << where << endl;
-  exit(0);
 }
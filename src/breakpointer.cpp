@@ -21,6 +21,14 @@
 #include <api/BamMultiReader.h>
 #include "mathstats.h"
 #include "ifbp.h"
+#include "pileup.h"
+#include "bincache.h"
+#include "strutil.h"
+#include "mismatch.h"
+#include "bamin.h"
+#include "regbin.h"
+#include "outbuf.h"
+#include "wintrace.h"
 using namespace BamTools;
 
 #include <cstring>
@@ -28,25 +36,54 @@ using namespace BamTools;
 #include <deque>
 #include <map>
 #include <set>
+#include <algorithm>
 #include <iostream>
 #include <fstream>
 #include <cstdlib>
 #include <string>
 #include <sstream>
+#include <pthread.h>
 using namespace std; 
 
-//merged print
-unsigned int indipr    = 0;
-string last_chr        = "SRP";
-unsigned int last_end  = 0;
-unsigned int ol_start  = 0;
-unsigned int ol_end    = 0;
-unsigned int ol_dis    = 0;
-float ol_number = 0;
-float ol_depth  = 0;
-float ol_ratio1 = 0;
-float ol_ratio2 = 0;
-float ol_score  = 0;
+//settings, fixed before the scanning starts
+unsigned int indipr      = 0;
+unsigned int read_length = 0;
+unsigned int windowsize  = 0;
+unsigned int onlyunique  = 0;
+bool prefix              = false;
+bool coreonly            = true;
+float winsize = 0.;
+float prob    = 0.;
+
+//read length classes for the variable read length buckets: each scan gives a class to a read
+//length the first time it meets it, a class per length, or per upper length of --length-bins
+#define MAXBINS 64                //classes held in the window itself, more go to window.more
+#define RINGSIZE (1 << 10)        //first size of the prefix engine's ring, ring_grow doubles it as needed
+#define AHEAD 2                   //--threads: finished scans waiting to be printed, per thread, before the workers wait
+vector <unsigned int> lenbounds;  //--length-bins upper read lengths, ascending, empty for one class per length
+
+//fused mismatch screening (--misout), the breakmis settings
+bool fused = false;
+struct misconf misconf;
+FILE *misfile = NULL;
+struct outfile misgff;            //buffered in front of misfile
+
+//breakpointer-pipeline (pipeline.cpp): the screened regions for breakvali as well, and
+//the BAM files opened into bamkept and left open for it
+vector <struct misseed> *misseeds = NULL;
+struct bamin *bamkept = NULL;
+
+//the regions on stdout and the --indiprint trace on stderr
+struct outfile regout;
+struct outfile traceout;
+
+//binary regions (--binout) instead of the text on stdout
+FILE *binfile = NULL;
+map <string, int> refids;         //chromosome -> reference id of its records
+
+//binary window trace (--window-trace)
+bool wtraced = false;
+struct wtwriter wtout;
 
 //for window storage
 struct bucket {
@@ -56,7 +93,8 @@ struct bucket {
 };
 
 struct window {
-  map <unsigned int, struct bucket> buckets;
+  struct bucket buckets[MAXBINS]; //one per read length class
+  vector <struct bucket> more;    //classes from MAXBINS on, rarely any
   unsigned int end;    //the end of the window = start  + winsize - 1 we don't need it here
   unsigned int depth;  //the depth of this window
   unsigned int deps;   //the start depth
@@ -69,10 +107,131 @@ struct read {
   unsigned int end;    // end of the read
 };
 
+//for the prefix engine: one slot per position in a rolling buffer
+struct slot {
+  unsigned int starts;          //reads starting at this position
+  unsigned int ends;            //reads ending at this position
+  vector <unsigned int> lstarts; //length class of each read starting here (variable read length)
+  vector <unsigned int> lends;   //length class of each read ending here
+  bool win;                     //a window starts at this position
+  unsigned int s0;              //reads started before the window (prefix at start-1)
+  unsigned int e0;              //reads ended before the window
+  vector <unsigned int> ls0;    //same per length class
+  vector <unsigned int> le0;
+  unsigned int wclass;          //variable read length: class of the read that opened the window,
+  vector <unsigned int> od;     //and per class the reads in the window when it was opened (depth,
+  vector <unsigned int> os;     //started and ended inside), all of them charged to wclass as the
+  vector <unsigned int> oe;     //new window loop of the legacy engine does
+};
+
+struct endring {
+  vector <struct slot> slots;
+  unsigned int mask;            //slots.size() - 1, size is a power of two
+  unsigned int done;            //positions <= done have been swept
+  unsigned int last;            //the furthest position holding an end or a window
+  unsigned int cums;            //reads started at or before done
+  unsigned int cume;            //reads ended at or before done
+  vector <unsigned int> lcums;  //same per length class
+  vector <unsigned int> lcume;
+  vector <unsigned int> ladded; //reads added so far per length class
+};
+
+//gff of a screened region
+struct misrec {
+  unsigned int end;                     //region end
+  string gff;                           //the gff line, empty if it did not pass the screening
+  vector <struct misseed> seed;         //and its fields for misseeds
+};
+
+//scanning state of a stretch of alignments (one per chromosome with --threads)
+struct scan {
+  //merged print
+  string last_chr;
+  unsigned int last_end;
+  unsigned int ol_start;
+  unsigned int ol_end;
+  unsigned int ol_dis;
+  float ol_number;
+  float ol_depth;
+  float ol_ratio1;
+  float ol_ratio2;
+  float ol_score;
+
+  string oldchr;                        //for checking the chromosome
+  unsigned int oldstart;                //compare start (piling up)
+  map <unsigned int, struct window> windows; //MAP container of windows
+  deque <struct read> reads;            //DEQUE container of reads
+  struct pileup pileup;                 //packed keys of piling-up reads
+  struct endring ring;                  //prefix engine: rolling start/end counters
+  struct bincache *cache;               //binomial tails, shared by the scans of one thread
+  vector <unsigned int> lenclass;       //read length -> class + 1, 0 not met yet
+  vector <unsigned int> classlen;       //class -> read length of its binomial prob (the prob id of the cache)
+  vector <unsigned int> classorder;     //the classes by ascending read length, the order of the score sum
+
+  //fused mismatch screening
+  struct pileup mispileup;              //piling-up filter of breakmis
+  unsigned int misoldstart;
+  int misref;                           //reference of the buffered reads
+  deque <struct misread> misreads;      //reads that may overlap a region still to come
+  unsigned int lastwin;                 //start of the last scored window
+  string gffchr;                        //chromosome of the held back regions
+  vector <struct misrec> gff;           //its regions, see mis_release
+  unsigned int reach;                   //start of the first read reaching its last region
+  string misout;                        //released gff
+  vector <struct misseed> misseed;      //and its fields
+
+  bool buffered;                        //keep the output until it is this chromosome's turn
+  string out;                           //buffered stdout
+  string bin;                           //buffered binary regions
+  string trace;                         //buffered stderr (indiprint)
+  struct wtblock wtb;                   //windows for the --window-trace writer
+  string wtchr;                         //and the chromosome of wtref
+  int wtref;
+};
+
+//for the --threads workers: references are handed out in header order
+struct jobs {
+  vector <string> fnames;
+  unsigned int iothreads;               //BGZF threads of each worker's reader
+  RefVector refs;
+  unsigned int next;                    //next reference to scan
+  unsigned int printed;                 //references printed so far
+  unsigned int ahead;                   //references handed out ahead of printed at most
+  vector <struct scan *> done;          //finished scans, by reference id
+  unsigned long long lookups;           //binomial tail cache use of all workers
+  unsigned long long hits;
+  unsigned long long skipped;
+  pthread_mutex_t lock;
+  pthread_cond_t  ready;
+  pthread_cond_t  room;                 //a reference was printed
+};
+
 inline void ParseCigar(const vector<CigarOp> &cigar, vector<int> &blockStarts, vector<int> &blockEnds, unsigned int &alignmentEnd); //deprecated
-inline void print_endepth(const string &chr, unsigned int winstart, const float &winsize, struct window &window, const float &prob);
-inline void splitstring(const string &str, vector<string> &elements, const string &delimiter);
-inline string int2str(unsigned int &);
+inline void print_endepth(struct scan &sc, const string &chr, unsigned int winstart, const float &winsize, struct window &window, const float &prob);
+inline void ring_init(struct endring &ring, unsigned int size);
+inline unsigned int length_class(struct scan &sc, unsigned int length);
+inline unsigned int length_add(struct scan &sc, unsigned int length);
+inline void length_bins(const string &spec);
+inline void window_open(map <unsigned int, struct window> &windows, unsigned int winstart);
+inline struct bucket &window_bucket(struct window &window, unsigned int c);
+inline const struct bucket &window_peek(const struct window &window, unsigned int c);
+inline void ring_add(struct endring &ring, unsigned int start, unsigned int end, unsigned int lclass, bool multi, unsigned int windowsize);
+inline void ring_sweep(struct scan &sc, unsigned int upto, const string &chr);
+inline void scan_init(struct scan &sc, bool buffered, struct bincache *cache);
+inline string &scan_dest(struct scan &sc, bool trace);
+inline void scan_done(struct scan &sc, bool trace);
+inline void region_text(string &s, const string &chr, unsigned int start, unsigned int end, unsigned int dis,
+                        float depth, float ratio1, float ratio2, float score);
+inline bool next_alignment(struct bamin &in, BamAlignment &bam);
+inline void scan_alignment(struct scan &sc, BamAlignment &bam, const RefVector &refs);
+inline void scan_windows(struct scan &sc);
+inline void scan_finish(struct scan &sc);
+inline void print_region(struct scan &sc, const string &chr);
+inline void mis_add(struct scan &sc, BamAlignment &bam);
+inline void mis_region(struct scan &sc, const string &line);
+inline void mis_release(struct scan &sc);
+inline void mis_last(const vector <struct misrec> &gff, unsigned int reach);
+void *scan_worker(void *arg);
 
 int main (int argc, char **argv){
 
@@ -81,11 +240,9 @@ int main (int argc, char **argv){
    
   // check the arguments
 
-  unsigned int read_length = 0;
   if ( param->readlen ) read_length = param->readlen;  //argument readlength
   else cerr << "no readlength argument is given, using variable read length setting" << endl;
 
-  unsigned int windowsize;
   if ( param->windowsize ) windowsize = param->windowsize;   //argument windowsize
   else {
     if (read_length <= 50 && read_length != 0 ) windowsize = 10;
@@ -95,10 +252,55 @@ int main (int argc, char **argv){
   cerr << "windowsize is: " << windowsize << endl;
 
   indipr = param->indiprint;           // argument print indi
+  onlyunique = param->unique;          // argument unique
+
+  string engine = param->engine;       // argument depth engine
+  if (engine == "") engine = "legacy";
+  if (engine != "legacy" && engine != "prefix") {
+    cerr << "unknown engine: " << engine << ", should be legacy or prefix" << endl;
+    exit(1);
+  }
+  prefix = (engine == "prefix");
+  cerr << "depth engine is: " << engine << endl;
+
+  string decode = param->decode;       // argument BAM decoding
+  if (decode == "") decode = "core";
+  if (decode != "core" && decode != "full") {
+    cerr << "unknown decoding: " << decode << ", should be core or full" << endl;
+    exit(1);
+  }
+  coreonly = (decode == "core");
+  cerr << "BAM decoding is: " << decode << endl;
+
+  unsigned int threads = 1;
+  if ( param->threads ) threads = param->threads;  // argument threads
+
+  unsigned int iothreads = param->iothreads;       // argument BGZF threads, 0 for bamtools
+  if (iothreads > 0) cerr << "BAM blocks are inflated with " << iothreads << " threads per file" << endl;
+
+  string bins = param->lengthbins;     // argument read length classes
+  if (bins == "") bins = "auto";
+
+  bool bgzip = param->bgzip;           // argument compressed output
+  outfile_open(regout, stdout, bgzip);
+  outfile_open(traceout, stderr, false);
+
+  string misout = param->misout;       // argument fused mismatch screening
+  if (misout != "") {
+    fused = true;
+    misfile = fopen(misout.c_str(), "w");
+    if (misfile == NULL) {
+      cerr << "can not write the mismatch screening to " << misout << endl;
+      exit(1);
+    }
+    outfile_open(misgff, misfile, bgzip);
+    cerr << "mismatch screening of the regions goes to: " << misout << endl;
+    mis_config(misconf, read_length, param->qual_clip, param->mistag);
+    coreonly = false;                  // needs the bases, qualities and tags
+  }
 
-  float winsize = windowsize;
+  winsize = windowsize;
   float readlen = read_length;
-  float prob = 0.;
   if (read_length != 0) {
     prob  = (2 * winsize) / (winsize + readlen);
     cerr << "binomial prob: " << prob << endl;
@@ -113,13 +315,6 @@ int main (int argc, char **argv){
   //if (param->val_uniq) val_uniq = param->val_uniq;
   //else val_uniq = 85;                   //default for BWA alignment
   //cerr << "unique tag is: " << tag_uniq << "\t" << val_uniq << endl; 
-  
-  string oldchr;                        //for checking the chromosome
-  unsigned int oldstart = 0;            //compare start (piling up)
-
-  map <unsigned int, struct window> windows; //MAP container of windows
-  deque <struct read> reads;            //DEQUE container of reads
-  set <string> pileup;                  //SET container of piling-up reads
 
 //-------------------------------------------------------------------------------------------------------+
 // BAM input (file or filenames?)                                                                        |
@@ -177,44 +372,318 @@ int main (int argc, char **argv){
 //-------------------------------------------------------------------------------------------------------+
 
   // open the BAM file(s)  
-  BamMultiReader reader;
-  reader.Open(fnames);
+  struct bamin own;
+  struct bamin &in = (bamkept != NULL) ? *bamkept : own;
+  bamin_open(in, fnames, iothreads);
   
   // get header & reference information
-  string header = reader.GetHeaderText();
-  RefVector refs = reader.GetReferenceData();
+  string header = in.reader.GetHeaderText();
+  RefVector refs = in.reader.GetReferenceData();
+
+  if ( ! in.reader.LocateIndexes() )     // opens any existing index files that match our BAM files
+     in.reader.CreateIndexes();         // creates index files for BAM files that still lack one
+
+  vector <string> names;               // the reference dictionary of the binary outputs
+  vector <uint32_t> lens;
+  refids.clear();
+  for (unsigned int r = 0; r < refs.size(); r++) {
+    names.push_back(refs[r].RefName);
+    lens.push_back(refs[r].RefLength);
+    refids[refs[r].RefName] = r;
+  }
 
-  if ( ! reader.LocateIndexes() )     // opens any existing index files that match our BAM files
-     reader.CreateIndexes();         // creates index files for BAM files that still lack one
+  string binout = param->binout;       // argument binary regions
+  if (binout != "") {
+    binfile = fopen(binout.c_str(), "wb");
+    if (binfile == NULL) {
+      cerr << "can not write the binary regions to " << binout << endl;
+      exit(1);
+    }
+    cerr << "the regions go in binary form to: " << binout << endl;
+    string head;
+    regbin_header(head, windowsize, read_length, onlyunique, names, lens);
+    fwrite(head.data(), 1, head.size(), binfile);
+  }
 
-  BamAlignment bam;
+  string wintrace = param->wintrace;   // argument binary window trace
+  FILE *wtfile = NULL;
+  wtraced = (wintrace != "");
+  if (wtraced) {
+    wtfile = fopen(wintrace.c_str(), "wb");
+    if (wtfile == NULL) {
+      cerr << "can not write the window trace to " << wintrace << endl;
+      exit(1);
+    }
+    cerr << "the window trace goes to: " << wintrace << endl;
+    wt_open(wtout, wtfile, windowsize, read_length, names, lens);
+  }
+
+  if (read_length == 0) length_bins(bins);
+  unsigned long long lookups = 0, hits = 0, skipped = 0;
+
+  if (threads > 1) {  // one reference per worker, output in header order
+
+    cerr << "scanning the references with " << threads << " threads" << endl;
+    if (bamkept == NULL) bamin_close(in);
+
+    struct jobs job;
+    job.fnames = fnames;
+    job.iothreads = iothreads;
+    job.refs   = refs;
+    job.next   = 0;
+    job.printed = 0;
+    job.ahead  = AHEAD * threads;
+    job.done.assign(refs.size(), (struct scan *)0);
+    job.lookups = 0;
+    job.hits    = 0;
+    job.skipped = 0;
+    pthread_mutex_init(&job.lock, NULL);
+    pthread_cond_init(&job.ready, NULL);
+    pthread_cond_init(&job.room, NULL);
+
+    vector <pthread_t> workers(threads);
+    for (unsigned int t = 0; t < threads; t++) {
+      pthread_create(&workers[t], NULL, scan_worker, &job);
+    }
 
-  while (reader.GetNextAlignment(bam)) {  //getting each alignment
+    vector <struct misrec> held;       //gff of the last chromosome with regions so far
+    unsigned int reach = 0;
+    for (unsigned int r = 0; r < refs.size(); r++) {  //print each reference once it is done
+      pthread_mutex_lock(&job.lock);
+      while (job.done[r] == 0) pthread_cond_wait(&job.ready, &job.lock);
+      struct scan *sc = job.done[r];
+      pthread_mutex_unlock(&job.lock);
+      outfile_write(traceout, sc->trace);
+      outfile_write(regout, sc->out);
+      outfile_flush(regout);           //a chromosome at a time for the next runlevel (--stream)
+      if (binfile != NULL) fwrite(sc->bin.data(), 1, sc->bin.size(), binfile);
+      if (fused && !sc->gff.empty()) {
+        mis_last(held, 0);
+        held.swap(sc->gff);
+        reach = sc->reach;
+      }
+      delete sc;
+      pthread_mutex_lock(&job.lock);
+      job.printed = r + 1;
+      pthread_cond_broadcast(&job.room);
+      pthread_mutex_unlock(&job.lock);
+    }
+    if (fused) mis_last(held, reach);
 
-    if (bam.IsMapped() == false) continue; //skip unaligned reads
+    for (unsigned int t = 0; t < threads; t++) {
+      pthread_join(workers[t], NULL);
+    }
+    pthread_mutex_destroy(&job.lock);
+    pthread_cond_destroy(&job.ready);
+    pthread_cond_destroy(&job.room);
+    lookups = job.lookups;
+    hits    = job.hits;
+    skipped = job.skipped;
+  }
+  else {
 
-    string read_qual =  bam.Qualities;
-    unsigned int real_length = read_qual.size();
+    struct bincache cache;
+    bincache_init(cache, vector <double> ((read_length != 0) ? 1 : 0, prob));
+    struct scan *sc = new struct scan;
+    scan_init(*sc, false, &cache);
 
-    if (read_length != 0) {     // the length is preset
-      if (real_length != read_length) //skip the read with different length
-         continue;
+    BamAlignment bam;
+    while (next_alignment(in, bam)) {  //getting each alignment
+      scan_alignment(*sc, bam, refs);
     }
+    if (bamkept == NULL) bamin_close(in);
+
+    scan_finish(*sc);
+    if (fused) mis_last(sc->gff, sc->reach);
+    delete sc;
+    lookups = cache.lookups;
+    hits    = cache.hits;
+    skipped = cache.skipped;
+  }
 
-    if (refs.at(bam.RefID).RefName != oldchr && !windows.empty()) {  //a new chr, the windows should be printed out and then clean up
+  outfile_close(traceout);
+  outfile_close(regout);
+  if (wtraced) {
+    wt_close(wtout);
+    fclose(wtfile);
+    fprintf(stderr, "window trace: %llu windows in %llu bytes\n", wtout.windows, wtout.bytes);
+    wtraced = false;
+  }
+  if (lookups + skipped > 0) {
+    fprintf(stderr, "binomial tails: %llu lookups, %.1f%% from the cache, %llu exact tails skipped by the lower bound\n",
+            lookups, (lookups > 0) ? 100. * hits / lookups : 0., skipped);
+  }
+  if (fused) {
+    outfile_close(misgff);
+    fclose(misfile);
+  }
+  if (binfile != NULL) fclose(binfile);
+  cerr << "step1 of @Breakpointer done." << endl;
+  return 0;
 
-      map <unsigned int,window>::iterator iter = windows.begin();
-      for (; iter != windows.end() ; iter++) { //print the last windows of the old chr
-        print_endepth(oldchr, (*iter).first, winsize, (*iter).second, prob);
-      }
+}
 
-      windows.clear(); //clear windows
-      reads.clear();   //clear reads
+inline void scan_init(struct scan &sc, bool buffered, struct bincache *cache) {
+  sc.last_chr  = "SRP";
+  sc.last_end  = 0;
+  sc.wtchr     = "";
+  sc.wtref     = -1;
+  sc.ol_start  = 0;
+  sc.ol_end    = 0;
+  sc.ol_dis    = 0;
+  sc.ol_number = 0;
+  sc.ol_depth  = 0;
+  sc.ol_ratio1 = 0;
+  sc.ol_ratio2 = 0;
+  sc.ol_score  = 0;
+  sc.oldchr    = "";
+  sc.oldstart  = 0;
+  sc.buffered  = buffered;
+  pileup_init(sc.mispileup, 64);
+  sc.misoldstart = 0;
+  sc.misref    = -1;
+  sc.lastwin   = 0;
+  sc.gffchr    = "";
+  sc.reach     = 0;
+  sc.cache     = cache;
+  ring_init(sc.ring, prefix ? RINGSIZE : 0);  //the legacy engine does not use it
+  pileup_init(sc.pileup, 64);
+}
 
-      oldstart = 0;
+inline string &scan_dest(struct scan &sc, bool trace) {
+  // where a line of the scan goes: its own buffer, or that of stdout (stderr for the trace)
+  if (sc.buffered) return trace ? sc.trace : sc.out;
+  return trace ? traceout.buf : regout.buf;
+}
+
+inline void scan_done(struct scan &sc, bool trace) {
+  if (sc.buffered == false) outfile_check(trace ? traceout : regout);
+}
+
+inline void region_text(string &s, const string &chr, unsigned int start, unsigned int end, unsigned int dis,
+                        float depth, float ratio1, float ratio2, float score) {
+  // "%s\t%d\t%d\t%d\t%.3f\t%.3f\t%.3f\t%.3f", the line of a region
+  s += chr;
+  s += '\t';
+  out_int(s, (int)start);
+  s += '\t';
+  out_int(s, (int)end);
+  s += '\t';
+  out_int(s, (int)dis);
+  s += '\t';
+  out_fixed(s, depth, 3);
+  s += '\t';
+  out_fixed(s, ratio1, 3);
+  s += '\t';
+  out_fixed(s, ratio2, 3);
+  s += '\t';
+  out_fixed(s, score, 3);
+}
+
+void *scan_worker(void *arg) {
+
+  struct jobs &job = *((struct jobs *)arg);
+
+  struct bamin in;
+  bamin_open(in, job.fnames, job.iothreads);
+  in.reader.LocateIndexes();        // the main thread has made sure the indexes exist
+  BamAlignment bam;
+  struct bincache cache;
+  bincache_init(cache, vector <double> ((read_length != 0) ? 1 : 0, prob));  // -l: prob id 0, otherwise the read lengths
+
+  while (1) {
+
+    pthread_mutex_lock(&job.lock);    //the finished scans wait for a slow reference before them, not too many
+    while (job.next < job.refs.size() && job.next >= job.printed + job.ahead) pthread_cond_wait(&job.room, &job.lock);
+    unsigned int r = job.next++;
+    pthread_mutex_unlock(&job.lock);
+    if (r >= job.refs.size()) break;
+
+    struct scan *sc = new struct scan;
+    scan_init(*sc, true, &cache);
+
+    if ( bamin_region(in, r, 0, job.refs.at(r).RefLength) ) {
+      while (next_alignment(in, bam)) {  //getting each alignment of this reference
+        scan_alignment(*sc, bam, job.refs);
+      }
+    }
+    else {
+      cerr << "no alignments found in " << job.refs.at(r).RefName << endl;
     }
+    scan_finish(*sc);
+
+    pthread_mutex_lock(&job.lock);
+    job.done[r] = sc;
+    pthread_cond_broadcast(&job.ready);
+    pthread_mutex_unlock(&job.lock);
+  }
+
+  bamin_close(in);
+
+  pthread_mutex_lock(&job.lock);
+  job.lookups += cache.lookups;
+  job.hits    += cache.hits;
+  job.skipped += cache.skipped;
+  pthread_mutex_unlock(&job.lock);
+  return NULL;
+}
+
+inline void scan_windows(struct scan &sc) {  //print out the windows in the pool
+
+  map <unsigned int,window>::iterator iter = sc.windows.begin();
+  for (; iter != sc.windows.end() ; iter++) { //print the last windows of the old chr
+    print_endepth(sc, sc.oldchr, (*iter).first, winsize, (*iter).second, prob);
+  }
+
+  sc.windows.clear(); //clear windows
+  sc.reads.clear();   //clear reads
+
+  if (sc.ring.last != 0) {  //sweep the ring to the end of the old chr
+    ring_sweep(sc, sc.ring.last + windowsize - 1, sc.oldchr);
+    ring_init(sc.ring, sc.ring.slots.size());
+  }
+
+  //print the last guy of the old chr
+  if (sc.last_chr != "SRP") {
+    print_region(sc, sc.last_chr);
+    sc.last_chr = "SRP";  // ending
+  }
+  if (sc.buffered == false) outfile_flush(regout);  //a chromosome at a time for the next runlevel (--stream)
+  sc.lastwin = 0;
+  sc.misreads.clear();
+}
+
+inline void scan_finish(struct scan &sc) {
+  scan_windows(sc);
+  if (wtraced) wt_flush(wtout, sc.wtb);
+  vector <struct slot>().swap(sc.ring.slots);  //a finished scan may wait a while to be printed
+}
+
+inline bool next_alignment(struct bamin &in, BamAlignment &bam) {
+  return bamin_next(in, bam, coreonly);  //core only: no name, bases, qualities or tags
+}
+
+inline void scan_alignment(struct scan &sc, BamAlignment &bam, const RefVector &refs) {
+
+  if (bam.IsMapped() == false) return; //skip unaligned reads
+
+  unsigned int real_length = bam.Length;  //length of the query sequence (l_seq)
+
+  if (read_length != 0) {     // the length is preset
+    if (real_length != read_length) //skip the read with different length
+       return;
+  }
+
+  if (refs.at(bam.RefID).RefName != sc.oldchr && (!sc.windows.empty() || sc.ring.last != 0)) {  //a new chr, the windows should be printed out and then clean up
+    scan_windows(sc);
+    sc.oldstart = 0;
+  }
    
 
+  if (onlyunique == 1) {
+
+    if (coreonly) bam.BuildCharData();          // the tags are only needed here
+
     unsigned int unique = 0;
     if ( bam.HasTag("NH") ) {
       bam.GetTag("NH", unique);                   // uniqueness
@@ -231,172 +700,357 @@ int main (int argc, char **argv){
       }
     }
 
-    if (param->unique == 1) {
-      if (unique != 1) {                         // skipe uniquelly mapped reads 
-        continue;
-      }
+    if (unique != 1) {                         // skipe uniquelly mapped reads 
+      return;
     }
+  }
 
-    string strand = "+";
-    if ( bam.IsReverseStrand() ) strand = "-";
-
-    unsigned int alignmentStart, alignmentEnd;
-    //CIGAR string and figure out the alignment blocks
-    //vector<int> blockLengths;
-    //vector<int> blockStarts;
-    //blockStarts.push_back(0);
-    //extract the block starts and lengths from the CIGAR string
-    //ParseCigar(bam.CigarData, blockStarts, blockLengths, alignmentEnd);
-    alignmentStart = bam.Position+1;
-    alignmentEnd   = bam.GetEndPosition();
-
-    //if (alignmentEnd_new != alignmentEnd) cerr << bam.Name << "\t" << alignmentStart << "\t" << alignmentEnd << "\t" << alignmentEnd_new  << endl;
-
-    //skip piling up reads (pileup based no starts+ends+strand)
-    string alignSum = int2str(alignmentStart) + int2str(alignmentEnd) + strand;
-    if (alignmentStart != oldstart) {
-      pileup.clear();          //clear pileup set
-      pileup.insert(alignSum); //insert the new read
-    }
-    else if (alignmentStart == oldstart){
-      if   (pileup.count(alignSum)) continue; //if find pileup read
-      else pileup.insert(alignSum); //insert
-    }   
+  if (fused) mis_add(sc, bam);                 // the mismatch screening has its own piling-up filter
+
+  unsigned int alignmentStart, alignmentEnd;
+  //CIGAR string and figure out the alignment blocks
+  //vector<int> blockLengths;
+  //vector<int> blockStarts;
+  //blockStarts.push_back(0);
+  //extract the block starts and lengths from the CIGAR string
+  //ParseCigar(bam.CigarData, blockStarts, blockLengths, alignmentEnd);
+  alignmentStart = bam.Position+1;
+  alignmentEnd   = bam.GetEndPosition();
+
+  //if (alignmentEnd_new != alignmentEnd) cerr << bam.Name << "\t" << alignmentStart << "\t" << alignmentEnd << "\t" << alignmentEnd_new  << endl;
+
+  //skip piling up reads (pileup based no starts+ends+strand)
+  uint64_t alignSum = pileup_key(alignmentStart, alignmentEnd, bam.IsReverseStrand());
+  if (alignmentStart != sc.oldstart) {
+    pileup_clear(sc.pileup);              //clear pileup set
+    pileup_insert(sc.pileup, alignSum, 0); //insert the new read
+  }
+  else if (alignmentStart == sc.oldstart){
+    if   (pileup_find(sc.pileup, alignSum)) return; //if find pileup read
+    else pileup_insert(sc.pileup, alignSum, 0);    //insert
+  }   
+
+  if (prefix) {  //prefix engine: close the windows behind the read start, then count the read
+    ring_sweep(sc, alignmentStart - 1, sc.oldchr);
+    ring_add(sc.ring, alignmentStart, alignmentEnd, length_class(sc, real_length), prob == 0., windowsize);
+    sc.oldchr    = refs.at(bam.RefID).RefName;
+    sc.oldstart  = alignmentStart;
+    return;
+  }
+
+  unsigned int lc = length_class(sc, real_length);
+
+  //insert two ends into the windows map, default depths are 0
+  window_open(sc.windows, alignmentStart);
+  window_open(sc.windows, alignmentEnd);
+
+  //add the current read into the reads deque
+  struct read tmp3 = {alignmentStart, alignmentEnd}; 
+  sc.reads.push_back(tmp3);
+
+  map <unsigned int, struct window>::iterator iter = sc.windows.begin();
 
-    //insert two ends into the windows map, default depths are 0
-    bucket tmpb = {0, 0, 0};  
-    map <unsigned int, struct bucket> tmpm;
-    tmpm.insert( pair <unsigned int, struct bucket> (real_length, tmpb));
-    window tmpw1 = {tmpm, alignmentStart+windowsize-1, 0, 0, 0};    
-    window tmpw2 = {tmpm, alignmentEnd+windowsize-1,   0, 0, 0};
-    windows.insert( pair < unsigned int, struct window > (alignmentStart, tmpw1) );
-    windows.insert( pair < unsigned int, struct window > (alignmentEnd, tmpw2) );
+  while (iter != sc.windows.end()) { //iterate the windows
 
-    //add the current read into the reads deque
-    struct read tmp3 = {alignmentStart, alignmentEnd}; 
-    reads.push_back(tmp3);
+    if ((iter->second).depth != 0) {  //old windows, only compare with the new read
 
-    map <unsigned int, struct window>::iterator iter = windows.begin();
+      if ((iter->second).end < alignmentStart){ //the window is beyond the new read start, print the window and delete it
+        print_endepth(sc, sc.oldchr, (*iter).first, winsize, (*iter).second, prob);
+        sc.windows.erase(iter++);
+        continue;
+      }
+
+      if ((iter->second).end >= alignmentStart && iter->first <= alignmentEnd){
+        (iter->second).depth++;    //depth++
+        window_bucket(iter->second, lc).bdepth++;
+        if (iter->first <= alignmentStart){
+           (iter->second).deps++;  //depth_start++
+           window_bucket(iter->second, lc).bdeps++;
+        }
+        if ((iter->second).end >= alignmentEnd){
+           (iter->second).depe++;  //depth_end++
+           window_bucket(iter->second, lc).bdepe++;
+        }
+      }
 
-    while (iter != windows.end()) { //iterate the windows
+    } //old window
 
-      if ((iter->second).depth != 0) {  //old windows, only compare with the new read
+    else if ((iter->second).depth == 0){ //new window, check all the current reads
+       
+      deque <struct read>::iterator iter2 = sc.reads.begin();
 
-        if ((iter->second).end < alignmentStart){ //the window is beyond the new read start, print the window and delete it
-          print_endepth(oldchr, (*iter).first, winsize, (*iter).second, prob);
-          windows.erase(iter++);
+      for(;iter2 != sc.reads.end();){ // loop over the deque of reads 
+
+        if (iter2->end < alignmentStart){ //read beyond the current alignment start, the read should be deleted
+          iter2 = sc.reads.erase(iter2);
           continue;
         }
 
-        if ((iter->second).end >= alignmentStart && iter->first <= alignmentEnd){
+        if (iter2->end >= iter->first && iter2->start <= (iter->second).end){
           (iter->second).depth++;    //depth++
-          if ((iter->second).buckets.count(real_length) > 0)
-            ((iter->second).buckets)[real_length].bdepth++;
-          else {
-            ((iter->second).buckets).insert(pair <unsigned int, struct bucket> (real_length, tmpb));
-            ((iter->second).buckets)[real_length].bdepth++;
-          }
-          if (iter->first <= alignmentStart){
-             (iter->second).deps++;  //depth_start++
-             ((iter->second).buckets)[real_length].bdeps++;
-          }
-          if ((iter->second).end >= alignmentEnd){
+          window_bucket(iter->second, lc).bdepth++;
+          if (iter2->end <= (iter->second).end){
              (iter->second).depe++;  //depth_end++
-             ((iter->second).buckets)[real_length].bdepe++;
+             window_bucket(iter->second, lc).bdepe++;
           }
-        }
+          if (iter2->start >= iter->first){
+             (iter->second).deps++;  //depth_start++
+             window_bucket(iter->second, lc).bdeps++;
+          } 
+        } //overlap
 
-      } //old window
+        iter2++;
 
-      else if ((iter->second).depth == 0){ //new window, check all the current reads
-         
-        deque <struct read>::iterator iter2 = reads.begin();
+      } //loop the reads
 
-        for(;iter2 != reads.end();){ // loop over the deque of reads 
+    } //new window
 
-          if (iter2->end < alignmentStart){ //read beyond the current alignment start, the read should be deleted
-            iter2 = reads.erase(iter2);
-            continue;
-          }
+    iter++; //increment of windows pointer
 
-          if (iter2->end >= iter->first && iter2->start <= (iter->second).end){
-            (iter->second).depth++;    //depth++
-            if ((iter->second).buckets.count(real_length) > 0)
-              ((iter->second).buckets)[real_length].bdepth++;
-            else {
-              ((iter->second).buckets).insert(pair <unsigned int, struct bucket> (real_length, tmpb));
-              ((iter->second).buckets)[real_length].bdepth++;
-            }
-            if (iter2->end <= (iter->second).end){
-               (iter->second).depe++;  //depth_end++
-               ((iter->second).buckets)[real_length].bdepe++;
-            }
-            if (iter2->start >= iter->first){
-               (iter->second).deps++;  //depth_start++
-               ((iter->second).buckets)[real_length].bdeps++;
-            } 
-          } //overlap
+  } //iterate the windows
 
-          iter2++;
+  sc.oldchr    = refs.at(bam.RefID).RefName;
+  sc.oldstart  = alignmentStart;
+}
 
-        } //loop the reads
+inline void ring_init(struct endring &ring, unsigned int size) {
+  ring.slots.resize(size);
+  ring.mask  = size - 1;
+  ring.done  = 0;
+  ring.last  = 0;
+  ring.cums  = 0;
+  ring.cume  = 0;
+  ring.lcums.assign(ring.lcums.size(), 0);
+  ring.lcume.assign(ring.lcume.size(), 0);
+  ring.ladded.assign(ring.ladded.size(), 0);
+  for (unsigned int i = 0; i < size; i++) {
+    ring.slots[i].starts = 0;
+    ring.slots[i].ends   = 0;
+    ring.slots[i].win    = false;
+    ring.slots[i].lstarts.clear();
+    ring.slots[i].lends.clear();
+  }
+}
 
-      } //new window
+inline unsigned int length_class(struct scan &sc, unsigned int length) {
+  if (length < sc.lenclass.size() && sc.lenclass[length] != 0) return sc.lenclass[length] - 1;
+  return length_add(sc, length);
+}
 
-      iter++; //increment of windows pointer
+inline unsigned int length_add(struct scan &sc, unsigned int length) {  // a read length met for the first time
 
-    } //iterate the windows
+  unsigned int blen = length;                 // read length of its binomial prob
+  if (read_length != 0) blen = read_length;   // a single class
+  else if (!lenbounds.empty()) {              // the upper length of its bin, the last bin for longer reads
+    vector <unsigned int>::iterator bit = lower_bound(lenbounds.begin(), lenbounds.end(), length);
+    blen = (bit != lenbounds.end()) ? *bit : lenbounds.back();
+  }
 
-    oldchr    = refs.at(bam.RefID).RefName;
-    oldstart  = alignmentStart;
+  unsigned int c = 0;
+  while (c < sc.classlen.size() && sc.classlen[c] != blen) c++;
+  if (c == sc.classlen.size()) {              // a new class
+    sc.classlen.push_back(blen);
+    vector <unsigned int>::iterator oit = sc.classorder.begin();
+    while (oit != sc.classorder.end() && sc.classlen[*oit] < blen) oit++;
+    sc.classorder.insert(oit, c);
+    sc.ring.lcums.push_back(0);
+    sc.ring.lcume.push_back(0);
+    sc.ring.ladded.push_back(0);
+    if (read_length == 0) {
+      float bprob = (2 * winsize) / (winsize + blen);
+      bincache_prob(*sc.cache, blen, bprob);
+    }
+  }
 
-  } //getting each alignment
+  if (length >= sc.lenclass.size()) sc.lenclass.resize(length + 1, 0);
+  sc.lenclass[length] = c + 1;
+  return c;
+}
 
-  reader.Close();
-  
+inline void length_bins(const string &spec) {
 
-  //print out the windows in the pool
-  if (!windows.empty()) {
-    map <unsigned int,window>::iterator iter = windows.begin();
-    for (; iter != windows.end() ; iter++){ //print the last windows of the old chr
-      print_endepth(oldchr, (*iter).first, winsize, (*iter).second, prob);
-    }
-    windows.clear(); //clear windows
-    reads.clear();   //clear reads
+  if (spec == "auto") {  // one class per read length, as they turn up
+    cerr << "read length classes: one per read length" << endl;
+    return;
   }
 
-  //print the last guy
-  if (last_chr != "SRP") {
-    ol_dis = ol_end - ol_start + 1;
-    float av_depth  = ol_depth/ol_number;
-    float av_ratio1 = ol_ratio1/ol_number;
-    float av_ratio2 = ol_ratio2/ol_number;
-    float av_score  = ol_score/ol_number;
-    printf("%s\t%d\t%d\t%d\t%.3f\t%.3f\t%.3f\t%.3f\n", last_chr.c_str(), ol_start, ol_end,
-           ol_dis, av_depth, av_ratio1, av_ratio2, av_score);
-    last_chr = "SRP";  // ending
+  // user given upper bounds, e.g. 36,50,76,100
+  vector <string> elements;
+  splitstring(spec, elements, ",");
+  for (unsigned int i = 0; i < elements.size(); i++) {
+    lenbounds.push_back(atoi(elements[i].c_str()));
+  }
+  sort(lenbounds.begin(), lenbounds.end());
+  lenbounds.erase(unique(lenbounds.begin(), lenbounds.end()), lenbounds.end());
+  if (lenbounds.empty() || lenbounds[0] == 0) {
+    cerr << "bad read length bins: " << spec << ", give comma separated read lengths" << endl;
+    exit(1);
   }
+  cerr << "read length classes: " << lenbounds.size() << endl;
+}
 
-  cerr << "step1 of @Breakpointer done." << endl;
+inline void window_open(map <unsigned int, struct window> &windows, unsigned int winstart) {
+  static struct window empty;                 // all zero
+  map <unsigned int, struct window>::iterator it = windows.lower_bound(winstart);
+  if (it != windows.end() && it->first == winstart) return;  //the window is there already
+  it = windows.insert(it, pair <unsigned int, struct window> (winstart, empty));
+  (it->second).end = winstart + windowsize - 1;
+}
+
+inline struct bucket &window_bucket(struct window &window, unsigned int c) {
+  if (c < MAXBINS) return window.buckets[c];
+  c -= MAXBINS;
+  if (c >= window.more.size()) window.more.resize(c + 1);  //zeroed
+  return window.more[c];
+}
+
+inline const struct bucket &window_peek(const struct window &window, unsigned int c) {
+  static const struct bucket none = {0, 0, 0};
+  if (c < MAXBINS) return window.buckets[c];
+  c -= MAXBINS;
+  return (c < window.more.size()) ? window.more[c] : none;
+}
+
+inline void ring_grow(struct endring &ring, unsigned int pos, unsigned int windowsize) {
+  // live positions: from the oldest unfinished window (done-windowsize+2) up to pos
+  unsigned int lo = (ring.done + 2 > windowsize) ? ring.done + 2 - windowsize : 0;
+  unsigned int size = ring.slots.size();
+  if (pos - lo < size) return;
+  while (pos - lo >= size) size <<= 1;
+  vector <struct slot> grown(size);
+  for (unsigned int p = lo; p <= ring.last; p++) {
+    swap(grown[p & (size-1)], ring.slots[p & ring.mask]);
+  }
+  ring.slots.swap(grown);
+  ring.mask = size - 1;
+}
+
+inline void ring_snapshot(struct endring &ring, struct slot &s) {
+  s.s0  = ring.cums;
+  s.e0  = ring.cume;
+  s.ls0 = ring.lcums;
+  s.le0 = ring.lcume;
+}
 
+inline void ring_opened(struct endring &ring, struct slot &s, unsigned int winstart, unsigned int lclass, unsigned int windowsize) {
+
+  // the reads of the window opened by a read of lclass, per class. All the reads so far are in the
+  // ring, none starts after winstart and none ends after last: those in the window end at winstart
+  // or later, which is all of them not swept yet when the window starts right after done
+  unsigned int winend = winstart + windowsize - 1;
+  bool next = (winstart == ring.done + 1);
+  s.wclass = lclass;
+  s.od.assign(ring.ladded.size(), 0);
+  s.os.assign(ring.ladded.size(), 0);
+  s.oe.assign(ring.ladded.size(), 0);
+  unsigned int upto = (next || ring.last < winend) ? winend : ring.last;
+  for (unsigned int p = winstart; p <= upto; p++) {
+    const struct slot &sp = ring.slots[p & ring.mask];
+    vector <unsigned int>::const_iterator lit = sp.lends.begin();
+    for (; lit != sp.lends.end(); lit++) {
+      if (!next) s.od[*lit]++;
+      if (p <= winend) s.oe[*lit]++;
+    }
+    if (p > winend) continue;
+    for (lit = sp.lstarts.begin(); lit != sp.lstarts.end(); lit++) s.os[*lit]++;
+  }
+  if (next) {
+    for (unsigned int c = 0; c < s.od.size(); c++) s.od[c] = ring.ladded[c] - ring.lcume[c];
+  }
 }
 
-inline string int2str(unsigned int &i){
-  string s;
-  stringstream ss(s);
-  ss << i;
-  return ss.str();
+inline void ring_window(struct endring &ring, unsigned int winstart, unsigned int lclass, bool multi, unsigned int windowsize) {
+  struct slot &s = ring.slots[winstart & ring.mask];
+  if (s.win) return;                               //already a window here
+  s.win = true;
+  if (winstart - 1 == ring.done) ring_snapshot(ring, s);  //otherwise taken when sweeping winstart-1
+  if (multi) ring_opened(ring, s, winstart, lclass, windowsize);
+}
+
+inline void ring_add(struct endring &ring, unsigned int start, unsigned int end, unsigned int lclass, bool multi, unsigned int windowsize) {
+  ring_grow(ring, multi ? end + windowsize - 1 : end, windowsize);  //the window at end is looked over when it opens
+  if (end > ring.last) ring.last = end;
+
+  struct slot &ss = ring.slots[start & ring.mask];
+  ss.starts++;
+  if (multi) ss.lstarts.push_back(lclass);
+  struct slot &se = ring.slots[end & ring.mask];
+  se.ends++;
+  if (multi) {
+    se.lends.push_back(lclass);
+    ring.ladded[lclass]++;
+  }
+
+  ring_window(ring, start, lclass, multi, windowsize);
+  ring_window(ring, end, lclass, multi, windowsize);
 }
 
-inline void splitstring(const string &str, vector<string> &elements, const string &delimiter) {
-  string::size_type lastPos = str.find_first_not_of(delimiter, 0);
-  string::size_type pos     = str.find_first_of(delimiter, lastPos);
+inline void ring_sweep(struct scan &sc, unsigned int upto, const string &chr) {
+
+  struct endring &ring = sc.ring;
+
+  if (upto <= ring.done) return;
+
+  unsigned int stop = ring.last + windowsize - 1;  //nothing changes beyond the last window end
+  if (stop > upto) stop = upto;
+
+  for (unsigned int p = ring.done + 1; p <= stop; p++) {
+
+    struct slot &sp = ring.slots[p & ring.mask];   //prefix sums up to p
+    ring.cums += sp.starts;
+    ring.cume += sp.ends;
+    sp.starts = 0;
+    sp.ends   = 0;
+    vector <unsigned int>::iterator lit = sp.lstarts.begin();
+    for (; lit != sp.lstarts.end(); lit++) ring.lcums[*lit]++;
+    for (lit = sp.lends.begin(); lit != sp.lends.end(); lit++) ring.lcume[*lit]++;
+    sp.lstarts.clear();
+    sp.lends.clear();
+    ring.done = p;
+
+    if (p + 1 > windowsize) {                       //the window ending at p is complete
+      unsigned int winstart = p + 1 - windowsize;
+      struct slot &sw = ring.slots[winstart & ring.mask];
+      if (sw.win) {
+        struct window win;                         //only the buckets of the classes so far are read
+        win.end   = p;
+        win.depth = ring.cums - sw.e0;             //started <= end, minus ended < start
+        win.deps  = ring.cums - sw.s0;             //started inside
+        win.depe  = ring.cume - sw.e0;             //ended inside
+        unsigned int od = 0, os = 0, oe = 0;       //the reads at the opening, to go to its class
+        for (unsigned int c = 0; c < sw.od.size(); c++) {
+          od += sw.od[c];
+          os += sw.os[c];
+          oe += sw.oe[c];
+        }
+        for (unsigned int c = 0; c < ring.lcums.size(); c++) {
+          unsigned int s0 = (c < sw.ls0.size()) ? sw.ls0[c] : 0;  //a class newer than the window
+          unsigned int e0 = (c < sw.le0.size()) ? sw.le0[c] : 0;
+          struct bucket &b = window_bucket(win, c);
+          b.bdepth = ring.lcums[c] - e0;
+          b.bdeps  = ring.lcums[c] - s0;
+          b.bdepe  = ring.lcume[c] - e0;
+          if (c < sw.od.size()) {
+            b.bdepth -= sw.od[c];
+            b.bdeps  -= sw.os[c];
+            b.bdepe  -= sw.oe[c];
+          }
+          if (c == sw.wclass && !sw.od.empty()) {
+            b.bdepth += od;
+            b.bdeps  += os;
+            b.bdepe  += oe;
+          }
+        }
+        print_endepth(sc, chr, winstart, winsize, win, prob);
+        sw.win = false;
+      }
+    }
 
-  while (string::npos != pos || string::npos != lastPos) {
-    elements.push_back(str.substr(lastPos, pos - lastPos));
-    lastPos = str.find_first_not_of(delimiter, pos);
-    pos = str.find_first_of(delimiter, lastPos);
+    struct slot &sn = ring.slots[(p + 1) & ring.mask];
+    if (sn.win) ring_snapshot(ring, sn);           //the window starting at p+1 needs the prefix at p
   }
+
+  ring.done = upto;
 }
 
 inline void ParseCigar(const vector<CigarOp> &cigar, vector<int> &blockStarts, vector<int> &blockLengths, unsigned int &alignmentEnd) {
@@ -438,7 +1092,9 @@ inline void ParseCigar(const vector<CigarOp> &cigar, vector<int> &blockStarts, v
   alignmentEnd = currPosition;
 }
 
-inline void print_endepth(const string &chr, unsigned int winstart, const float &winsize, struct window &window, const float &prob){
+inline void print_endepth(struct scan &sc, const string &chr, unsigned int winstart, const float &winsize, struct window &window, const float &prob){
+
+  sc.lastwin = winstart;
 
   float depth  = window.depth;
   float starts = window.deps;
@@ -451,96 +1107,244 @@ inline void print_endepth(const string &chr, unsigned int winstart, const float
     double score;
 
     if (prob != 0.) {  // single
-      score = pbinom((starts+ends), depth, prob, 0);
+      double tail;
+      if (!bincache_peek(*sc.cache, 0, window.deps + window.depe, window.depth, tail)
+          && binom_tail_floor(window.deps + window.depe, window.depth, sc.cache->probs[0]) >= TAIL_FLOOR) {
+        sc.cache->skipped++;  // score <= 1 for sure
+        return;
+      }
+      score = bincache_tail(*sc.cache, 0, window.deps + window.depe, window.depth);
       score = -log10(score);
     }
     else {             // multiple
+      double low = 0.;    // lower bound of the weighted tail sum, exact where cached
+      unsigned int missing = 0;
+      for (unsigned int o = 0; o < sc.classorder.size(); o++) {
+        unsigned int c = sc.classorder[o];
+        const struct bucket &b = window_peek(window, c);
+        if (b.bdepth < 2) continue;
+        float bdp = b.bdepth;
+        double tail;
+        if (!bincache_peek(*sc.cache, sc.classlen[c], b.bdeps + b.bdepe, b.bdepth, tail)) {
+          tail = binom_tail_floor(b.bdeps + b.bdepe, b.bdepth, sc.cache->probs[sc.classlen[c]]);
+          missing++;
+        }
+        low += (bdp/depth) * tail;
+      }
+      if (missing > 0 && low >= TAIL_FLOOR) {
+        sc.cache->skipped += missing;  // score <= 1 for sure
+        return;
+      }
+
       float bcs = 0.;
-      map <unsigned int, struct bucket>::iterator bit = window.buckets.begin();
-      for (; bit != window.buckets.end(); bit++) {
-        if ((bit->second).bdepth < 2) continue;
+      for (unsigned int o = 0; o < sc.classorder.size(); o++) {  //ascending read length
+        unsigned int c = sc.classorder[o];
+        const struct bucket &b = window_peek(window, c);
+        if (b.bdepth < 2) continue;
         else {
-          float bdp = (bit->second).bdepth;
-          float bds = (bit->second).bdeps;
-          float bde = (bit->second).bdepe;
-          float bprob = (2 * winsize) / (winsize + (bit->first));
-          float bscore = (bdp/depth)*pbinom((bds+bde), bdp, bprob, 0);
+          float bdp = b.bdepth;
+          float bscore = (bdp/depth)*bincache_tail(*sc.cache, sc.classlen[c], b.bdeps + b.bdepe, b.bdepth);
           bcs += bscore;
         }
       }
       if (bcs > 0.) score = -log10(bcs);
       else score = 0.;
-      //cerr << winstart << "\t" << window.buckets.size() << "\t" << score << endl;
+      //cerr << winstart << "\t" << sc.classlen.size() << "\t" << score << endl;
     }
 
     if (score > 1.) { // merge and print      
  
-      if (indipr == 1) {
-        fprintf(stderr, "%s\t%d\t%d\t%d\t%d\t%d\t%.3f\t%.3f\t%.5f\n", chr.c_str(), winstart, window.end,
-                window.depth, window.deps, window.depe, ratio1, ratio2, score);
+      if (indipr == 1) {  // "%s\t%d\t%d\t%d\t%d\t%d\t%.3f\t%.3f\t%.5f\n"
+        string &dest = scan_dest(sc, true);
+        dest += chr;
+        dest += '\t';
+        out_int(dest, (int)winstart);
+        dest += '\t';
+        out_int(dest, (int)window.end);
+        dest += '\t';
+        out_int(dest, (int)window.depth);
+        dest += '\t';
+        out_int(dest, (int)window.deps);
+        dest += '\t';
+        out_int(dest, (int)window.depe);
+        dest += '\t';
+        out_fixed(dest, ratio1, 3);
+        dest += '\t';
+        out_fixed(dest, ratio2, 3);
+        dest += '\t';
+        out_fixed(dest, score, 5);
+        dest += '\n';
+        scan_done(sc, true);
+      }
+      if (wtraced) {
+        if (chr != sc.wtchr) {
+          map <string, int>::const_iterator id = refids.find(chr);
+          sc.wtref = (id != refids.end()) ? id->second : -1;
+          sc.wtchr = chr;
+        }
+        wt_add(wtout, sc.wtb, sc.wtref, winstart, window.end, window.depth, window.deps, window.depe, score);
       }
 
      
-      if (chr != last_chr) {
+      if (chr != sc.last_chr) {
         
-        if (last_chr != "SRP") {
-          ol_dis = ol_end - ol_start + 1;
-          float av_depth  = ol_depth/ol_number;
-          float av_ratio1 = ol_ratio1/ol_number;
-          float av_ratio2 = ol_ratio2/ol_number;
-          float av_score  = ol_score/ol_number;
-          printf("%s\t%d\t%d\t%d\t%.3f\t%.3f\t%.3f\t%.3f\n", last_chr.c_str(), ol_start, ol_end,
-                 ol_dis, av_depth, av_ratio1, av_ratio2, av_score);
+        if (sc.last_chr != "SRP") {
+          print_region(sc, sc.last_chr);
         }
  
         //reset everything
-        last_end  = 0;
-        ol_start  = 0;
-        ol_end    = 0;
-        ol_dis    = 0;
-        ol_number = 0;
-        ol_depth  = 0;
-        ol_ratio1 = 0;
-        ol_ratio2 = 0;
-        ol_score  = 0;
+        sc.last_end  = 0;
+        sc.ol_start  = 0;
+        sc.ol_end    = 0;
+        sc.ol_dis    = 0;
+        sc.ol_number = 0;
+        sc.ol_depth  = 0;
+        sc.ol_ratio1 = 0;
+        sc.ol_ratio2 = 0;
+        sc.ol_score  = 0;
       }
 
-      if (winstart <= last_end){ //overlapping : put this window into vector
-        ol_end     = window.end;
-        ol_depth  += window.depth;
-        ol_ratio1 += ratio1;
-        ol_ratio2 += ratio2;
-        ol_score  += score;
-        ol_number += 1;
+      if (winstart <= sc.last_end){ //overlapping : put this window into vector
+        sc.ol_end     = window.end;
+        sc.ol_depth  += window.depth;
+        sc.ol_ratio1 += ratio1;
+        sc.ol_ratio2 += ratio2;
+        sc.ol_score  += score;
+        sc.ol_number += 1;
       }
      
-      if (winstart > last_end){  //non-overlapping
-
-        if (last_end != 0){
-          ol_dis = ol_end - ol_start + 1;
-          float av_depth  = ol_depth/ol_number;
-          float av_ratio1 = ol_ratio1/ol_number;
-          float av_ratio2 = ol_ratio2/ol_number;
-          float av_score  = ol_score/ol_number;
-          printf("%s\t%d\t%d\t%d\t%.3f\t%.3f\t%.3f\t%.3f\n", chr.c_str(), ol_start, ol_end,
-                 ol_dis, av_depth, av_ratio1, av_ratio2, av_score);
+      if (winstart > sc.last_end){  //non-overlapping
+
+        if (sc.last_end != 0){
+          print_region(sc, chr);
         }
 
         // reset ol
-        ol_start  = winstart;
-        ol_end    = window.end;
-        ol_dis    = 0;
-        ol_number = 1;
-        ol_depth  = window.depth;
-        ol_ratio1 = ratio1;
-        ol_ratio2 = ratio2;
-        ol_score  = score;
+        sc.ol_start  = winstart;
+        sc.ol_end    = window.end;
+        sc.ol_dis    = 0;
+        sc.ol_number = 1;
+        sc.ol_depth  = window.depth;
+        sc.ol_ratio1 = ratio1;
+        sc.ol_ratio2 = ratio2;
+        sc.ol_score  = score;
 
       }
      
-      last_chr = chr;
-      last_end = window.end;
+      sc.last_chr = chr;
+      sc.last_end = window.end;
 
     } //merging
   }
 }
+
+inline void print_region(struct scan &sc, const string &chr) {
+
+  sc.ol_dis = sc.ol_end - sc.ol_start + 1;
+  float av_depth  = sc.ol_depth/sc.ol_number;
+  float av_ratio1 = sc.ol_ratio1/sc.ol_number;
+  float av_ratio2 = sc.ol_ratio2/sc.ol_number;
+  float av_score  = sc.ol_score/sc.ol_number;
+
+  if (binfile != NULL) {
+    map <string, int>::const_iterator id = refids.find(chr);
+    struct regrec rec = {(id != refids.end()) ? id->second : -1, sc.ol_start, sc.ol_end, sc.ol_dis,
+                         av_depth, av_ratio1, av_ratio2, av_score};
+    if (sc.buffered) sc.bin.append((const char *)&rec, sizeof(rec));
+    else fwrite(&rec, sizeof(rec), 1, binfile);
+  }
+
+  if (fused == false) {
+    if (binfile != NULL) return;
+    string &dest = scan_dest(sc, false);
+    region_text(dest, chr, sc.ol_start, sc.ol_end, sc.ol_dis, av_depth, av_ratio1, av_ratio2, av_score);
+    dest += '\n';
+    scan_done(sc, false);
+    return;
+  }
+
+  string line;
+  region_text(line, chr, sc.ol_start, sc.ol_end, sc.ol_dis, av_depth, av_ratio1, av_ratio2, av_score);
+  if (binfile == NULL) {
+    string &dest = scan_dest(sc, false);
+    dest += line;
+    dest += '\n';
+    scan_done(sc, false);
+  }
+  mis_region(sc, line);  // screened from the printed (rounded) numbers, as breakmis reads them
+}
+
+inline void mis_add(struct scan &sc, BamAlignment &bam) {
+
+  if (bam.RefID != sc.misref) {   // a new chromosome
+    sc.misreads.clear();
+    sc.misref = bam.RefID;
+  }
+
+  struct misread mr;
+  mis_read(misconf, bam, bam.Qualities.size(), mr);
+  if (mis_piled(sc.mispileup, sc.misoldstart, mr)) return;
+
+  // no region to come can start before the open region or after the last scored window
+  unsigned int lowbound = (sc.last_chr != "SRP") ? sc.ol_start : sc.lastwin + 1;
+  while (!sc.misreads.empty() && sc.misreads.front().end < lowbound) sc.misreads.pop_front();
+
+  sc.misreads.push_back(mr);
+}
+
+inline void mis_region(struct scan &sc, const string &line) {
+
+  deque <struct region> regions;
+  eatline(line, regions);
+  struct region &reg = regions.front();
+
+  // all the reads overlapping the region are buffered by now, they start before the current read
+  unsigned int reach = 0;         // the first read that gets to the region
+  deque <struct misread>::iterator it = sc.misreads.begin();
+  for (; it != sc.misreads.end(); it++) {
+    if (it->start > reg.end) break;
+    if (it->end < reg.start) continue;
+    if (reach == 0) reach = it->start;
+    mis_count(reg, *it, misconf.endlen);
+  }
+  while (!sc.misreads.empty() && sc.misreads.front().end <= reg.end) sc.misreads.pop_front();
+
+  string out;
+  vector <struct misseed> seed;
+  print_mismatch(reg, out, (misseeds != NULL) ? &seed : NULL);
+
+  if (reg.chr != sc.gffchr) {     // the regions of the previous chromosome are final
+    mis_release(sc);
+    sc.gffchr = reg.chr;
+  }
+  struct misrec rec = {reg.end, out, seed};
+  sc.gff.push_back(rec);
+  sc.reach = reach;
+}
+
+inline void mis_release(struct scan &sc) {
+  vector <struct misrec>::iterator it = sc.gff.begin();
+  for (; it != sc.gff.end(); it++) {
+    sc.misout += it->gff;
+    sc.misseed.insert(sc.misseed.end(), it->seed.begin(), it->seed.end());
+  }
+  sc.gff.clear();
+  if (sc.buffered == false) {
+    outfile_write(misgff, sc.misout);
+    sc.misout.clear();
+    if (misseeds != NULL) misseeds->insert(misseeds->end(), sc.misseed.begin(), sc.misseed.end());
+    sc.misseed.clear();
+  }
+}
+
+inline void mis_last(const vector <struct misrec> &gff, unsigned int reach) {
+
+  // breakmis stops at the end of the region file: once a read reaches the last
+  // region, the regions not passed by that read (end >= its start) are never printed
+  vector <struct misrec>::const_iterator it = gff.begin();
+  for (; it != gff.end(); it++) {
+    if (reach != 0 && it->end >= reach) continue;
+    outfile_write(misgff, it->gff);
+    if (misseeds != NULL) misseeds->insert(misseeds->end(), it->seed.begin(), it->seed.end());
+  }
+}
@@ -33,7 +33,12 @@ my $unique = 0;
 my $qual_clip = 0;
 my $mistag = "MD";
 my $unmapped = "";
+my $umrbam = 0;
+my $softclip = 0;
 my $basename = "";
+my $fused = 0;
+my $iothreads = 0;
+my $stream = 0;
 my $help;
 my $BP = "$RealBin/";
 
@@ -55,7 +60,12 @@ GetOptions (
             "mistag=s"     => \$mistag,
             "qualclip"     => \$qual_clip,
             "unmap=s"      => \$unmapped,
+            "umrbam"       => \$umrbam,
+            "softclip"     => \$softclip,
             "basename=s"   => \$basename,
+            "fused"        => \$fused,
+            "iothreads=i"  => \$iothreads,
+            "stream"       => \$stream,
             "help|h"       => \$help,
 	   );
 
@@ -153,11 +163,15 @@ else{
   printf STDERR "read length is $readlen.\n";
 }
 
-if ($unmapped eq ""){
+if ($umrbam and !-x "$BP/breakvali") {
+  printf STDERR "warning: --umrbam needs the compiled breakvali, the unmapped reads will not be taken from the mapping files\n";
+  $umrbam = 0;
+}
+if ($unmapped eq "" and !$umrbam){
   printf STDERR "warning: no unmapped reads file is given, runlevel3 will be skipped\n";
   delete $runlevel{3};
 }
-else {
+elsif ($unmapped ne "") {
   unless ( -r $unmapped ) {
     printf STDERR "warning: $unmapped is not readable or not present.\n";
     exit(0);
@@ -174,6 +188,9 @@ else {
 
 #print Dumper(\%runlevel);
 
+my $streamed = "";   # with --stream: the runlevels so far, piped into the next one
+my @streamfiles;     # and the files they write (tee), removed if the pipe fails
+
 ###
 ###runlevel1:  scan the read alignment, searching for depth skewed regions
 ###
@@ -193,11 +210,26 @@ if (exists $runlevel{$runlevels}) {
     $op_readlen = "--readlen $readlen";
   }
 
-  my $cmd = "$BP/breakpointer $op_mapfile $op_winsize $op_readlen $op_unique >$out_dir/$endskew";
+  my $op_fused = "";
+  my $endskewmis = $basename."\.endskew\.mis\.gff";
+  if ($fused and exists $runlevel{2} and !(-e "$out_dir/$endskewmis")) {  # runlevel 2 in the same pass
+    $op_fused = "--misout $out_dir/$endskewmis";
+    $op_fused .= ($qual_clip)? " --qualclip phred33" : " --qualclip no";
+    $op_fused .= " --mistag $mistag" if ($mistag ne "MD");
+  }
+
+  my $op_iothreads = "";
+  if ($iothreads != 0) {$op_iothreads = "--io-threads $iothreads";}
+
+  my $cmd = "$BP/breakpointer $op_mapfile $op_winsize $op_readlen $op_unique $op_fused $op_iothreads";
   if (-e "$out_dir/$endskew") {
     printf STDERR "$out_dir/$endskew exists, skip running RUNLEVEL 1\n";
+  } elsif ($stream and $op_fused eq "" and exists $runlevel{2} and !(-e "$out_dir/$endskewmis")) {  # regions go on as they are written
+    $streamed = "$cmd | tee $out_dir/$endskew";
+    push @streamfiles, "$out_dir/$endskew";
+    printf STDERR "RUNLEVEL 1 is streamed into RUNLEVEL 2\n";
   } else {
-    RunCommand($cmd,$noexecute);
+    RunCommand("$cmd >$out_dir/$endskew",$noexecute);
   }
   printf "RUNLEVEL 1 done\n";
 }
@@ -213,12 +245,13 @@ if (exists $runlevel{$runlevels}) {
   printf STDERR "RUNLEVEL 2: mismatch screening for each depth skewed region\n";
 
   my $region_f = "$out_dir/$basename.endskew";
-  unless (-r $region_f){
+  unless ($streamed ne "" or -r $region_f){
     printf STDERR "warning: $region_f is not readable!\n";
   }
 
   my $endskewmis = $basename."\.endskew\.mis\.gff";
   my $op_regionf = "--region $region_f";
+  if ($streamed ne "") {$op_regionf = "--region -";}   # from runlevel 1 through the pipe
   my $op_mapping = "--mapping $mapfile";
   my $op_readlen = "";
   if ($readlen != 0) {
@@ -237,11 +270,26 @@ if (exists $runlevel{$runlevels}) {
     $op_mistag = "--mistag $mistag";
   }
 
-  my $cmd = "$BP/breakmis $op_regionf $op_mapping $op_readlen $op_unique $op_qualclip $op_mistag >$out_dir/$endskewmis";
+  my $op_iothreads = "";
+  if ($iothreads != 0) {
+    $op_iothreads = "--io-threads $iothreads";
+  }
+
+  my $cmd = "$BP/breakmis $op_regionf $op_mapping $op_readlen $op_unique $op_qualclip $op_mistag $op_iothreads";
+  my $piped = ($streamed ne "");
+  if ($piped) {$cmd = "$streamed | $cmd";}
+  $streamed = "";
+  my $vali = $basename."\.endskew\.mis\.vali\.gff";
   if (-e "$out_dir/$endskewmis") {
     printf STDERR "$out_dir/$endskewmis exists, skip running RUNLEVEL 2\n";
+  } elsif ($stream and exists $runlevel{3} and -x "$BP/breakvali" and !(-e "$out_dir/$vali")) {
+    $streamed = "$cmd | tee $out_dir/$endskewmis";
+    push @streamfiles, "$out_dir/$endskewmis";
+    printf STDERR "RUNLEVEL 2 is streamed into RUNLEVEL 3\n";
+  } elsif ($piped) {
+    RunStream("$cmd >$out_dir/$endskewmis",$noexecute,@streamfiles,"$out_dir/$endskewmis");
   } else {
-    RunCommand($cmd,$noexecute);
+    RunCommand("$cmd >$out_dir/$endskewmis",$noexecute);
   }
   printf STDERR "RUNLEVEL 2 done\n";
 
@@ -257,21 +305,33 @@ if ( exists $runlevel{$runlevels} ) {
   printf STDERR "RUNLEVEL 3: validation using unmapped reads\n";
 
   my $vali = $basename."\.endskew\.mis\.vali\.gff";
-  my $op_umr = "--umr $unmapped";
+  my $op_umr = "";
+  if ($unmapped ne "") {$op_umr = "--umr $unmapped";}
   my $op_readlen = "--readlen 36";
   if ($readlen != 0) {
     $op_readlen = "--readlen $readlen";
   }
   my $ermis = $basename."\.endskew\.mis\.gff";
-  unless (-e "$out_dir/$ermis") {
+  unless ($streamed ne "" or -e "$out_dir/$ermis") {
     printf "warning: $out_dir/$ermis is not readable.\n";
     exit(0);
   }
   my $op_ermis = "--ermis $out_dir/$ermis";
+  if ($streamed ne "") {$op_ermis = "--ermis -";}     # from runlevel 2 through the pipe
 
   my $cmd = "perl $BP/breakvali.pl $op_umr $op_readlen $op_ermis --verbose >$out_dir/$vali";
+  if (-x "$BP/breakvali") {   # the compiled one, the script stays as the fallback
+    my $op_threads = "";
+    if ($iothreads != 0) {$op_threads = "--threads $iothreads";}
+    my $op_umrbam = "";
+    if ($umrbam) {$op_umrbam = "--mapping $mapfile";}   # the unmapped reads at the end of the BAM files
+    if ($umrbam and $softclip) {$op_umrbam .= " --softclip";}
+    $cmd = "$BP/breakvali $op_umr $op_umrbam $op_readlen $op_ermis $op_threads --verbose >$out_dir/$vali";
+  }
   if (-e "$out_dir/$vali") {
     printf STDERR "$out_dir/$vali exists, skip running RUNLEVEL 3\n";
+  } elsif ($streamed ne "") {
+    RunStream("$streamed | $cmd",$noexecute,@streamfiles,"$out_dir/$vali");
   } else {
     RunCommand($cmd,$noexecute);
   }
@@ -295,6 +355,18 @@ sub RunCommand {
 }
 
 
+sub RunStream {   # the streamed runlevels in one pipe: any of them failing fails it, and its files are removed
+  my ($command,$noexecute,@files) = @_ ;
+  print STDERR "$command\n";
+  return if ($noexecute);
+  system("bash", "-o", "pipefail", "-c", $command);
+  if ($? != 0) {
+    my $status = ($? == -1)? "bash could not be run" : ($? & 127)? "signal ".($? & 127) : "exit status ".($? >> 8);
+    unlink(@files);
+    die "the streamed runlevels failed ($status), removed the partial @files\n";
+  }
+}
+
 sub printtime {
   my @time = localtime(time);
   printf STDERR "\n[".($time[5]+1900)."\/".($time[4]+1)."\/".$time[3]." ".$time[2].":".$time[1].":".$time[0]."]\t";
@@ -314,8 +386,13 @@ sub helpm {
   print "\t\t\t\t\trunlevel 1: scan the read alignment, searching for depth skewed regions;\n";
   print "\t\t\t\t\trunlevel 2: mismatch screeing for each depth skewed region;\n";
   print "\t\t\t\t\trunlevel 3: validate each candidate region by looking for support from unmappable reads.\n";
-  print "\t--unmap\t\t<string>\tFile containing unmapped reads, either one file or a file listing the names of multiple files. must be fasta/fastq format.\n";
+  print "\t--unmap\t\t<string>\tFile containing unmapped reads, either one file or a file listing the names of multiple files. must be fasta/fastq format (plain, or gzip/bgzip for the compiled breakvali).\n";
+  print "\t--umrbam\t\t\ttake the unmapped reads of runlevel 3 from the end of the mapping files (jumped to by the .bai index), instead of or as well as --unmap.\n";
+  print "\t--softclip\t\t\twith --umrbam, also take the soft clipped ends of the mapped reads (the whole mapping files are read).\n";
   print "\t--basename\t<string>\tthe basename of the output files (default: take the basename of the mapping files)\n";
+  print "\t--fused\t\t\t\trun the mismatch screening (runlevel 2) in the same pass over the BAM files as runlevel 1.\n";
+  print "\t--stream\t\t\tconnect the runlevels with pipes, so that runlevel 2 screens the regions as runlevel 1 writes them and runlevel 3 loads the\n\t\t\t\t\tcandidates as runlevel 2 writes them; the intermediate files are still written (tee).\n\t\t\t\t\tThe pipe runs with pipefail: if a runlevel in it fails, the run stops and the files of the pipe are removed. Runlevel 1 and 2 are one pass anyway with --fused.\n";
+  print "\t--iothreads\t<int>\t\tinflate the BAM blocks on this many threads per file in runlevel 1 and 2 (default: 0, read through bamtools), and scan the unmapped reads on this many threads in runlevel 3.\n";
   print "\t--help\t\t\t\tprint this help message.\n\n\n";
   exit 0;
 }
@@ -0,0 +1,61 @@
+/*****************************************************************************
+
+  breakregions.cpp @ Breakpointer
+  The binary region file of breakpointer --binout as the text region file
+  breakpointer prints to stdout without it, line for line the same.
+
+  (c) 2011 - Sun Ruping
+  Dept. Vingron (Computational Mol. Bio.)
+  Max-Planck-Institute for Molecular Genetics
+  Ihnestr. 73, D-14195, Berlin, Germany
+
+  current affiliation: Department of Systems Biology, Columbia University, NY, USA
+  EMAIL: rs3412@columbia.edu
+
+  Breakpointer is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License.
+
+******************************************************************************/
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include "ifbr.h"
+#include "regbin.h"
+
+using namespace std;
+
+int main (int argc, char *argv[]) {
+
+  struct parameters *param = 0;
+  param = interface(param, argc, argv);
+
+  struct regbin rb;
+  if ( !regbin_is(param->region_f) || !regbin_open(rb, param->region_f) ) {
+    fprintf(stderr, "%s is not a binary region file of breakpointer\n", param->region_f);
+    exit(1);
+  }
+
+  if (param->header) {
+    printf("#windowsize\t%u\n#readlen\t%u\n#unique\t%u\n", rb.windowsize, rb.readlen, rb.unique);
+    for (unsigned int r = 0; r < rb.names.size(); r++) {
+      printf("#reference\t%s\t%u\n", rb.names[r].c_str(), rb.lens[r]);
+    }
+  }
+
+  vector <char> buf(1024);
+  for (size_t i = 0; i < rb.nrec; i++) {
+    int n = regbin_line(rb, rb.recs[i], param->exact, &buf[0], buf.size());
+    if (n >= (int)buf.size()) {        // a very long chromosome name
+      buf.resize(n + 1);
+      regbin_line(rb, rb.recs[i], param->exact, &buf[0], buf.size());
+    }
+    buf[n] = '\n';
+    fwrite(&buf[0], 1, n + 1, stdout);
+  }
+
+  regbin_close(rb);
+  delete_param(param);
+  return 0;
+}
@@ -0,0 +1,126 @@
+/*****************************************************************************
+
+  breaktrace.cpp @ Breakpointer
+  The window trace of breakpointer --window-trace as the text --indiprint
+  writes, filtered by region and score. Blocks of the trace that lie
+  outside the region or score below the threshold are skipped without
+  decoding them (see wintrace.h).
+
+  (c) 2011 - Sun Ruping
+  Dept. Vingron (Computational Mol. Bio.)
+  Max-Planck-Institute for Molecular Genetics
+  Ihnestr. 73, D-14195, Berlin, Germany
+
+  current affiliation: Department of Systems Biology, Columbia University, NY, USA
+  EMAIL: rs3412@columbia.edu
+
+  Breakpointer is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License.
+
+******************************************************************************/
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include "ifbt.h"
+#include "outbuf.h"
+#include "wintrace.h"
+
+using namespace std;
+
+inline bool parse_region(const string &spec, string &chr, unsigned int &from, unsigned int &to);
+
+int main (int argc, char *argv[]) {
+
+  struct parameters *param = 0;
+  param = interface(param, argc, argv);
+
+  struct wtreader rd;
+  if ( !wt_readopen(rd, param->trace_f) ) {
+    fprintf(stderr, "%s is not a window trace of breakpointer\n", param->trace_f);
+    exit(1);
+  }
+
+  int refid = -2;                      // -2 for all references
+  unsigned int from = 0, to = 0xffffffff;
+  if (param->region != 0) {
+    string chr;
+    parse_region(param->region, chr, from, to);
+    refid = -1;
+    for (unsigned int r = 0; r < rd.names.size(); r++) {
+      if (rd.names[r] == chr) refid = r;
+    }
+    if (refid == -1) {
+      fprintf(stderr, "%s is not a reference of the trace\n", chr.c_str());
+      exit(1);
+    }
+  }
+  double minscore = param->score;
+
+  struct outfile out;
+  outfile_open(out, stdout, false);
+  if (param->header) {
+    out.buf += "#windowsize\t";
+    out_uint(out.buf, rd.windowsize);
+    out.buf += "\n#readlen\t";
+    out_uint(out.buf, rd.readlen);
+    out.buf += '\n';
+    for (unsigned int r = 0; r < rd.names.size(); r++) {
+      out.buf += "#reference\t" + rd.names[r] + '\t';
+      out_uint(out.buf, rd.lens[r]);
+      out.buf += '\n';
+    }
+  }
+
+  struct wtread blk;
+  unsigned long long windows = 0, blocks = 0, skipped = 0;
+  while (wt_next(rd, blk)) {
+    blocks++;
+    bool wanted = true;
+    if (refid != -2 && blk.refid != refid) wanted = false;
+    if (blk.first > to || (unsigned long long)blk.last + rd.windowsize < from) wanted = false;  // a window spans < windowsize
+    if (blk.maxscore < minscore) wanted = false;
+    if (!wanted) {
+      skipped++;
+      if (!wt_skip(rd, blk)) break;
+      continue;
+    }
+    if (!wt_columns(rd, blk)) break;
+    const struct wtblock &b = blk.block;
+    const string &chr = (blk.refid >= 0 && (size_t)blk.refid < rd.names.size()) ? rd.names[blk.refid] : "*";
+    for (unsigned int i = 0; i < blk.windows; i++) {
+      unsigned int end = b.start[i] + b.span[i];
+      if (b.start[i] > to || end < from || b.score[i] < minscore) continue;
+      wt_text(out.buf, chr, b.start[i], end, b.depth[i], b.deps[i], b.depe[i], b.score[i]);
+      outfile_check(out);
+      windows++;
+    }
+  }
+  outfile_close(out);
+  fprintf(stderr, "%llu windows printed, %llu of %llu blocks skipped\n", windows, skipped, blocks);
+
+  fclose(rd.fp);
+  delete_param(param);
+  return 0;
+}
+
+inline bool parse_region(const string &spec, string &chr, unsigned int &from, unsigned int &to) {
+
+  // chr or chr:start-end, a chromosome name may hold a colon itself
+  chr = spec;
+  string::size_type colon = spec.rfind(':');
+  if (colon == string::npos) return false;
+  string range = spec.substr(colon + 1);
+  string::size_type dash = range.find('-');
+  if (dash == string::npos || dash == 0 || dash + 1 == range.size()) return false;
+  if (range.find_first_not_of("0123456789,-") != string::npos) return false;
+  string a = range.substr(0, dash), b = range.substr(dash + 1);
+  string::size_type comma;
+  while ((comma = a.find(',')) != string::npos) a.erase(comma, 1);
+  while ((comma = b.find(',')) != string::npos) b.erase(comma, 1);
+  chr  = spec.substr(0, colon);
+  from = strtoul(a.c_str(), NULL, 10);
+  to   = strtoul(b.c_str(), NULL, 10);
+  return true;
+}
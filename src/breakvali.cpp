@@ -0,0 +1,760 @@
+/*****************************************************************************
+
+  breakvali.cpp @ Breakpointer
+  Validation of the candidate regions with the unmapped reads: the seed of
+  each region (and its reverse complement) is looked up at every offset of
+  every unmapped read, the regions with support get SU, rank_SB, rank_SM
+  and RankScore. The same output as breakvali.pl, which stays as the
+  fallback.
+
+  The seeds are 25-mers packed 2 bits per base into 64-bit keys of an
+  open-addressing table (pileup.h); a read is encoded once with a rolling
+  key, so each offset is one table probe. Seeds that are not 25 of ACGT
+  (N, lower case, short reads, read names) are kept as strings and only
+  looked up when there are any.
+
+  The unmapped reads may be fasta or fastq, plain, gzip or bgzip (seqin.h).
+  With --threads N the file is cut into chunks of whole lines, the reader
+  keeps track of the records across them and N workers scan the chunks.
+  Each worker marks the read offsets a seed was found first at in its own
+  bits; these are merged at the end, so a seed still counts once per
+  offset whichever worker saw it.
+
+  With --mapping the unmapped reads are also taken from the end of the BAM
+  files, where the reads without a reference are kept; the index tells
+  where the last placed record ends, so only that part is read (bamin.h).
+  With --softclip the whole files are read for the soft clipped ends of
+  the mapped reads and the unmapped reads placed by their mates as well.
+  Their bases go to the workers as chunks of one read per line.
+
+  In breakpointer-pipeline the regions screened by runlevel 2 come as
+  structs (misseeds, see mismatch.h) instead of from the --ermis file, and
+  the BAM files of --mapping are the ones runlevel 1 or 2 kept open
+  (bamkept), with their indexes already at hand.
+
+  (c) 2011 - Sun Ruping
+  Dept. Vingron (Computational Mol. Bio.)
+  Max-Planck-Institute for Molecular Genetics
+  Ihnestr. 73, D-14195, Berlin, Germany
+
+  current affiliation: Department of Systems Biology, Columbia University, NY, USA
+  EMAIL: rs3412@columbia.edu
+
+  Breakpointer is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License.
+
+******************************************************************************/
+
+#include <iostream>
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <cmath>
+#include <vector>
+#include <map>
+#include <deque>
+#include <string>
+#include <algorithm>
+#include <stdint.h>
+#include <glob.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "ifbv.h"
+#include "pileup.h"
+#include "seqin.h"
+#include "bamin.h"
+#include "mismatch.h"
+
+using namespace std;
+using namespace BamTools;
+
+#define SEEDLEN 25
+#define VALI_CHUNK (4 << 20)     //bytes of an unmapped reads file read (and handed to a worker) at a time
+
+//a candidate region of the mismatch file
+struct valiregion {
+  string id;
+  string sb;                     //BinomialScore
+  string sm;                     //the mismatch score, column 6
+  string dd1;                    //columns 1-5
+  string dd2;                    //columns 7-9
+  unsigned long long su;         //supporting reads
+  unsigned int rank_sb;
+  unsigned int rank_sm;
+};
+
+//the seeds and their reverse complements, each distinct sequence is one key
+struct seedset {
+  struct pileup packed;          //packed 25-mer -> key
+  map <string, unsigned int> odd;     //any other seed sequence -> key
+  vector <unsigned long long> hits;   //per key: reads it was found in first, once per read offset
+  unsigned int nwords;           //per key: words of the read offsets it was found first at
+  vector < pair <unsigned int, unsigned int> > owners;  //(key, region), once per seed and strand
+};
+
+//where the parsing of an unmapped reads file is at the start of a line
+struct umrstate {
+  char type;                     //0 not known yet, 'a' fasta, 'q' fastq, 'b' bases only (from BAM)
+  unsigned int next;             //0 a header may come, 1 the bases, 2 and 3 the fastq lines after them
+};
+
+//whole lines of an unmapped reads file
+struct umrchunk {
+  string data;
+  struct umrstate state;         //at its first line
+};
+
+//for the --threads workers: chunks in file order, scanned by whoever is free
+struct umrjobs {
+  struct seedset *ss;
+  int readlen;
+  deque <struct umrchunk *> chunks;
+  bool eof;                      //all chunks are in
+  vector < vector <uint64_t> > seen;  //per worker: the read offsets each key was found first at
+  pthread_mutex_t lock;
+  pthread_cond_t  more;          //a chunk was added
+  pthread_cond_t  room;          //a chunk was taken
+};
+
+struct umrworker {
+  struct umrjobs *job;
+  vector <uint64_t> *seen;
+};
+
+//the regions and their seeds as they are loaded
+struct seedload {
+  struct seedset *ss;
+  vector <struct valiregion> *regions;
+  map <string, unsigned int> regionid;     //a repeated ID takes the last line, as the hash did
+  map <string, string> *reads;             //NULL without --reads
+  int readlen;
+  bool verbose;
+};
+
+//breakpointer-pipeline (pipeline.cpp): the screened regions instead of --ermis, and
+//the BAM files of --mapping left open by the stage before
+vector <struct misseed> *misseeds = NULL;
+struct bamin *bamkept = NULL;
+
+inline void vali_files(const char *input, vector <string> &files);
+inline bool vali_line(FILE *fp, char *&buf, size_t &cap, string &line);
+inline void chomp(string &line);
+inline string perl_substr(const string &str, long offset, long length);
+inline string revcomp(const string &seq);
+inline double perl_num(const string &str);
+inline void vali_reads(const char *reads_f, bool verbose, map <string, string> &reads);
+inline bool vali_tag(const string &tag, string &id, string &sb, string &seedseq);
+inline bool vali_readtag(const string &seedseq, string &rname, string &cutype);
+inline void vali_seed(struct seedload &sl, const struct misseed &seed);
+inline bool seed_pack(const char *seq, unsigned int len, uint64_t &key);
+inline unsigned int seed_add(struct seedset &ss, const string &seq);
+inline void seed_scan(struct seedset &ss, vector <uint64_t> &seen, const char *line, unsigned int len, int readlen);
+inline unsigned long long umr_lines(struct seedset &ss, vector <uint64_t> *seen, const char *p, size_t len, struct umrstate &st, int readlen);
+inline void umr_feed(struct umrjobs &job, vector <uint64_t> &seen, struct umrchunk *uc, struct umrstate &st, unsigned long long &count, bool verbose);
+inline void umr_bam(struct umrjobs &job, vector <uint64_t> &seen, const char *mapping_f, bool softclip, unsigned int threads, unsigned long long &count, bool verbose);
+void *umr_worker(void *arg);
+inline bool sb_before(const struct valiregion *a, const struct valiregion *b);
+inline bool sm_before(const struct valiregion *a, const struct valiregion *b);
+
+static signed char base2bit[256];
+
+int main (int argc, char *argv[]) {
+
+  struct parameters *param = 0;
+  param = interface(param, argc, argv);
+
+  int readlen  = param->readlen;
+  bool verbose = (param->verbose == 1);
+
+  for (unsigned int c = 0; c < 256; c++) base2bit[c] = -1;
+  base2bit['A'] = 0; base2bit['C'] = 1; base2bit['G'] = 2; base2bit['T'] = 3;
+
+  vector <string> umr_files;
+  vali_files(param->umr_f, umr_files);
+  if (verbose) {
+    cerr << "Input unmapped reads file is:" << endl;
+    for (unsigned int i = 0; i < umr_files.size(); i++) cerr << umr_files[i] << ((i + 1 < umr_files.size()) ? "\n" : "");
+    cerr << endl;
+  }
+
+  // reads files to read
+  map <string, string> reads;
+  if (param->reads_f != 0) vali_reads(param->reads_f, verbose, reads);
+
+//-------------------------------------------------------------------------------------------------------+
+// the seeds of the mismatch file                                                                        |
+//-------------------------------------------------------------------------------------------------------+
+  struct seedset ss;
+  pileup_init(ss.packed, 1024);
+  ss.nwords = (readlen >= SEEDLEN) ? (readlen - SEEDLEN) / 64 + 1 : 1;
+
+  vector <struct valiregion> regions;
+  struct seedload sl;
+  sl.ss      = &ss;
+  sl.regions = &regions;
+  sl.reads   = (param->reads_f != 0) ? &reads : NULL;
+  sl.readlen = readlen;
+  sl.verbose = verbose;
+
+  char *buf = NULL;
+  size_t cap = 0;
+  string line;
+  string ID, S_B, seedseq;                 //the captures of the tag, kept from the last match like $1 - $3
+  bool streamed = (param->ermis_f != 0 && strcmp(param->ermis_f, "-") == 0);   // from stdin, as breakmis writes it
+  FILE *ER = (misseeds != NULL) ? NULL : streamed ? stdin : (param->ermis_f != 0) ? fopen(param->ermis_f, "r") : NULL;
+  for (unsigned int i = 0; misseeds != NULL && i < misseeds->size(); i++) vali_seed(sl, (*misseeds)[i]);
+  while (ER != NULL && vali_line(ER, buf, cap, line)) {
+
+    if (line[0] == '#') {                  //a match without captures, $1 - $3 are gone
+      ID.clear();
+      S_B.clear();
+      seedseq.clear();
+      continue;
+    }
+    chomp(line);
+    vector <string> cols;
+    string::size_type from = 0;
+    while (1) {
+      string::size_type tab = line.find('\t', from);
+      cols.push_back(line.substr(from, (tab == string::npos) ? string::npos : tab - from));
+      if (tab == string::npos) break;
+      from = tab + 1;
+    }
+    while (!cols.empty() && cols.back().empty()) cols.pop_back();   //as split drops trailing empty fields
+    cols.resize(9);
+
+    vali_tag(cols[8], ID, S_B, seedseq);
+    struct misseed seed;
+    seed.head    = cols[0] + "\t" + cols[1] + "\t" + cols[2] + "\t" + cols[3] + "\t" + cols[4];
+    seed.score   = cols[5];
+    seed.tail    = cols[6] + "\t" + cols[7] + "\t" + cols[8];
+    seed.id      = ID;
+    seed.sb      = S_B;
+    seed.seedseq = seedseq;
+    vali_seed(sl, seed);
+  }
+  if (ER != NULL && !streamed) fclose(ER);
+  if (verbose) {
+    if (misseeds != NULL) cerr << "the screened regions of runlevel 2 loaded" << endl;
+    else cerr << ((param->ermis_f != 0) ? param->ermis_f : "") << " loaded" << endl;
+    cerr << ss.hits.size() << endl;
+  }
+  free(buf);
+
+//-------------------------------------------------------------------------------------------------------+
+// check each unmappable read                                                                            |
+//-------------------------------------------------------------------------------------------------------+
+  unsigned int threads = (param->threads > 1) ? param->threads : 1;
+  struct umrjobs job;
+  job.ss      = &ss;
+  job.readlen = readlen;
+  job.eof     = false;
+  job.seen.resize(threads);        // the offsets counted, per worker and the reader
+  for (unsigned int w = 0; w < threads; w++) job.seen[w].assign((size_t)ss.hits.size() * ss.nwords, 0);
+  pthread_mutex_init(&job.lock, NULL);
+  pthread_cond_init(&job.more, NULL);
+  pthread_cond_init(&job.room, NULL);
+  vector <pthread_t> workers(threads > 1 ? threads : 0);
+  for (unsigned int t = 0; t < workers.size(); t++) {
+    struct umrworker *uw = new struct umrworker;
+    uw->job  = &job;
+    uw->seen = &job.seen[t];
+    pthread_create(&workers[t], NULL, umr_worker, uw);
+  }
+  vector <uint64_t> seen((size_t)ss.hits.size() * ss.nwords, 0);   // the reader's own, one thread or the end of a file
+
+  unsigned long long count = 0;
+  vector <char> chunk(VALI_CHUNK);
+  for (unsigned int f = 0; f < umr_files.size(); f++) {
+
+    struct seqin in;
+    struct umrstate st = {0, 0};
+    string rest;                       // a line cut by the end of a chunk
+    bool opened = seqin_open(in, umr_files[f], threads);
+    while (opened) {
+
+      size_t got = seqin_read(in, &chunk[0], chunk.size());
+      struct umrchunk *uc = new struct umrchunk;
+      uc->data.swap(rest);
+      uc->data.append(&chunk[0], got);
+      if (got > 0) {                   // whole lines only, the rest goes with the next chunk
+        size_t cut = uc->data.rfind('\n');
+        if (cut == string::npos) cut = 0;
+        else cut++;
+        rest.assign(uc->data, cut, string::npos);
+        uc->data.resize(cut);
+      }
+      umr_feed(job, seen, uc, st, count, verbose);
+      if (got == 0) break;
+    }
+    if (st.next == 1) {                // a header at the end of the file, its bases are empty
+      seed_scan(ss, seen, "", 0, readlen);
+      count++;
+    }
+    if (opened) seqin_close(in);
+    cerr << umr_files[f] << " finished" << endl;
+  }
+  if (param->mapping_f != 0) umr_bam(job, seen, param->mapping_f, param->softclip == 1, threads, count, verbose);
+
+  pthread_mutex_lock(&job.lock);
+  job.eof = true;
+  pthread_cond_broadcast(&job.more);
+  pthread_mutex_unlock(&job.lock);
+  for (unsigned int t = 0; t < workers.size(); t++) {
+    pthread_join(workers[t], NULL);
+  }
+  pthread_mutex_destroy(&job.lock);
+  pthread_cond_destroy(&job.more);
+  pthread_cond_destroy(&job.room);
+
+  // a seed counts once per read offset it was found first at, in any of the workers
+  for (unsigned int w = 0; w < job.seen.size(); w++) {
+    for (size_t i = 0; i < seen.size(); i++) seen[i] |= job.seen[w][i];
+  }
+  for (unsigned int k = 0; k < ss.hits.size(); k++) {
+    for (unsigned int i = 0; i < ss.nwords; i++) ss.hits[k] += __builtin_popcountll(seen[(size_t)k * ss.nwords + i]);
+  }
+
+  // count the number of supporting reads
+  for (unsigned int i = 0; i < ss.owners.size(); i++) {
+    regions[ss.owners[i].second].su += ss.hits[ss.owners[i].first];
+  }
+
+//-------------------------------------------------------------------------------------------------------+
+// sorting and output, the supported regions in the order of the mismatch file                           |
+//-------------------------------------------------------------------------------------------------------+
+  vector <struct valiregion *> supported;
+  for (unsigned int r = 0; r < regions.size(); r++) {
+    if (regions[r].su != 0) supported.push_back(&regions[r]);
+  }
+  vector <struct valiregion *> ranked(supported);
+  stable_sort(ranked.begin(), ranked.end(), sb_before);
+  for (unsigned int i = 0; i < ranked.size(); i++) ranked[i]->rank_sb = i + 1;
+  ranked = supported;
+  stable_sort(ranked.begin(), ranked.end(), sm_before);
+  for (unsigned int i = 0; i < ranked.size(); i++) ranked[i]->rank_sm = i + 1;
+
+  //combining
+  double n = supported.size();
+  char rank_SB[64], rank_SM[64], RankScore[64];
+  for (unsigned int i = 0; i < supported.size(); i++) {
+    const struct valiregion &reg = *supported[i];
+    snprintf(rank_SB, sizeof(rank_SB), "%.3f", reg.rank_sb * 100 / n);
+    snprintf(rank_SM, sizeof(rank_SM), "%.3f", reg.rank_sm * 100 / n);
+    snprintf(RankScore, sizeof(RankScore), "%.3f", (atof(rank_SB) + atof(rank_SM)) / 2);
+    printf("%s\t%s\t%s;MismatchScore=%s;SU=%llu;rank_SB=%s;rank_SM=%s\n", reg.dd1.c_str(), RankScore,
+           reg.dd2.c_str(), reg.sm.c_str(), reg.su, rank_SB, rank_SM);
+  }
+
+  delete_param(param);
+  return 0;
+
+} //main
+
+inline void vali_files(const char *input, vector <string> &files) {
+
+  // a file, a glob or a file listing the files (Fof.pm)
+  files.clear();
+  string patterns = (input != 0) ? input : "";
+  glob_t g;
+  int flags = GLOB_NOMAGIC | GLOB_BRACE | GLOB_TILDE;
+  bool globbed = false;
+  string::size_type from = patterns.find_first_not_of(" \t\n");
+  while (from != string::npos) {
+    string::size_type to = patterns.find_first_of(" \t\n", from);
+    string pattern = patterns.substr(from, (to == string::npos) ? string::npos : to - from);
+    if (glob(pattern.c_str(), flags | (globbed ? GLOB_APPEND : 0), NULL, &g) == 0 || globbed) globbed = true;
+    from = patterns.find_first_not_of(" \t\n", to);
+  }
+  if (globbed) {
+    for (size_t i = 0; i < g.gl_pathc; i++) files.push_back(g.gl_pathv[i]);
+    globfree(&g);
+  }
+  if (files.empty()) return;
+
+  vector <string> fof;
+  FILE *fp = fopen(files[0].c_str(), "r");
+  char *buf = NULL;
+  size_t cap = 0;
+  string line;
+  unsigned int nr = 0;
+  while (fp != NULL && vali_line(fp, buf, cap, line) && (nr < 20 || !fof.empty())) {
+    if (line[0] == '#' || line[0] == '@') continue;   //skip comment
+    string::size_type end = line.find_first_of(" \t\n\r\f\v");
+    if (end != 0) {
+      string name = line.substr(0, end);
+      if (access(name.c_str(), R_OK) == 0) fof.push_back(name);
+    }
+    nr++;
+  }
+  if (fp != NULL) fclose(fp);
+  free(buf);
+  if (!fof.empty()) files = fof;
+}
+
+inline bool vali_line(FILE *fp, char *&buf, size_t &cap, string &line) {
+  // the next line with its newline, false at the end of the file
+  ssize_t len = getline(&buf, &cap, fp);
+  if (len < 0) return false;
+  line.assign(buf, len);
+  return true;
+}
+
+inline void chomp(string &line) {
+  if (!line.empty() && line[line.size() - 1] == '\n') line.resize(line.size() - 1);
+}
+
+inline string perl_substr(const string &str, long offset, long length) {
+
+  // substr as perl does it, a negative offset counts from the end; outside of the string gives ""
+  long len = str.size();
+  long b = (offset < 0) ? offset + len : offset;
+  if (b > len) return "";
+  long e = b + length;
+  if (b < 0) b = 0;
+  if (e > len) e = len;
+  if (e <= b) return "";
+  return str.substr(b, e - b);
+}
+
+inline string revcomp(const string &seq) {
+  // reverse, then tr/ACGT/TGCA/
+  string rc(seq.rbegin(), seq.rend());
+  for (unsigned int i = 0; i < rc.size(); i++) {
+    switch (rc[i]) {
+    case 'A': rc[i] = 'T'; break;
+    case 'C': rc[i] = 'G'; break;
+    case 'G': rc[i] = 'C'; break;
+    case 'T': rc[i] = 'A'; break;
+    }
+  }
+  return rc;
+}
+
+inline double perl_num(const string &str) {
+
+  // the number of a string as perl takes it for <=>: the leading decimal number, no hex, NaN as 0
+  const char *p = str.c_str();
+  while (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r' || *p == '\f') p++;
+  const char *q = (*p == '+' || *p == '-') ? p + 1 : p;
+  if (q[0] == '0' && (q[1] == 'x' || q[1] == 'X')) return 0;
+  double v = strtod(p, NULL);
+  return isnan(v) ? 0 : v;
+}
+
+inline void vali_reads(const char *reads_f, bool verbose, map <string, string> &reads) {
+
+  vector <string> reads_files;
+  vali_files(reads_f, reads_files);
+  if (verbose) {
+    cerr << "Input reads file is:" << endl;
+    for (unsigned int i = 0; i < reads_files.size(); i++) cerr << reads_files[i] << ((i + 1 < reads_files.size()) ? "\n" : "");
+    cerr << endl;
+  }
+
+  char *buf = NULL;
+  size_t cap = 0;
+  string line;
+  for (unsigned int f = 0; f < reads_files.size(); f++) {
+    char type = 0;
+    FILE *fp = fopen(reads_files[f].c_str(), "r");
+    while (fp != NULL && vali_line(fp, buf, cap, line)) {
+      chomp(line);
+      if (type == 0 && line[0] == '@') type = 'q';
+      if (type == 0 && line[0] == '>') type = 'a';
+      if (type == 'q' && line.size() > 1 && line[0] == '@') {
+        string rname = line.substr(1);
+        if (!vali_line(fp, buf, cap, line)) line.clear();
+        chomp(line);
+        reads[rname] = line;
+        vali_line(fp, buf, cap, line);
+        vali_line(fp, buf, cap, line);
+        continue;
+      }
+      if (type == 'a' && line[0] == '>') {
+        string::size_type bar = line.find('|', 2);
+        if (bar == string::npos) continue;
+        string rname = line.substr(1, bar - 1);
+        if (!vali_line(fp, buf, cap, line)) line.clear();
+        chomp(line);
+        reads[rname] = line;
+      }
+    }
+    if (fp != NULL) fclose(fp);
+    if (verbose) cerr << reads_files[f] << " loaded" << endl;
+  }
+  free(buf);
+}
+
+inline bool vali_tag(const string &tag, string &id, string &sb, string &seedseq) {
+
+  // /^ID=(.+?);.+BinomialScore=(.+?);.+seedseq=(.+)$/, the captures are left as they are if it does not match
+  if (tag.compare(0, 3, "ID=") != 0) return false;
+  string::size_type idend = tag.find(';', 4);
+  if (idend == string::npos) return false;
+
+  string::size_type q = tag.rfind("seedseq=");                 // the last one with a base after it
+  while (q != string::npos && q + 8 >= tag.size()) q = (q == 0) ? string::npos : tag.rfind("seedseq=", q - 1);
+  if (q == string::npos) return false;
+
+  string::size_type b = tag.rfind("BinomialScore=");           // the last one the rest matches after
+  while (b != string::npos && b >= idend + 2) {
+    string::size_type e = tag.find(';', b + 15);
+    if (e != string::npos && q >= e + 2) {
+      id = tag.substr(3, idend - 3);
+      sb = tag.substr(b + 14, e - b - 14);
+      seedseq = tag.substr(q + 8);
+      return true;
+    }
+    b = (b == 0) ? string::npos : tag.rfind("BinomialScore=", b - 1);
+  }
+  return false;
+}
+
+inline bool vali_readtag(const string &seedseq, string &rname, string &cutype) {
+
+  // /^(.+?)\|.+\[(.+)\]/
+  string::size_type bar = seedseq.find('|', 1);
+  string::size_type close = seedseq.rfind(']');
+  if (bar == string::npos || close == string::npos || close < 2) return false;
+  string::size_type open = seedseq.rfind('[', close - 2);
+  if (open == string::npos || open < bar + 2) return false;
+  rname  = seedseq.substr(0, bar);
+  cutype = seedseq.substr(open + 1, close - open - 1);
+  return true;
+}
+
+inline void vali_seed(struct seedload &sl, const struct misseed &seed) {
+
+  // the seed of a region and its reverse complement, cut from the read of the tag with --reads
+  if (seed.seedseq == "RME") return;
+
+  string cut = seed.seedseq;
+  if (sl.reads != NULL) {  //gff, need reads
+    string rname, cutype;
+    if (!vali_readtag(seed.seedseq, rname, cutype)) {  //the captures of the last match
+      rname  = seed.id;
+      cutype = seed.sb;
+    }
+    map <string, string>::iterator rit = sl.reads->find(rname);
+    string readseq = (rit != sl.reads->end()) ? rit->second : "";
+    if (cutype == "+p")      cut = perl_substr(readseq, 0, SEEDLEN);
+    else if (cutype == "+s") cut = perl_substr(readseq, sl.readlen - SEEDLEN, SEEDLEN);
+    else if (cutype == "-p") cut = perl_substr(revcomp(readseq), 0, SEEDLEN);
+    else                     cut = perl_substr(revcomp(readseq), sl.readlen - SEEDLEN, SEEDLEN);
+    if (sl.verbose) cerr << rname << "\t" << cutype << "\t" << cut << endl;
+  }
+
+  unsigned int r;
+  map <string, unsigned int>::iterator idit = sl.regionid.find(seed.id);
+  if (idit == sl.regionid.end()) {
+    r = sl.regions->size();
+    sl.regionid[seed.id] = r;
+    sl.regions->push_back(valiregion());
+  }
+  else r = idit->second;
+
+  sl.ss->owners.push_back(make_pair(seed_add(*sl.ss, cut), r));           // strand + of seedseq
+  sl.ss->owners.push_back(make_pair(seed_add(*sl.ss, revcomp(cut)), r));  // strand - of seedseq
+
+  struct valiregion &reg = (*sl.regions)[r];
+  reg.id  = seed.id;
+  reg.sb  = seed.sb;
+  reg.sm  = seed.score;
+  reg.dd1 = seed.head;
+  reg.dd2 = seed.tail;
+  reg.su  = 0;
+}
+
+inline bool seed_pack(const char *seq, unsigned int len, uint64_t &key) {
+  // 2 bits per base, false unless 25 of ACGT
+  if (len != SEEDLEN) return false;
+  key = 0;
+  for (unsigned int i = 0; i < len; i++) {
+    int c = base2bit[(unsigned char)seq[i]];
+    if (c < 0) return false;
+    key = (key << 2) | c;
+  }
+  return true;
+}
+
+inline unsigned int seed_add(struct seedset &ss, const string &seq) {
+
+  // the key of a seed sequence, a new one if it is not there yet
+  uint64_t packed;
+  unsigned int key = ss.hits.size();
+  if (seed_pack(seq.data(), seq.size(), packed)) {
+    unsigned int *v = pileup_find(ss.packed, packed);
+    if (v != 0) return *v;
+    pileup_insert(ss.packed, packed, key);
+  }
+  else {
+    map <string, unsigned int>::iterator it = ss.odd.find(seq);
+    if (it != ss.odd.end()) return it->second;
+    ss.odd[seq] = key;
+  }
+  ss.hits.push_back(0);
+  return key;
+}
+
+inline void seed_scan(struct seedset &ss, vector <uint64_t> &seen, const char *line, unsigned int len, int readlen) {
+
+  // the first offset (0 .. readlen - 25) of the read holding a seed, counted once per seed and offset
+  const uint64_t mask = ((uint64_t)1 << (2 * SEEDLEN)) - 1;
+  uint64_t packed = 0;
+  unsigned int run = 0;                    // bases of ACGT in a row up to j
+  for (int j = 0, i = 1 - SEEDLEN; i <= readlen - SEEDLEN; j++, i++) {
+
+    int c = ((unsigned int)j < len) ? base2bit[(unsigned char)line[j]] : -1;
+    if (c >= 0) {
+      packed = ((packed << 2) | c) & mask;
+      run++;
+    }
+    else run = 0;
+    if (i < 0) continue;
+
+    unsigned int *key = 0;
+    if (run >= SEEDLEN) key = pileup_find(ss.packed, packed);
+    else if (!ss.odd.empty()) {             // the window as substr gives it, short or empty past the end
+      string window = ((unsigned int)i <= len) ? string(line + i, min(len - i, (unsigned int)SEEDLEN)) : "";
+      map <string, unsigned int>::iterator it = ss.odd.find(window);
+      if (it != ss.odd.end()) key = &it->second;
+    }
+    if (key == 0) continue;
+
+    seen[(size_t)*key * ss.nwords + i / 64] |= (uint64_t)1 << (i % 64);
+    break;
+  }
+}
+
+inline unsigned long long umr_lines(struct seedset &ss, vector <uint64_t> *seen, const char *p, size_t len, struct umrstate &st, int readlen) {
+
+  // walks the lines as breakvali.pl reads the records: after a header (the first line decides between
+  // fasta '>' and fastq '@') the next line is the bases, in fastq two more lines are passed. The bases
+  // are scanned into seen (with their newline, as the script did not chomp them) unless seen is NULL;
+  // of type 'b' every line is the bases of a read.
+  // returns the reads
+  unsigned long long reads = 0;
+  const char *end = p + len;
+  while (p < end) {
+    const char *nl = (const char *)memchr(p, '\n', end - p);
+    const char *next = (nl != NULL) ? nl + 1 : end;
+    if (st.type == 'b') st.next = 1;
+    if (st.next == 1) {
+      if (seen != NULL) seed_scan(ss, *seen, p, next - p, readlen);
+      reads++;
+      st.next = (st.type == 'q') ? 2 : 0;
+    }
+    else if (st.next >= 2) st.next = (st.next == 2) ? 3 : 0;
+    else {
+      if (st.type == 0 && (*p == '@' || *p == '>')) st.type = (*p == '@') ? 'q' : 'a';
+      if ((st.type == 'a' && *p == '>') || (st.type == 'q' && *p == '@')) st.next = 1;
+    }
+    p = next;
+  }
+  return reads;
+}
+
+inline void umr_feed(struct umrjobs &job, vector <uint64_t> &seen, struct umrchunk *uc, struct umrstate &st, unsigned long long &count, bool verbose) {
+
+  // with one thread the chunk is scanned here, otherwise the reader only follows its records and a worker scans it
+  unsigned long long before = count;
+  uc->state = st;
+  if (job.seen.size() == 1) {
+    count += umr_lines(*job.ss, &seen, uc->data.data(), uc->data.size(), st, job.readlen);
+    delete uc;
+  }
+  else {
+    count += umr_lines(*job.ss, NULL, uc->data.data(), uc->data.size(), st, job.readlen);
+    pthread_mutex_lock(&job.lock);
+    while (job.chunks.size() >= 2 * job.seen.size()) pthread_cond_wait(&job.room, &job.lock);
+    job.chunks.push_back(uc);
+    pthread_cond_signal(&job.more);
+    pthread_mutex_unlock(&job.lock);
+  }
+  if (verbose && count / 1000000 > before / 1000000) cerr << (count / 1000000) * 1000000 << " unmapped reads processed" << endl;
+}
+
+inline void umr_bam(struct umrjobs &job, vector <uint64_t> &seen, const char *mapping_f, bool softclip, unsigned int threads, unsigned long long &count, bool verbose) {
+
+  // the bases of the unmapped reads of the BAM files (and their soft clipped ends), one read per line
+  vector <string> fnames;
+  vali_files(mapping_f, fnames);
+  cerr << "the input mapping files are:" << endl;
+  for (unsigned int i = 0; i < fnames.size(); i++) cerr << fnames[i] << endl;
+  if (fnames.empty()) return;
+
+  // the files left open by the stage before unless they are read through bamtools, which can not jump
+  bool kept = (bamkept != NULL && (softclip || bamkept->iothreads > 0));
+  struct bamin own;
+  struct bamin &in = kept ? *bamkept : own;
+  if (kept) cerr << "kept open from the stage before" << endl;
+  else bamin_open(in, fnames, threads);
+  if (softclip || !bamin_unplaced(in)) bamin_rewind(in);   // natively, the reads without a reference are jumped to
+
+  struct umrstate st = {'b', 0};
+  struct umrchunk *uc = new struct umrchunk;
+  BamAlignment bam;
+  while (bamin_next(in, bam, false)) {
+
+    if (!bam.IsPrimaryAlignment() || (bam.AlignmentFlag & 0x800) != 0) continue;  // a read once
+    if (!bam.IsMapped()) {
+      uc->data += bam.QueryBases;
+      uc->data += '\n';
+    }
+    else if (softclip && !bam.CigarData.empty()) {
+      unsigned int first = (bam.CigarData[0].Type == 'H' && bam.CigarData.size() > 1) ? 1 : 0;
+      unsigned int last  = bam.CigarData.size() - 1;
+      if (bam.CigarData[last].Type == 'H' && last > 0) last--;
+      const CigarOp &left  = bam.CigarData[first];
+      const CigarOp &right = bam.CigarData[last];
+      if (left.Type == 'S' && left.Length >= SEEDLEN && left.Length <= bam.QueryBases.size()) {
+        uc->data.append(bam.QueryBases, 0, left.Length);
+        uc->data += '\n';
+      }
+      if (last != first && right.Type == 'S' && right.Length >= SEEDLEN && right.Length <= bam.QueryBases.size()) {
+        uc->data.append(bam.QueryBases, bam.QueryBases.size() - right.Length, right.Length);
+        uc->data += '\n';
+      }
+    }
+    if (uc->data.size() >= VALI_CHUNK) {
+      umr_feed(job, seen, uc, st, count, verbose);
+      uc = new struct umrchunk;
+    }
+  }
+  umr_feed(job, seen, uc, st, count, verbose);
+  if (!kept) bamin_close(in);
+  cerr << mapping_f << " finished" << endl;
+}
+
+void *umr_worker(void *arg) {
+
+  struct umrworker *uw = (struct umrworker *)arg;
+  struct umrjobs &job = *(uw->job);
+  while (1) {
+
+    pthread_mutex_lock(&job.lock);
+    while (job.chunks.empty() && !job.eof) pthread_cond_wait(&job.more, &job.lock);
+    if (job.chunks.empty()) {
+      pthread_mutex_unlock(&job.lock);
+      break;
+    }
+    struct umrchunk *uc = job.chunks.front();
+    job.chunks.pop_front();
+    pthread_cond_signal(&job.room);
+    pthread_mutex_unlock(&job.lock);
+
+    umr_lines(*job.ss, uw->seen, uc->data.data(), uc->data.size(), uc->state, job.readlen);
+    delete uc;
+  }
+  delete uw;
+  return NULL;
+}
+
+inline bool sb_before(const struct valiregion *a, const struct valiregion *b) {
+  return perl_num(a->sb) < perl_num(b->sb);
+}
+
+inline bool sm_before(const struct valiregion *a, const struct valiregion *b) {
+  return perl_num(a->sm) < perl_num(b->sm);
+}
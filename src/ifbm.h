@@ -21,6 +21,9 @@ struct parameters {
   unsigned int unique;
   char* mistag;
   unsigned int readlen;
+  unsigned int iothreads;
+  unsigned int threads;
+  unsigned int bgzip;
 };
 
 struct parameters* interface(struct parameters* param,int argc, char *argv[]);
@@ -45,6 +48,9 @@ struct parameters* interface(struct parameters* param, int argc, char *argv[]){
   param->mapping_f = new char;
   param->qual_clip = new char;
   param->mistag    = new char;
+  param->iothreads = 0;
+  param->threads   = 0;
+  param->bgzip     = 0;
 
   const struct option long_options[] ={
     {"region",1,0, 'r'},
@@ -53,6 +59,9 @@ struct parameters* interface(struct parameters* param, int argc, char *argv[]){
     {"readlen",1,0,'l'},
     {"qualclip",1,0,'q'},
     {"mistag",1,0,'e'},
+    {"io-threads",1,0,'j'},
+    {"threads",1,0,'t'},
+    {"bgzip",0,0,'z'},
     {"help",0,0,'h'},
     {0, 0, 0, 0}
   };
@@ -61,7 +70,7 @@ struct parameters* interface(struct parameters* param, int argc, char *argv[]){
   while (1){
 
     int option_index = 0;
-    c = getopt_long_only (argc, argv,"hur:m:l:q:e:",long_options, &option_index);
+    c = getopt_long_only (argc, argv,"huzr:m:l:q:e:j:t:",long_options, &option_index);
 
     if (c == -1){
       break;
@@ -88,6 +97,15 @@ struct parameters* interface(struct parameters* param, int argc, char *argv[]){
     case 'q':
       param->qual_clip = optarg;
       break;
+    case 'j':
+      param->iothreads = atoi(optarg);
+      break;
+    case 't':
+      param->threads = atoi(optarg);
+      break;
+    case 'z':
+      param->bgzip = 1;
+      break;
     case 'h':
       help = 1;
       break;
@@ -114,12 +132,15 @@ void usage()
   fprintf(stdout, "\nbreakmis (mismatch screening) BreakPointer v0.1, 2011 Sun Ruping <ruping@molgen.mpg.de>\n");
   fprintf(stdout, "\n");
   fprintf(stdout, "Usage: %s options <argument needed> >output(gff format) \n\n", program_name);
-  fprintf(stdout, "-r --region     <string> A region file generated by breakpointer.\n");
+  fprintf(stdout, "-r --region     <string> A region file generated by breakpointer, text or binary (breakpointer --binout, mapped and read in place),\n                         - to read the text regions from stdin as breakpointer writes them.\n");
   fprintf(stdout, "-m --mapping    <string> A BAM alignment file or a file containing the filenames of multiple BAM files (one file per line). MUST be according to the chromosome and start position.\n                         In case of multiple BAM files, make sure these BAM files are sorted samely (require header tag: \"@HD\tVN:1.0\tSO:coordinate\").\n");
   fprintf(stdout, "-l --readlen    <int>    Length of the read (currently only support fixed length).\n");
   fprintf(stdout, "-q --qualclip   <string> Quality type for clipping (phred33,solexa64,phred64,no), default is Phred33, if \"no\", clipping is turned off.\n");
   fprintf(stdout, "-u --unique              take only uniquelly mapped reads (default: take all mapped reads). \n                         since different mappers generate different tags for uniqueness, if -q is set, user shoule provide unique tag info (see tag/val_uniq). \n                         we recommand not to set this option if the mapping file only contain a few multiple location reads, in case users are not sure about the unique tags.\n");
   fprintf(stdout, "-e --mistag     <string> The tag in the bam file denotating the mismatch string.\n");
+  fprintf(stdout, "-j --io-threads <int>    inflate the BGZF blocks of each BAM file on this many threads and decode the records natively (default: 0, read through bamtools).\n");
+  fprintf(stdout, "-t --threads    <int>    screen batches of regions in parallel with this many threads, output stays in region file order (default: 1).\n");
+  fprintf(stdout, "-z --bgzip               compress the gff with bgzip (breakvali -e - takes it through bgzip -dc).\n");
   fprintf(stdout, "-h --help                Print the help message\n");
   fprintf(stdout, "\n");
 }
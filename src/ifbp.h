@@ -20,6 +20,17 @@ struct parameters {
   unsigned int readlen;
   unsigned int unique;
   unsigned int indiprint;
+  char* engine;
+  unsigned int threads;
+  char* decode;
+  char* lengthbins;
+  char* misout;
+  char* binout;
+  char* qual_clip;
+  char* mistag;
+  unsigned int iothreads;
+  unsigned int bgzip;
+  char* wintrace;
   //char* tag_uniq;
   //unsigned int val_uniq;
 };
@@ -43,6 +54,25 @@ struct parameters* interface(struct parameters* param, int argc, char *argv[]){
 
   param = new struct parameters;
   param->mapping_f = new char;
+  param->engine    = new char;
+  param->engine[0] = '\0';
+  param->threads   = 0;
+  param->decode    = new char;
+  param->decode[0] = '\0';
+  param->lengthbins    = new char;
+  param->lengthbins[0] = '\0';
+  param->misout    = new char;
+  param->misout[0] = '\0';
+  param->binout    = new char;
+  param->binout[0] = '\0';
+  param->qual_clip    = new char;
+  param->qual_clip[0] = '\0';
+  param->mistag    = new char;
+  param->mistag[0] = '\0';
+  param->iothreads = 0;
+  param->bgzip     = 0;
+  param->wintrace    = new char;
+  param->wintrace[0] = '\0';
   //param->tag_uniq = new char;
   //param->val_uniq = new char;
 
@@ -52,6 +82,17 @@ struct parameters* interface(struct parameters* param, int argc, char *argv[]){
     {"mapping",1,0,'m'},
     {"windowsize",1,0,'w'},
     {"indiprint",0,0,'i'},
+    {"engine",1,0,'e'},
+    {"threads",1,0,'t'},
+    {"decode",1,0,'d'},
+    {"length-bins",1,0,'b'},
+    {"misout",1,0,'o'},
+    {"binout",1,0,'B'},
+    {"qualclip",1,0,'q'},
+    {"mistag",1,0,'g'},
+    {"io-threads",1,0,'j'},
+    {"bgzip",0,0,'z'},
+    {"window-trace",1,0,'T'},
     //{"tag_uniq",1,0,'t'},
     //{"val_uniq",1,0,'v'},
     {"help",0,0,'h'},
@@ -61,7 +102,7 @@ struct parameters* interface(struct parameters* param, int argc, char *argv[]){
   while (1) {
 
     int option_index = 0;
-    c = getopt_long_only (argc, argv,"hium:w:l:",long_options, &option_index);
+    c = getopt_long_only (argc, argv,"hiuzm:w:l:e:t:d:b:o:B:q:g:j:T:",long_options, &option_index);
 
     if (c == -1){
       break;
@@ -91,6 +132,39 @@ struct parameters* interface(struct parameters* param, int argc, char *argv[]){
     case 'i':
       param->indiprint = 1;
       break;
+    case 'e':
+      param->engine = optarg;
+      break;
+    case 't':
+      param->threads = atoi(optarg);
+      break;
+    case 'd':
+      param->decode = optarg;
+      break;
+    case 'b':
+      param->lengthbins = optarg;
+      break;
+    case 'o':
+      param->misout = optarg;
+      break;
+    case 'B':
+      param->binout = optarg;
+      break;
+    case 'q':
+      param->qual_clip = optarg;
+      break;
+    case 'g':
+      param->mistag = optarg;
+      break;
+    case 'j':
+      param->iothreads = atoi(optarg);
+      break;
+    case 'z':
+      param->bgzip = 1;
+      break;
+    case 'T':
+      param->wintrace = optarg;
+      break;
     case 'h':
       help = 1;
       break;
@@ -121,6 +195,17 @@ void usage()
   fprintf(stdout, "-w --windowsize  <int>    the size in bp of the sliding window (default: 10 for reads < 50bp, 20 for longer and variable read length).\n");
   fprintf(stdout, "-l --readlen     <int>    the size in bp of the read length (default: allowing variable read length).\n");
   fprintf(stdout, "-u --unique               take only uniquelly mapped reads (default: take all mapped reads).\n                          since different mappers generate different tags for uniqueness, if -q is set, user shoule provide unique tag info (see tag/val_uniq). \n                          we recommand not to set this option if the mapping file only contain a few multiple location reads, in case users are not sure about the unique tags\n");
+  fprintf(stdout, "-e --engine     <string> the window depth engine, \"legacy\" (default) or \"prefix\" (prefix sums over per-position read start/end counters, the same regions).\n");
+  fprintf(stdout, "-t --threads    <int>    scan the reference sequences in parallel with this many threads, output stays in header order (default: 1).\n");
+  fprintf(stdout, "-d --decode     <string> BAM decoding, \"core\" (default: position, flag, CIGAR and length only, tags decoded just for --unique) or \"full\".\n");
+  fprintf(stdout, "-b --length-bins <string> read length classes when -l is not set, \"auto\" (default: one per read length, as the scan meets them)\n                          or comma separated upper read lengths, e.g. 36,50,76,100 (a class takes the binomial prob of its upper length).\n");
+  fprintf(stdout, "-o --misout   <string> also run the mismatch screening of breakmis in the same pass and write its gff to this file.\n");
+  fprintf(stdout, "-q --qualclip <string> with --misout: read quality type for clipping, \"no\", \"phred33\" (default), \"phred64\" or \"solexa64\".\n");
+  fprintf(stdout, "-g --mistag   <string> with --misout: the bam tag for the mismatch string (default: MD).\n");
+  fprintf(stdout, "-B --binout   <string> write the regions to this file in binary form (fixed width records, read by breakmis directly,\n                          breakregions prints them as text) instead of to stdout.\n");
+  fprintf(stdout, "-T --window-trace <string> write the windows --indiprint prints to this file in binary (columns of varints and the scores,\n                          written by a thread of its own), breaktrace reads them back.\n");
+  fprintf(stdout, "-j --io-threads <int>    inflate the BGZF blocks of each BAM file on this many threads and decode the records natively (default: 0, read through bamtools).\n");
+  fprintf(stdout, "-z --bgzip                compress the regions on stdout and the --misout gff with bgzip (breakmis -r - takes them through bgzip -dc).\n");
   //fprintf(stdout, "-t --tag_uniq    <string> the tag in the bam file denotating whether a read is uniquely mapped (default \"XT\" is taken as from BWA).\n");
   //fprintf(stdout, "-v --val_uniq    <int>    the value for the above tag of uniquely mapped reads (default value is taken as from the output from BWA).\n");
   fprintf(stdout, "-h --help                 print the help message.\n");
@@ -130,6 +215,14 @@ void usage()
 void delete_param(struct parameters* param)
 {
   delete(param->mapping_f);
+  delete(param->engine);
+  delete(param->decode);
+  delete(param->lengthbins);
+  delete(param->misout);
+  delete(param->binout);
+  delete(param->wintrace);
+  delete(param->qual_clip);
+  delete(param->mistag);
   //delete(param->tag_uniq);
   delete(param);
 }
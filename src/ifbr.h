@@ -0,0 +1,114 @@
+/*
+
+ Copyright (C) 2011 Sun Ruping <rs3412@columbia.edu>
+
+ This file is part of Breakpointer.
+
+ Breakpointer is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License.
+
+*/
+
+#include <cstdio>
+#include <getopt.h>
+#include <cstdlib>
+#include <cstring>
+
+struct parameters {
+  char* region_f;
+  unsigned int exact;
+  unsigned int header;
+};
+
+struct parameters* interface(struct parameters* param,int argc, char *argv[]);
+void delete_param(struct parameters* param);
+void usage(void);
+
+const char* program_name;
+
+struct parameters* interface(struct parameters* param, int argc, char *argv[]){
+
+  program_name = argv[0];
+  int c;     // the next argument
+  int help = 0;
+
+  if (argc < 2){
+    usage();
+    exit(0);
+  }
+
+  param = new struct parameters;
+  param->region_f = 0;
+  param->exact    = 0;
+  param->header   = 0;
+
+  const struct option long_options[] ={
+    {"region",1,0,'r'},
+    {"exact",0,0,'x'},
+    {"header",0,0,'H'},
+    {"help",0,0,'h'},
+    {0, 0, 0, 0}
+  };
+
+
+  while (1){
+
+    int option_index = 0;
+    c = getopt_long_only (argc, argv,"hxHr:",long_options, &option_index);
+
+    if (c == -1){
+      break;
+    }
+
+    switch(c) {
+    case 0:
+      break;
+    case 'r':
+      param->region_f = optarg;
+      break;
+    case 'x':
+      param->exact = 1;
+      break;
+    case 'H':
+      param->header = 1;
+      break;
+    case 'h':
+      help = 1;
+      break;
+    case '?':
+      help = 1;
+      break;
+    default:
+      help = 1;
+      break;
+    }
+  }
+
+  if(help || param->region_f == 0){
+    usage();
+    delete_param(param);
+    exit(0);
+  }
+
+  return param;
+}
+
+void usage()
+{
+  fprintf(stdout, "\nbreakregions (the binary region file as text) BreakPointer v0.1, 2011 Sun Ruping <rs3412@columbia.edu>\n");
+  fprintf(stdout, "\n");
+  fprintf(stdout, "Usage: %s options <argument needed> >output(region file)\n\n", program_name);
+  fprintf(stdout, "-r --region     <string> the binary region file written by breakpointer --binout.\n");
+  fprintf(stdout, "-x --exact               print the depth, ratios and score as they are stored instead of rounded to three decimals.\n");
+  fprintf(stdout, "-H --header              print the run parameters and the reference dictionary first, as lines starting with #.\n");
+  fprintf(stdout, "-h --help                Print the help message\n");
+  fprintf(stdout, "\n");
+  fprintf(stdout, "without -x and -H the output is the text region file breakpointer prints to stdout.\n");
+  fprintf(stdout, "\n");
+}
+
+
+void delete_param(struct parameters* param)
+{
+  delete(param);
+}
@@ -0,0 +1,121 @@
+/*
+
+ Copyright (C) 2011 Sun Ruping <rs3412@columbia.edu>
+
+ This file is part of Breakpointer.
+
+ Breakpointer is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License.
+
+*/
+
+#include <cstdio>
+#include <getopt.h>
+#include <cstdlib>
+#include <cstring>
+
+struct parameters {
+  char* trace_f;
+  char* region;
+  double score;
+  unsigned int header;
+};
+
+struct parameters* interface(struct parameters* param,int argc, char *argv[]);
+void delete_param(struct parameters* param);
+void usage(void);
+
+const char* program_name;
+
+struct parameters* interface(struct parameters* param, int argc, char *argv[]){
+
+  program_name = argv[0];
+  int c;     // the next argument
+  int help = 0;
+
+  if (argc < 2){
+    usage();
+    exit(0);
+  }
+
+  param = new struct parameters;
+  param->trace_f = 0;
+  param->region  = 0;
+  param->score   = 0.;
+  param->header  = 0;
+
+  const struct option long_options[] ={
+    {"trace",1,0,'w'},
+    {"region",1,0,'r'},
+    {"score",1,0,'s'},
+    {"header",0,0,'H'},
+    {"help",0,0,'h'},
+    {0, 0, 0, 0}
+  };
+
+
+  while (1){
+
+    int option_index = 0;
+    c = getopt_long_only (argc, argv,"hHw:r:s:",long_options, &option_index);
+
+    if (c == -1){
+      break;
+    }
+
+    switch(c) {
+    case 0:
+      break;
+    case 'w':
+      param->trace_f = optarg;
+      break;
+    case 'r':
+      param->region = optarg;
+      break;
+    case 's':
+      param->score = atof(optarg);
+      break;
+    case 'H':
+      param->header = 1;
+      break;
+    case 'h':
+      help = 1;
+      break;
+    case '?':
+      help = 1;
+      break;
+    default:
+      help = 1;
+      break;
+    }
+  }
+
+  if(help || param->trace_f == 0){
+    usage();
+    delete_param(param);
+    exit(0);
+  }
+
+  return param;
+}
+
+void usage()
+{
+  fprintf(stdout, "\nbreaktrace (the window trace as text) BreakPointer v0.1, 2011 Sun Ruping <rs3412@columbia.edu>\n");
+  fprintf(stdout, "\n");
+  fprintf(stdout, "Usage: %s options <argument needed> >output\n\n", program_name);
+  fprintf(stdout, "-w --trace      <string> the window trace written by breakpointer --window-trace.\n");
+  fprintf(stdout, "-r --region     <string> only the windows overlapping this region, chr or chr:start-end (1-based, inclusive).\n");
+  fprintf(stdout, "-s --score      <float>  only the windows scoring at least this much (every window in the trace scores > 1).\n");
+  fprintf(stdout, "-H --header              print the run parameters and the reference dictionary first, as lines starting with #.\n");
+  fprintf(stdout, "-h --help                Print the help message\n");
+  fprintf(stdout, "\n");
+  fprintf(stdout, "the windows are printed as breakpointer --indiprint prints them: chr, start, end, depth, starts, ends, the two ratios and the score.\n");
+  fprintf(stdout, "\n");
+}
+
+
+void delete_param(struct parameters* param)
+{
+  delete(param);
+}
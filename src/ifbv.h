@@ -0,0 +1,147 @@
+/*
+
+ Copyright (C) 2011 Sun Ruping <ruping@molgen.mpg.de>
+
+ This file is part of Breakpointer.
+
+ Delve is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License.
+
+*/
+
+#include <cstdio>
+#include <getopt.h>
+#include <cstdlib>
+#include <cstring>
+
+struct parameters {
+  char* umr_f;
+  char* ermis_f;
+  char* reads_f;
+  char* mapping_f;
+  int readlen;
+  unsigned int verbose;
+  unsigned int threads;
+  unsigned int softclip;
+};
+
+struct parameters* interface(struct parameters* param,int argc, char *argv[]);
+void delete_param(struct parameters* param);
+void usage(void);
+
+const char* program_name;
+
+struct parameters* interface(struct parameters* param, int argc, char *argv[]){
+
+  program_name = argv[0];
+  int c;     // the next argument
+  int help = 0;
+
+  if (argc < 2){
+    usage();
+    exit(0);
+  }
+
+  param = new struct parameters;
+  param->umr_f   = 0;
+  param->ermis_f = 0;
+  param->reads_f = 0;
+  param->mapping_f = 0;
+  param->readlen = 0;
+  param->verbose = 0;
+  param->threads = 0;
+  param->softclip = 0;
+
+  const struct option long_options[] ={
+    {"umr",1,0, 'u'},
+    {"ermis",1,0,'e'},
+    {"readlen",1,0,'l'},
+    {"reads",1,0,'r'},
+    {"mapping",1,0,'m'},
+    {"softclip",0,0,'s'},
+    {"verbose",0,0,'v'},
+    {"threads",1,0,'t'},
+    {"help",0,0,'h'},
+    {0, 0, 0, 0}
+  };
+
+
+  while (1){
+
+    int option_index = 0;
+    c = getopt_long_only (argc, argv,"hvsu:e:l:r:m:t:",long_options, &option_index);
+
+    if (c == -1){
+      break;
+    }
+
+    switch(c) {
+    case 0:
+      break;
+    case 'u':
+      param->umr_f = optarg;
+      break;
+    case 'e':
+      param->ermis_f = optarg;
+      break;
+    case 'l':
+      param->readlen = atoi(optarg);
+      break;
+    case 'r':
+      param->reads_f = optarg;
+      break;
+    case 'm':
+      param->mapping_f = optarg;
+      break;
+    case 's':
+      param->softclip = 1;
+      break;
+    case 'v':
+      param->verbose = 1;
+      break;
+    case 't':
+      param->threads = atoi(optarg);
+      break;
+    case 'h':
+      help = 1;
+      break;
+    case '?':
+      help = 1;
+      break;
+    default:
+      help = 1;
+      break;
+    }
+  }
+
+  if(help){
+    usage();
+    delete_param(param);
+    exit(0);
+  }
+
+  return param;
+}
+
+void usage()
+{
+  fprintf(stdout, "\nbreakvali (validation with unmapped reads) BreakPointer v0.1, 2011 Sun Ruping <ruping@molgen.mpg.de>\n");
+  fprintf(stdout, "\n");
+  fprintf(stdout, "Usage: %s options <argument needed> >output(gff format) \n\n", program_name);
+  fprintf(stdout, "-u --umr        <string> the unmapped reads file or a file listing the names of the umr-files (fasta|fastq, plain, gzip or bgzip).\n");
+  fprintf(stdout, "-l --readlen    <int>    the length of the read.\n");
+  fprintf(stdout, "-r --reads      <string> the reads file or file of filenames (only for gff, don't set for bam alignment).\n");
+  fprintf(stdout, "-e --ermis      <string> the mismatch file generated by breakpointer-breakmis, - to read it from stdin.\n");
+  fprintf(stdout, "-m --mapping    <string> take the unmapped reads from the end of these BAM files as well (one file, a file listing the files or the files separated by spaces),\n                         jumped to by the .bai index (or found by a scan of each file without one).\n");
+  fprintf(stdout, "-s --softclip            with --mapping, also take the soft clipped ends (>= 25bp) of the mapped reads and the unmapped reads placed by their mates;\n                         this reads the whole BAM files.\n");
+  fprintf(stdout, "-t --threads    <int>    scan the unmapped reads on this many threads, bgzip files are also inflated on them (default: 1).\n");
+  fprintf(stdout, "-v --verbose             print the progress.\n");
+  fprintf(stdout, "-h --help                Print the help message\n");
+  fprintf(stdout, "\n");
+}
+
+
+void delete_param(struct parameters* param)
+{
+  delete(param);
+}
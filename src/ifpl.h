@@ -0,0 +1,196 @@
+/*
+
+ Copyright (C) 2011 Sun Ruping <rs3412@columbia.edu>
+
+ This file is part of Breakpointer.
+
+ Breakpointer is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License.
+
+*/
+
+#include <cstdio>
+#include <getopt.h>
+#include <cstdlib>
+#include <cstring>
+
+struct parameters {
+  char* runlevel;
+  char* mapping_f;
+  char* outdir;
+  char* basename;
+  char* unmap_f;
+  char* mistag;
+  unsigned int windowsize;
+  unsigned int readlen;
+  unsigned int unique;
+  unsigned int qualclip;
+  unsigned int umrbam;
+  unsigned int softclip;
+  unsigned int iothreads;
+  unsigned int noexecute;
+};
+
+struct parameters* interface(struct parameters* param,int argc, char *argv[]);
+void delete_param(struct parameters* param);
+void usage(void);
+
+const char* program_name;
+
+struct parameters* interface(struct parameters* param, int argc, char *argv[]){
+
+  program_name = argv[0];
+  int c;     // the next argument
+  int help = 0;
+
+  if (argc < 2){
+    usage();
+    exit(0);
+  }
+
+  param = new struct parameters;
+  param->runlevel   = 0;
+  param->mapping_f  = 0;
+  param->outdir     = 0;
+  param->basename   = 0;
+  param->unmap_f    = 0;
+  param->mistag     = 0;
+  param->windowsize = 0;
+  param->readlen    = 0;
+  param->unique     = 0;
+  param->qualclip   = 0;
+  param->umrbam     = 0;
+  param->softclip   = 0;
+  param->iothreads  = 0;
+  param->noexecute  = 0;
+
+  const struct option long_options[] ={
+    {"runlevel",1,0,'r'},
+    {"noexecute",0,0,'n'},
+    {"windowsize",1,0,'w'},
+    {"mapping",1,0,'m'},
+    {"readlen",1,0,'l'},
+    {"outdir",1,0,'o'},
+    {"unique",1,0,'u'},
+    {"mistag",1,0,'g'},
+    {"qualclip",0,0,'q'},
+    {"unmap",1,0,'x'},
+    {"umrbam",0,0,'b'},
+    {"softclip",0,0,'s'},
+    {"basename",1,0,'a'},
+    {"iothreads",1,0,'j'},
+    {"help",0,0,'h'},
+    {0, 0, 0, 0}
+  };
+
+
+  while (1){
+
+    int option_index = 0;
+    c = getopt_long_only (argc, argv,"hnqbsr:w:m:l:o:u:g:x:a:j:",long_options, &option_index);
+
+    if (c == -1){
+      break;
+    }
+
+    switch(c) {
+    case 0:
+      break;
+    case 'r':
+      param->runlevel = optarg;
+      break;
+    case 'n':
+      param->noexecute = 1;
+      break;
+    case 'w':
+      param->windowsize = atoi(optarg);
+      break;
+    case 'm':
+      param->mapping_f = optarg;
+      break;
+    case 'l':
+      param->readlen = atoi(optarg);
+      break;
+    case 'o':
+      param->outdir = optarg;
+      break;
+    case 'u':
+      param->unique = atoi(optarg);
+      break;
+    case 'g':
+      param->mistag = optarg;
+      break;
+    case 'q':
+      param->qualclip = 1;
+      break;
+    case 'x':
+      param->unmap_f = optarg;
+      break;
+    case 'b':
+      param->umrbam = 1;
+      break;
+    case 's':
+      param->softclip = 1;
+      break;
+    case 'a':
+      param->basename = optarg;
+      break;
+    case 'j':
+      param->iothreads = atoi(optarg);
+      break;
+    case 'h':
+      help = 1;
+      break;
+    case '?':
+      help = 1;
+      break;
+    default:
+      help = 1;
+      break;
+    }
+  }
+
+  if(help){
+    usage();
+    delete_param(param);
+    exit(0);
+  }
+
+  return param;
+}
+
+void usage()
+{
+  fprintf(stdout, "\nbreakpointer-pipeline (the runlevels of breakpointer_run.pl in one process) BreakPointer v0.1, 2011 Sun Ruping <rs3412@columbia.edu>\n");
+  fprintf(stdout, "\n");
+  fprintf(stdout, "Usage: %s options <argument needed>\n\n", program_name);
+  fprintf(stdout, "--mapping    <string> the mapping file in BAM format. It could be an individual BAM file or a file listing the filenames of multiple BAM files (line seperated).\n");
+  fprintf(stdout, "                      All the BAM files must be sorted SAMELY according to chromosomes and coordinates.\n");
+  fprintf(stdout, "--runlevel   <string> the runlevels to run, \"1\", \"2,3\" or \"1-3\" (default: 1-3).\n");
+  fprintf(stdout, "                      runlevel 1: scan the read alignment, searching for depth skewed regions;\n");
+  fprintf(stdout, "                      runlevel 2: mismatch screeing for each depth skewed region, in the same pass over the BAM files when runlevel 1 runs too;\n");
+  fprintf(stdout, "                      runlevel 3: validate each candidate region by looking for support from unmappable reads.\n");
+  fprintf(stdout, "--outdir     <string> the output directory (default: current directory).\n");
+  fprintf(stdout, "--basename   <string> the basename of the output files (default: take the basename of the mapping files).\n");
+  fprintf(stdout, "--windowsize <int>    the window size, default is 10 for < 50bp reads, 20 for longer reads/variable length reads.\n");
+  fprintf(stdout, "--readlen    <int>    the length of the read (default: using variable read length).\n");
+  fprintf(stdout, "--unique     <0/1>    0: take all the alignments (default), 1: take only unique alinged reads.\n");
+  fprintf(stdout, "--mistag     <string> the bam tag for mismatch string (default: MD).\n");
+  fprintf(stdout, "--qualclip            whether to do the quality clipping for mismatch screening, default no.\n");
+  fprintf(stdout, "--unmap      <string> File containing unmapped reads, either one file or a file listing the names of multiple files (fasta/fastq, plain, gzip or bgzip).\n");
+  fprintf(stdout, "--umrbam              take the unmapped reads of runlevel 3 from the end of the mapping files, instead of or as well as --unmap.\n");
+  fprintf(stdout, "--softclip            with --umrbam, also take the soft clipped ends of the mapped reads (the whole mapping files are read).\n");
+  fprintf(stdout, "--iothreads  <int>    inflate the BAM blocks on this many threads per file and scan the unmapped reads on this many threads (default: 0, read through bamtools).\n");
+  fprintf(stdout, "--noexecute           print the stages without running them, for testing purpose only.\n");
+  fprintf(stdout, "--help                print this help message.\n");
+  fprintf(stdout, "\n");
+  fprintf(stdout, "the outputs are <basename>.endskew, <basename>.endskew.mis.gff and <basename>.endskew.mis.vali.gff in the output directory as with\n");
+  fprintf(stdout, "breakpointer_run.pl, an output that exists already is not made again. <basename>.timing.json holds the time taken by each runlevel.\n");
+  fprintf(stdout, "\n");
+}
+
+
+void delete_param(struct parameters* param)
+{
+  delete(param);
+}
@@ -1,3 +1,6 @@
+#ifndef BREAKPOINTER_MATHSTATS_H
+#define BREAKPOINTER_MATHSTATS_H
+
 #include <cmath>
 #include <cfloat>
 #include <algorithm>
@@ -1836,3 +1839,5 @@ static double erf__(double x)
   return ret_val;
 
 } /* erf */
+
+#endif
@@ -0,0 +1,146 @@
+/*
+
+ Copyright (C) 2011 Sun Ruping <rs3412@columbia.edu>
+
+ This file is part of Breakpointer.
+
+ Breakpointer is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License.
+
+ mdtag.h: the mismatch string of a read, decoded in one pass over the raw
+ tag bytes. md_find locates a Z tag in the tag block of a record and
+ md_parse walks the MD string along the CIGAR. Each mismatch and each
+ deletion run (^ and its bases) comes out with its offset in the read,
+ soft clips and insertions included, and on the reference, skipped
+ regions (N) included. The hits go to a buffer owned by the caller and
+ reused from read to read, so nothing is allocated per read.
+
+*/
+
+#ifndef BREAKPOINTER_MDTAG_H
+#define BREAKPOINTER_MDTAG_H
+
+#include <string>
+#include <vector>
+#include <cstring>
+#include <stdint.h>
+
+struct mdhit {
+  unsigned int qpos;   //1-based offset in the read of the mismatch, or of the base after a deletion
+  unsigned int rpos;   //0-based offset on the reference from the alignment start
+  unsigned int del;    //0 for a mismatch, else the length of the deletion run
+};
+
+inline const char *md_find(const std::string &tagdata, const char *tag);
+template <typename cigop> inline void md_skip(const std::vector <cigop> &cigar, unsigned int &ci, unsigned int &left, unsigned int &q, unsigned int &r, bool del);
+template <typename cigop> inline void md_align(const std::vector <cigop> &cigar, unsigned int &ci, unsigned int &left, unsigned int &q, unsigned int &r, unsigned int n);
+template <typename cigop> inline void md_parse(const char *md, const std::vector <cigop> &cigar, std::vector <struct mdhit> &hits);
+
+
+inline const char *md_find(const std::string &tagdata, const char *tag) {
+
+  // the value of a Z tag, NULL if there is none
+  if (strlen(tag) != 2) return NULL;
+  const char *p   = tagdata.data();
+  const char *end = p + tagdata.size();
+  while (p + 3 < end) {
+    char type = p[2];
+    const char *v = p + 3;
+    if (p[0] == tag[0] && p[1] == tag[1]) return (type == 'Z') ? v : NULL;
+    switch (type) {
+    case 'A': case 'c': case 'C': p = v + 1; break;
+    case 's': case 'S':           p = v + 2; break;
+    case 'i': case 'I': case 'f': p = v + 4; break;
+    case 'Z': case 'H':
+      p = (const char *)memchr(v, '\0', end - v);
+      if (p == NULL) return NULL;
+      p++;
+      break;
+    case 'B': {
+      if (v + 5 > end) return NULL;
+      int32_t n;
+      memcpy(&n, v + 1, 4);
+      unsigned int size = (v[0] == 'c' || v[0] == 'C') ? 1 : (v[0] == 's' || v[0] == 'S') ? 2 : 4;
+      p = v + 5 + (int64_t)n * size;
+      break;
+    }
+    default:
+      return NULL;          // broken tag block
+    }
+  }
+  return NULL;
+}
+
+template <typename cigop>
+inline void md_skip(const std::vector <cigop> &cigar, unsigned int &ci, unsigned int &left, unsigned int &q, unsigned int &r, bool del) {
+
+  // pass the CIGAR ops in front of the next aligned base, or of the next deletion if del
+  while (ci < cigar.size()) {
+    if (left == 0) {
+      if (++ci < cigar.size()) left = cigar[ci].Length;
+      continue;
+    }
+    char type = cigar[ci].Type;
+    if (type == 'M' || type == '=' || type == 'X') break;
+    if (type == 'D' && del) break;
+    if (type == 'I' || type == 'S') q += left;
+    else if (type == 'N') r += left;
+    left = 0;               // H, P and a D the MD string does not have
+  }
+}
+
+template <typename cigop>
+inline void md_align(const std::vector <cigop> &cigar, unsigned int &ci, unsigned int &left, unsigned int &q, unsigned int &r, unsigned int n) {
+
+  // pass n aligned bases
+  while (n > 0) {
+    md_skip(cigar, ci, left, q, r, false);
+    if (ci >= cigar.size()) {   // the CIGAR is short of the MD string
+      q += n;
+      r += n;
+      return;
+    }
+    unsigned int k = (n < left) ? n : left;
+    q += k;
+    r += k;
+    n -= k;
+    left -= k;
+  }
+}
+
+template <typename cigop>
+inline void md_parse(const char *md, const std::vector <cigop> &cigar, std::vector <struct mdhit> &hits) {
+
+  hits.clear();
+  unsigned int q = 0;                // read bases passed
+  unsigned int r = 0;                // reference bases passed
+  unsigned int ci = 0;               // current CIGAR op
+  unsigned int left = cigar.empty() ? 0 : cigar[0].Length;  // and its bases left
+
+  const char *p = md;
+  while (*p != '\0') {
+    if (*p >= '0' && *p <= '9') {    // a run of matches
+      unsigned int n = 0;
+      for (; *p >= '0' && *p <= '9'; p++) n = n * 10 + (*p - '0');
+      md_align(cigar, ci, left, q, r, n);
+    }
+    else if (*p == '^') {            // a deletion run
+      unsigned int d = 0;
+      for (p++; *p != '\0' && (*p < '0' || *p > '9'); p++) d++;
+      md_skip(cigar, ci, left, q, r, true);
+      struct mdhit hit = {q + 1, r, d};
+      hits.push_back(hit);
+      r += d;
+      if (ci < cigar.size() && cigar[ci].Type == 'D') left -= (d < left) ? d : left;
+    }
+    else {                           // a mismatched base
+      md_skip(cigar, ci, left, q, r, false);
+      struct mdhit hit = {q + 1, r, 0};
+      hits.push_back(hit);
+      md_align(cigar, ci, left, q, r, 1);
+      p++;
+    }
+  }
+}
+
+#endif
@@ -0,0 +1,570 @@
+/*
+
+ Copyright (C) 2011 Sun Ruping <rs3412@columbia.edu>
+
+ This file is part of Breakpointer.
+
+ Breakpointer is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License.
+
+ mismatch.h: the mismatch screening of a depth skewed region, shared by
+ breakmis and the fused mode of breakpointer. A read is summarized once
+ (clipping and the mismatches from the MD tag, mis_read, see mdtag.h),
+ filtered for piling up (mis_piled) and then counted into each region it
+ overlaps (mis_count). print_mismatch writes the gff line of a finished region
+ and, for breakpointer-pipeline, the fields breakvali takes its seed from
+ (struct misseed), so the next stage gets them without reading the gff.
+
+ The per position counts of a region are dense arrays over its span,
+ allocated by the first read counted into it. The read end coverage is a
+ difference array (two updates per read end segment), summed up once in
+ print_mismatch. A read ending inside a region with mismatches in it is
+ kept for the seed as a small record: coordinates, strand, its mismatch
+ positions in a pool of the region (SVme) and only the 25bp read ends the
+ seed is cut from.
+
+*/
+
+#ifndef BREAKPOINTER_MISMATCH_H
+#define BREAKPOINTER_MISMATCH_H
+
+#include <api/BamAlignment.h>
+#include <iostream>
+#include <iomanip>
+#include <cstdlib>
+#include <vector>
+#include <deque>
+#include <algorithm>
+#include <map>
+#include <set>
+#include <string>
+#include "pileup.h"
+#include "strutil.h"
+#include "mdtag.h"
+#include "qualclip.h"
+#include "outbuf.h"
+
+double pbinom(double x, double n, double p, int lower_tail);  // mathstats.h
+
+//a read ending inside a region with mismatches in it, a candidate for the seed
+struct SVread {
+  unsigned int start;
+  unsigned int end;
+  bool reverse;
+  bool noseq;                  //the read has no bases ("NA"), seq holds its name
+  unsigned int me;             //its mismatches in the region: SVme[me .. me + nme), ascending
+  unsigned int nme;
+  std::string seq;             //the 25bp ends of the read, all of it up to 50bp
+};
+
+struct region {
+  std::string chr;
+  unsigned int start;
+  unsigned int end;
+  unsigned int dis;
+  float depth;
+  float ratio1;
+  float ratio2;
+  float score;
+  unsigned int coverage;
+  unsigned int mismatch;
+  std::vector <unsigned int> mispos;    //mismatches at start + i
+  std::vector <bool> forbid;            //start + i is not a real mis pos
+  std::vector <unsigned int> posendcov; //read end coverage at start + i, a difference array until resolved
+  std::vector <struct SVread> SVreads;
+  std::vector <unsigned int> SVme;      //mismatch positions of the SVreads
+};
+
+//a gff line of print_mismatch as breakvali takes it
+struct misseed {
+  std::string head;            //columns 1-5
+  std::string score;           //column 6, the mismatch score
+  std::string tail;            //columns 7-9
+  std::string id;              //ID, BinomialScore and seedseq of the tag
+  std::string sb;
+  std::string seedseq;
+};
+
+//settings of the screening
+struct misconf {
+  unsigned int readlen;    //preset read length, 0 for variable
+  unsigned int endlen;     //the read ends where mismatches count
+  std::string qual_clip;   //no, phred33, phred64 or solexa64
+  int qualmin;             //lowest good quality character of qual_clip, see qualclip.h
+  std::string mistag;      //tag of the mismatch string
+};
+
+//what the screening needs to know about a read
+struct misread {
+  std::string name;
+  unsigned int start;
+  unsigned int end;
+  std::string strand;
+  std::string seq;
+  bool clipped;                        //quality clipped at either end
+  bool hasmis;                         //the mismatch tag lists more than one mismatch
+  bool MisStatus;                      //mismatch or forbidden positions found
+  std::vector <unsigned int> mismatch; //mismatches in the read ends (genomic)
+  std::vector <unsigned int> fbpos;    //mismatches elsewhere, forbidden as real mis pos
+  std::vector <struct mdhit> md;       //the decoded mismatch tag, reused from read to read
+};
+
+inline void mis_config(struct misconf &conf, unsigned int readlen, const std::string &qual_clip, const std::string &mistag);
+inline void mis_read(const struct misconf &conf, BamTools::BamAlignment &bam, unsigned int real_length, struct misread &mr);
+inline bool mis_piled(struct pileup &pu, unsigned int &oldstart, const struct misread &mr);
+inline void mis_count(struct region &reg, const struct misread &mr, unsigned int endlen);
+inline void mis_endcov(struct region &reg, unsigned int from, unsigned int to);
+inline void eatline(const std::string &str, std::deque <struct region> &regions_ref);
+inline std::string mis_seed(const struct SVread &rd, bool head);
+inline std::string mis_named(const struct SVread &rd, const char *end);
+inline void print_mismatch(struct region &region, std::string &out, std::vector <struct misseed> *seeds = NULL);
+
+
+inline void mis_config(struct misconf &conf, unsigned int readlen, const std::string &qual_clip, const std::string &mistag) {
+
+  conf.readlen = readlen;
+  if (readlen == 0) conf.endlen = 10;
+  else if (readlen < 50) conf.endlen = 10;
+  else if (readlen >=50 && readlen <= 100) conf.endlen = 15;
+  else conf.endlen = 20;
+
+  conf.qual_clip = qual_clip;
+  if (conf.qual_clip == "no")  std::cerr << "quality clipping is turned off." << std::endl;
+  else if (conf.qual_clip == "phred33" || conf.qual_clip == "phred64" || conf.qual_clip == "solexa64")  std::cerr << "read quality type for clipping is set to: " << conf.qual_clip << ".\n";
+  else{
+    conf.qual_clip = "phred33";
+    std::cerr << "quality clipping is on, quality taken default: " << conf.qual_clip << ".\n";
+  }
+  conf.qualmin = qual_min(conf.qual_clip);
+
+  conf.mistag = mistag;  // tag for mismatch
+  if (conf.mistag == "") conf.mistag = "MD";
+  std::cerr << "mismatch tag in the bam file is: " << conf.mistag << std::endl;
+}
+
+inline void mis_read(const struct misconf &conf, BamTools::BamAlignment &bam, unsigned int real_length, struct misread &mr) {
+
+  const std::string &read_qual = bam.Qualities;
+  unsigned int endlen = conf.endlen;
+
+  mr.name   = bam.Name;
+  mr.start  = bam.Position+1;
+  mr.end    = bam.GetEndPosition();
+  mr.strand = "+";
+  if (bam.IsReverseStrand()) mr.strand = "-";
+  mr.seq    = bam.QueryBases;
+  mr.mismatch.clear();
+  mr.fbpos.clear();
+  unsigned int alignmentStart = mr.start;
+
+  // get clipping infomation
+  unsigned int clipleft = 0;
+  unsigned int clipright = 0;
+  bool clipStatus = false;
+  if (conf.qualmin != QUAL_NOCLIP)
+    clipStatus = qual_trim(read_qual.data(), real_length, conf.qualmin, clipleft, clipright);
+  // end: get clipping infomation
+
+  // decode the MD tag to get the mismatches
+  bool MisStatus = false;
+  const char *MD = md_find(bam.TagData, conf.mistag.c_str());
+  if (MD != NULL) md_parse(MD, bam.CigarData, mr.md);
+  else mr.md.clear();
+  std::vector <struct mdhit>::const_iterator mditer = mr.md.begin();
+  for (; mditer != mr.md.end(); mditer++) {
+
+    unsigned int pos = mditer->qpos;                            //the position in the read
+    unsigned int genomic = alignmentStart + mditer->rpos;       // to genomic coordinates
+
+    if (clipStatus == false) {  //clipStatus == false
+      if ( pos < endlen || pos > (real_length - endlen + 1) ) {           //mismatch in the ends
+        mr.mismatch.push_back(genomic);
+        if (MisStatus == false) MisStatus = true;
+      }
+      else {                                                        //forbid this pos as a real mis pos
+        mr.fbpos.push_back(genomic);
+        if (MisStatus == false) MisStatus = true;
+      }
+    }  //noclip
+
+    else {                     //clipStatus == true
+      if (pos > clipleft && pos < (real_length - clipright + 1)) {       // not in clipped region
+        if (pos < endlen || pos > (real_length - endlen + 1)) {
+          mr.mismatch.push_back(genomic);
+          if (MisStatus == false) MisStatus = true;
+        }
+        else {                                                       //forbid this pos as a real mis pos
+          mr.fbpos.push_back(genomic);
+          if (MisStatus == false) MisStatus = true;
+        }
+      } // not in clipped region
+    } // yes clip
+
+  } //mismatches and deletions of the MD tag
+  // end: decode the MD tag to get the mismatches
+
+  mr.clipped   = clipStatus;
+  mr.hasmis    = (mr.md.size() > 1);   //as before: two or more, the split MD pieces were counted after dropping the last one
+  mr.MisStatus = MisStatus;
+}
+
+inline bool mis_piled(struct pileup &pu, unsigned int &oldstart, const struct misread &mr) {
+
+  // skip piling up reads (taking into account: mismatches & clipping information)
+  uint64_t alignSum = pileup_key(mr.start, mr.end, mr.strand == "-");
+
+  if (mr.start != oldstart){
+    pileup_clear(pu);                    //clear pileup set
+    if (mr.clipped == true)
+      pileup_insert(pu, alignSum, 0);                                    // 0: a clipped read
+    else{
+      if (mr.hasmis) pileup_insert(pu, alignSum, 2);                     // 2: a quality read with mismatches
+      else pileup_insert(pu, alignSum, 1);                               // 1: a quality read with no mismatches
+    }
+  }
+  else if (mr.start == oldstart) {
+    unsigned int *piled = pileup_find(pu, alignSum);
+    if (piled) {                                             // looks like a pileup
+      if ( mr.clipped == false ){                            // a perfect read
+        if ( mr.hasmis ) {                                   // a perfect read with mismatch
+          if (*piled == 2) return true;                      // already got, skip
+          if (*piled == 1) *piled += 1;                      // let this read in
+          if (*piled == 0) *piled += 2;                      // let this read in
+        }
+        else {                                               // a perfect read with out mismatch
+          if (*piled == 2) return true;
+          if (*piled == 1) return true;
+          if (*piled == 0) *piled += 1;
+        }
+      }
+      else                                                   // a clipped read
+        return true;
+    }                                     // found pileup key
+    else{                                 // not found key
+      if ( mr.clipped == true )           // a clipped read
+        pileup_insert(pu, alignSum, 0);
+      else{                               // a perfect read
+        if ( mr.hasmis ) pileup_insert(pu, alignSum, 2);
+        else pileup_insert(pu, alignSum, 1);
+      }
+    }
+  }
+  // end: skip piling up reads (taking into account: mismatches & clipping information)
+
+  oldstart = mr.start;
+  return false;
+}
+
+inline void mis_count(struct region &reg, const struct misread &mr, unsigned int endlen) {
+
+  // the read overlaps the region, should add some coverage
+  unsigned int alignmentStart = mr.start;
+  unsigned int alignmentEnd   = mr.end;
+  unsigned int readends1 = alignmentStart+endlen;
+  unsigned int readends2 = alignmentEnd-endlen;
+  bool endinside = false;
+  bool misinside = false;
+
+  reg.coverage++;
+  unsigned int me = reg.SVme.size();  // the mismatches of the current read start here
+
+  if (reg.mispos.empty()) {         // first read of the region
+    unsigned int span = (reg.end >= reg.start) ? reg.end - reg.start + 1 : 0;
+    reg.mispos.assign(span, 0);
+    reg.forbid.assign(span, false);
+    reg.posendcov.assign(span + 1, 0);
+  }
+
+  //add end coverage to each pos, two pairs: alignmentStart-readends1 & readends2-alignmentEnd
+  if (readends2 <= readends1 + 1)   // the pairs meet (readends2 wraps around for reads ending before endlen)
+    mis_endcov(reg, alignmentStart, alignmentEnd);
+  else {
+    mis_endcov(reg, alignmentStart, readends1);
+    mis_endcov(reg, readends2, alignmentEnd);
+  } //add end coverage
+
+  if ((alignmentStart >= reg.start && alignmentStart <= reg.end) || (alignmentEnd >= reg.start && alignmentEnd <= reg.end)) {
+    endinside   = true;     // current read is ending inside the region
+  }
+
+  if (mr.MisStatus == true) {  // do some mismatch counting
+
+    std::vector <unsigned int>::const_iterator misiter = mr.mismatch.begin();
+    for(; misiter != mr.mismatch.end(); misiter++) {
+      if (*misiter >= reg.start && *misiter <= reg.end) {  //mismatches found
+
+        reg.mismatch++;
+
+        reg.SVme.push_back(*misiter);
+        misinside = true;        // current read has ME
+
+        reg.mispos[*misiter - reg.start] ++;
+      }
+    }  //iterator of mismatch(es)
+
+    std::vector <unsigned int>::const_iterator fbiter = mr.fbpos.begin();     // forbidden positions
+    for(; fbiter != mr.fbpos.end(); fbiter++){
+      if (*fbiter >= reg.start && *fbiter <= reg.end) {
+        reg.forbid[*fbiter - reg.start] = true;     // insert the forbidden pos
+      }
+    }  // iterator of fbpos
+  }    // the read has mismatch(es)
+
+  if (endinside == true && misinside == true) {  // store current read if end inside and mis inside
+    struct SVread tmpread;
+    tmpread.start   = alignmentStart;
+    tmpread.end     = alignmentEnd;
+    tmpread.reverse = (mr.strand == "-");
+    tmpread.noseq   = (mr.seq == "NA");
+    std::vector <unsigned int>::iterator mebegin = reg.SVme.begin() + me;
+    std::sort(mebegin, reg.SVme.end());
+    reg.SVme.erase(std::unique(mebegin, reg.SVme.end()), reg.SVme.end());
+    tmpread.me  = me;
+    tmpread.nme = reg.SVme.size() - me;
+    if (tmpread.noseq) tmpread.seq = mr.name;
+    else if (mr.seq.length() <= 50) tmpread.seq = mr.seq;
+    else tmpread.seq = mr.seq.substr(0, 25) + mr.seq.substr(mr.seq.length() - 25, 25);
+    (reg.SVreads).push_back(tmpread);
+  }
+  else reg.SVme.resize(me);
+}
+
+inline void mis_endcov(struct region &reg, unsigned int from, unsigned int to) {
+
+  // one more read end over [from, to] inside the region
+  if (from < reg.start) from = reg.start;
+  if (to > reg.end) to = reg.end;
+  if (from > to) return;
+  reg.posendcov[from - reg.start] ++;
+  reg.posendcov[to - reg.start + 1] --;
+}
+
+inline void eatline(const std::string &str, std::deque <struct region> &regions_ref) {
+
+  std::vector <std::string> line_content;
+  //split line and then put it into a deque
+
+  splitstring(str, line_content, "\t");
+  std::vector <std::string>::iterator iter = line_content.begin();
+  unsigned int i;
+  struct region tmp;
+
+  for(i = 1; iter != line_content.end(); iter++, i++){
+    switch (i) {
+    case 1: // chr
+      tmp.chr = *iter;
+      continue;
+    case 2: // start
+      tmp.start = atoi((*iter).c_str());
+      continue;
+    case 3: // end
+      tmp.end = atoi((*iter).c_str());
+      continue;
+    case 4: // dis
+      tmp.dis = atoi((*iter).c_str());
+      continue;
+    case 5: // depth
+      tmp.depth = atof((*iter).c_str());
+      continue;
+    case 6: // ratio1
+      tmp.ratio1 = atof((*iter).c_str());
+      continue;
+    case 7: // ratio2
+      tmp.ratio2 = atof((*iter).c_str());
+      continue;
+    case 8: // score
+      tmp.score = atof((*iter).c_str());
+      continue;
+    default:
+      break;
+    }
+  }
+  tmp.coverage = 0;
+  tmp.mismatch = 0;
+  regions_ref.push_back(tmp);
+
+}
+
+inline std::string mis_seed(const struct SVread &rd, bool head) {
+  // the first or the last 25bp of the read
+  if (head) return rd.seq.substr(0, 25);
+  return rd.seq.substr(rd.seq.length() - 25, 25);
+}
+
+inline std::string mis_named(const struct SVread &rd, const char *end) {
+  // the seed of a read without bases: its name, strand and which end
+  return rd.seq + "[" + (rd.reverse ? "-" : "+") + end + "]";
+}
+
+inline void print_mismatch(struct region &region, std::string &out, std::vector <struct misseed> *seeds){  // do some mismatch screening thresholding to reach high accuracy
+
+  unsigned int realmis      = 0;
+  unsigned int totalmispos  = 0;
+  float        totalendbase = 0;  
+
+  unsigned int endcov = 0;
+  std::vector <unsigned int>::iterator posenditer = region.posendcov.begin();
+  for (; posenditer != region.posendcov.end(); posenditer++){  // resolve the difference array
+    endcov += *posenditer;
+    *posenditer = endcov;
+    if (endcov > 0) totalendbase += endcov;
+  }
+  float leasterr = 0.01;
+  float n_emis = region.mismatch;
+  float localerr = n_emis/totalendbase;
+  float baserr = std::max(leasterr, localerr);
+  double mismatch_score = 0.;
+
+  for(unsigned int i = 0; i < region.mispos.size(); i++){
+    if (region.mispos[i] == 0) continue;
+    if (! region.forbid[i] ) { // not found in forbidden pos
+      totalmispos++; 
+      mismatch_score += pbinom(region.mispos[i], region.posendcov[i], baserr, 0);
+      if ( region.mispos[i] >= 2 ) {
+        realmis++;
+      } // frequency > 2
+    }   // forbidden pos
+  }     // for each mis pos
+
+  unsigned int max_nme = 0;
+  std::vector <struct SVread>::iterator riter = region.SVreads.begin();
+  for (; riter != region.SVreads.end(); riter++){
+    unsigned int *me  = &region.SVme[riter->me];
+    unsigned int nme = 0;
+    for (unsigned int m = 0; m < riter->nme; m++) {
+      if ( ! region.forbid[me[m] - region.start] ) me[nme++] = me[m];  // clean non-end mis
+    }
+    riter->nme = nme;
+    if ( nme > max_nme ) max_nme = nme;
+  } // current SVread
+
+  std::vector <struct SVread *> topreads;   // the reads with the most end mismatches, in order
+  for (riter = region.SVreads.begin(); riter != region.SVreads.end(); riter++){
+    if (riter->nme == max_nme) topreads.push_back(&*riter);
+  }
+
+  std::string seedseq = "RME";    // decide the seed sequence 
+  if (max_nme > 0) {
+    if (topreads.size() == 1){
+      struct SVread *topiter = topreads.front();
+      unsigned int memin = region.SVme[topiter->me];
+      if ( (memin - topiter->start) < (topiter->end - memin) ) {
+        if (topiter->noseq) seedseq = mis_named(*topiter, "p");
+        else seedseq = mis_seed(*topiter, true);
+      }
+      else {
+        if (topiter->noseq) seedseq = mis_named(*topiter, "s");
+        else seedseq = mis_seed(*topiter, false);
+      }
+    }  
+    else {
+      struct SVread *topiter  = topreads.front();
+      struct SVread *topiter2 = topreads.back();
+      if (topiter->start >= region.start && topiter->end > region.end) { // the first top read is starting in the region
+         if (topiter->noseq) seedseq = mis_named(*topiter, "p");
+         else seedseq = mis_seed(*topiter, true);
+      }
+      else if (topiter2->start < region.start && topiter2->end <= region.end) {
+         if (topiter->noseq) seedseq = mis_named(*topiter, "s");
+         else seedseq = mis_seed(*topiter2, false);
+      }
+      else {
+        // where is the changing point? if ratio2 > 0.5 take the start, else take the end
+        struct SVread *toprem = topiter;
+        for (unsigned int t = 0; t < topreads.size(); t++) {
+
+          topiter = topreads[t];
+          unsigned int memin = region.SVme[topiter->me];                    // the first mis
+          unsigned int memax = region.SVme[topiter->me + topiter->nme - 1]; // the last  mis
+
+          if ( topiter->end <= region.end && (memin - topiter->start) > (topiter->end - memin) ) {
+            toprem = topiter;
+          }
+          if ( topiter->start >= region.start && (memax - topiter->start) < (topiter->end - memax)) {  // now its turning
+              if ( region.ratio2 > 0.5 ) {
+                if (topiter->noseq) seedseq = mis_named(*topiter, "p");
+                else seedseq = mis_seed(*topiter, true);
+              }
+              else {
+                if (topiter->noseq) seedseq = mis_named(*topiter, "s");
+                else seedseq = mis_seed(*toprem, false);
+              }
+              break;
+          } // turning
+        } // for top iter
+
+        if (seedseq == "RME"){
+          if (toprem->noseq) seedseq = mis_named(*toprem, "s");
+          else seedseq = mis_seed(*toprem, false);
+        }
+
+      } //else
+    } // > 1
+  } //max_nme > 0
+
+  float fdepth = region.coverage;
+  float edepth = fdepth*(region.ratio1);
+  float mirate = (region.mismatch)/edepth;
+
+  std::string chrom        = region.chr.c_str();
+  if (chrom.substr(0,3) != "chr") chrom = "chr"+chrom;
+  unsigned int start  = region.start;
+  unsigned int end    = region.end;
+  float confi         = mismatch_score;
+
+  if ( totalmispos > 1 )  //screen for number of positions where there are mismatches
+    if ( region.coverage >= 5 ) { //screen for coverage
+     //if ( !(region.coverage > 100 && region.score < 1.1) ) // filter out hard to say stuff just for XLMR project!!!!!
+      //if ( realmis > 0 || (mirate > 1 && region.coverage >= 10 && region.mismatch < 50) ) //screen for realmis and mirate
+      // chrom source type start end score(precision 3) strand phase tag, the floats of the tag as an ostream writes them
+      std::string::size_type line = out.size();     // where the fields of the seed start and end
+      out += chrom;
+      out += "\tBreakpointer\tDepth-Skewed\t";
+      out_uint(out, start);
+      out += '\t';
+      out_uint(out, end);
+      std::string::size_type scored = out.size();
+      out += '\t';
+      out_general(out, confi, 3);
+      std::string::size_type tailed = out.size();
+      out += "\t+\t.\tID=";
+      std::string::size_type id = out.size();
+      out += chrom;
+      out += ':';
+      out_uint(out, start);
+      std::string::size_type idend = out.size();
+      out += ";SIZE=";
+      out_uint(out, region.dis);
+      out += ";DEPTH=";
+      out_uint(out, region.coverage);
+      out += ";EndsRatio=";
+      out_general(out, region.ratio1, 6);
+      out += ";StartsRatio=";
+      out_general(out, region.ratio2, 6);
+      out += ";BinomialScore=";
+      std::string::size_type sb = out.size();
+      out_general(out, region.score, 6);
+      std::string::size_type sbend = out.size();
+      out += ";MIS=";
+      out_uint(out, region.mismatch);
+      out += ";realMIS=";
+      out_uint(out, realmis);
+      out += ";MISRATE=";
+      out_general(out, mirate, 6);
+      out += ";seedseq=";
+      out += seedseq;
+      if (seeds != NULL) {
+        struct misseed seed;
+        seed.head.assign(out, line, scored - line);
+        seed.score.assign(out, scored + 1, tailed - scored - 1);
+        seed.tail.assign(out, tailed + 1, std::string::npos);
+        seed.id.assign(out, id, idend - id);
+        seed.sb.assign(out, sb, sbend - sb);
+        seed.seedseq = seedseq;
+        seeds->push_back(seed);
+      }
+      out += '\n';
+    }
+}
+
+#endif
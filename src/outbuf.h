@@ -0,0 +1,194 @@
+/*
+
+ Copyright (C) 2011 Sun Ruping <rs3412@columbia.edu>
+
+ This file is part of Breakpointer.
+
+ Breakpointer is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License.
+
+ outbuf.h: the text output of breakpointer (regions and the --indiprint
+ trace) and breakmis (gff). The lines are put together in a std::string
+ with the number formatting here, which gives the same text as printf
+ and the iostreams did: integers are written digit by digit, "%.Nf" of a
+ float is rounded as an integer (the float times 10^N is exact in a
+ double, rint rounds half to even as printf does), "%.Ng" and the fixed
+ form of a double still go through snprintf into a stack buffer.
+
+ An outfile is a large buffer in front of a FILE, written out once it
+ holds OUTBUF_SIZE bytes and at outfile_close, plain or as BGZF blocks
+ (bgzip, read by zcat and bgzip -d; the empty block at the end marks the
+ end of the file). The FILE itself is left open. A pipe or a FIFO is
+ written every OUTBUF_PIPE bytes instead (a BGZF block with bgzip), as
+ stdio did, so the runlevel reading it (--stream) is not kept waiting.
+
+*/
+
+#ifndef BREAKPOINTER_OUTBUF_H
+#define BREAKPOINTER_OUTBUF_H
+
+#include <string>
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <cmath>
+#include <stdint.h>
+#include <sys/stat.h>
+#include <zlib.h>
+
+#define OUTBUF_SIZE  (1 << 20)
+#define OUTBUF_PIPE  4096              // the buffer of stdio in front of a pipe
+#define OUTBUF_BLOCK 0xff00            // input bytes of a BGZF block
+
+struct outfile {
+  FILE *fp;
+  bool bgzip;
+  size_t limit;                        // written out at this many bytes
+  std::string buf;
+  z_stream zs;
+};
+
+inline void outfile_open(struct outfile &of, FILE *fp, bool bgzip);
+inline void outfile_check(struct outfile &of);
+inline void outfile_write(struct outfile &of, const std::string &data);
+inline void outfile_flush(struct outfile &of);
+inline void outfile_close(struct outfile &of);
+inline void outfile_block(struct outfile &of, const char *data, size_t n);
+inline void out_uint(std::string &s, unsigned long long v);
+inline void out_int(std::string &s, long long v);
+inline void out_fixed(std::string &s, float v, int digits);
+inline void out_fixed(std::string &s, double v, int digits);
+inline void out_general(std::string &s, double v, int precision);
+
+
+inline void outfile_open(struct outfile &of, FILE *fp, bool bgzip) {
+  of.fp = fp;
+  of.bgzip = bgzip;
+  of.limit = OUTBUF_SIZE;
+  struct stat st;
+  if (fstat(fileno(fp), &st) == 0 && S_ISFIFO(st.st_mode)) of.limit = bgzip ? OUTBUF_BLOCK : OUTBUF_PIPE;
+  of.buf.clear();
+  of.buf.reserve(OUTBUF_SIZE + 4096);
+  if (bgzip) {
+    memset(&of.zs, 0, sizeof(of.zs));
+    deflateInit2(&of.zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY);
+  }
+}
+
+inline void outfile_check(struct outfile &of) {
+  if (of.buf.size() >= of.limit) outfile_flush(of);
+}
+
+inline void outfile_write(struct outfile &of, const std::string &data) {
+  of.buf.append(data);
+  outfile_check(of);
+}
+
+inline void outfile_flush(struct outfile &of) {
+
+  // everything in the buffer goes out to the file, the last BGZF block may be short then
+  if (of.buf.empty()) return;
+  if (!of.bgzip) fwrite(of.buf.data(), 1, of.buf.size(), of.fp);
+  else {
+    for (size_t i = 0; i < of.buf.size(); i += OUTBUF_BLOCK) {
+      size_t n = of.buf.size() - i;
+      outfile_block(of, of.buf.data() + i, (n > OUTBUF_BLOCK) ? OUTBUF_BLOCK : n);
+    }
+  }
+  of.buf.clear();
+  fflush(of.fp);
+}
+
+inline void outfile_close(struct outfile &of) {
+  outfile_flush(of);
+  if (of.bgzip) {
+    outfile_block(of, NULL, 0);        // the empty end of file block
+    deflateEnd(&of.zs);
+    of.bgzip = false;
+  }
+  fflush(of.fp);
+}
+
+inline void outfile_block(struct outfile &of, const char *data, size_t n) {
+
+  // one BGZF block of n bytes (an empty one ends the file)
+  unsigned char out[65536];
+  deflateReset(&of.zs);
+  of.zs.next_in   = (n > 0) ? (Bytef *)data : (Bytef *)out;
+  of.zs.avail_in  = n;
+  of.zs.next_out  = out + 18;
+  of.zs.avail_out = sizeof(out) - 18 - 8;
+  if (deflate(&of.zs, Z_FINISH) != Z_STREAM_END) {
+    fprintf(stderr, "BGZF block does not fit\n");
+    exit(1);
+  }
+  unsigned int clen  = sizeof(out) - 18 - 8 - of.zs.avail_out;
+  unsigned int bsize = 18 + clen + 8;
+  unsigned char head[18] = {31, 139, 8, 4, 0, 0, 0, 0, 0, 255, 6, 0, 66, 67, 2, 0,
+                            (unsigned char)((bsize - 1) & 0xff), (unsigned char)((bsize - 1) >> 8)};
+  memcpy(out, head, 18);
+  uint32_t crc   = crc32(crc32(0L, Z_NULL, 0), (n > 0) ? (const Bytef *)data : Z_NULL, n);
+  uint32_t isize = n;
+  memcpy(out + 18 + clen, &crc, 4);
+  memcpy(out + 18 + clen + 4, &isize, 4);
+  fwrite(out, 1, bsize, of.fp);
+}
+
+inline void out_uint(std::string &s, unsigned long long v) {
+  char digits[24];
+  int n = 0;
+  do {
+    digits[n++] = '0' + v % 10;
+    v /= 10;
+  } while (v != 0);
+  while (n > 0) s.push_back(digits[--n]);
+}
+
+inline void out_int(std::string &s, long long v) {
+  if (v < 0) {
+    s.push_back('-');
+    out_uint(s, 0ULL - (unsigned long long)v);
+  }
+  else out_uint(s, v);
+}
+
+inline void out_fixed(std::string &s, float v, int digits) {
+
+  // "%.<digits>f" of v
+  static const double scale[] = {1., 10., 100., 1e3, 1e4, 1e5, 1e6};
+  static const unsigned long long pow10[] = {1, 10, 100, 1000, 10000, 100000, 1000000};
+  double x = (digits >= 0 && digits <= 6) ? (double)v * scale[digits] : 0.;
+  if (digits < 0 || digits > 6 || !(fabs(x) < 9007199254740992.)) {  // 2^53, or not finite
+    out_fixed(s, (double)v, digits);
+    return;
+  }
+  double r = rint(x);
+  if (std::signbit(r)) s.push_back('-');
+  unsigned long long k = (unsigned long long)fabs(r);
+  out_uint(s, k / pow10[digits]);
+  if (digits == 0) return;
+  s.push_back('.');
+  unsigned long long frac = k % pow10[digits];
+  for (int d = digits - 1; d >= 0; d--) s.push_back('0' + (frac / pow10[d]) % 10);
+}
+
+inline void out_fixed(std::string &s, double v, int digits) {
+  char buf[512];
+  int n = snprintf(buf, sizeof(buf), "%.*f", digits, v);
+  if (n < (int)sizeof(buf)) s.append(buf, n);
+  else {                               // a huge number
+    std::string big(n + 1, '\0');
+    snprintf(&big[0], n + 1, "%.*f", digits, v);
+    s.append(big, 0, n);
+  }
+}
+
+inline void out_general(std::string &s, double v, int precision) {
+
+  // "%.<precision>g", what an ostream with this precision writes
+  char buf[64];
+  int n = snprintf(buf, sizeof(buf), "%.*g", precision, v);
+  s.append(buf, n);
+}
+
+#endif
@@ -0,0 +1,106 @@
+/*
+
+ Copyright (C) 2011 Sun Ruping <rs3412@columbia.edu>
+
+ This file is part of Breakpointer.
+
+ Breakpointer is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License.
+
+ pileup.h: the piling-up read filter shared by breakpointer and breakmis.
+ Reads piling up share start, end and strand; the start is the same for
+ every key in the table because it is cleared whenever the start changes,
+ so a small open-addressing table of packed 64-bit keys is enough.
+
+*/
+
+#ifndef BREAKPOINTER_PILEUP_H
+#define BREAKPOINTER_PILEUP_H
+
+#include <stdint.h>
+#include <vector>
+
+struct pileslot {
+  uint64_t key;
+  unsigned int value;
+  unsigned int gen;      // the slot is in use if gen == pileup.gen
+};
+
+struct pileup {
+  std::vector <struct pileslot> slots;
+  unsigned int mask;     // slots.size() - 1, size is a power of two
+  unsigned int used;     // keys in the table
+  unsigned int gen;      // bumped by pileup_clear, so clearing is O(1)
+};
+
+inline void pileup_init(struct pileup &pu, unsigned int size);
+inline void pileup_clear(struct pileup &pu);
+inline uint64_t pileup_key(unsigned int start, unsigned int end, bool reverse);
+inline unsigned int *pileup_find(struct pileup &pu, uint64_t key);
+inline unsigned int *pileup_insert(struct pileup &pu, uint64_t key, unsigned int value);
+
+
+inline void pileup_init(struct pileup &pu, unsigned int size) {
+  struct pileslot empty = {0, 0, 0};
+  pu.slots.assign(size, empty);
+  pu.mask = size - 1;
+  pu.used = 0;
+  pu.gen  = 1;
+}
+
+inline void pileup_clear(struct pileup &pu) {
+  pu.used = 0;
+  pu.gen++;
+  if (pu.gen == 0) {           // wrapped around, really clear the slots once
+    pileup_init(pu, pu.slots.size());
+  }
+}
+
+inline uint64_t pileup_key(unsigned int start, unsigned int end, bool reverse) {
+  return ((uint64_t)start << 33) ^ ((uint64_t)end << 1) ^ (reverse ? 1 : 0);
+}
+
+inline unsigned int pileup_hash(struct pileup &pu, uint64_t key) {
+  key ^= key >> 29;
+  key *= 0xbf58476d1ce4e5b9ULL;
+  key ^= key >> 32;
+  return (unsigned int)key & pu.mask;
+}
+
+inline unsigned int *pileup_find(struct pileup &pu, uint64_t key) {
+  unsigned int i = pileup_hash(pu, key);
+  while (pu.slots[i].gen == pu.gen) {
+    if (pu.slots[i].key == key) return &(pu.slots[i].value);
+    i = (i + 1) & pu.mask;
+  }
+  return 0;
+}
+
+inline unsigned int *pileup_insert(struct pileup &pu, uint64_t key, unsigned int value) {
+
+  if (2 * (pu.used + 1) > pu.slots.size()) {   // keep the load under one half
+    std::vector <struct pileslot> old;
+    old.swap(pu.slots);
+    unsigned int gen = pu.gen;
+    pileup_init(pu, 2 * old.size());
+    for (unsigned int j = 0; j < old.size(); j++) {
+      if (old[j].gen == gen) pileup_insert(pu, old[j].key, old[j].value);
+    }
+  }
+
+  unsigned int i = pileup_hash(pu, key);
+  while (pu.slots[i].gen == pu.gen) {
+    if (pu.slots[i].key == key) {
+      pu.slots[i].value = value;
+      return &(pu.slots[i].value);
+    }
+    i = (i + 1) & pu.mask;
+  }
+  pu.slots[i].key   = key;
+  pu.slots[i].value = value;
+  pu.slots[i].gen   = pu.gen;
+  pu.used++;
+  return &(pu.slots[i].value);
+}
+
+#endif
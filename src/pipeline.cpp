@@ -0,0 +1,477 @@
+/*****************************************************************************
+
+  pipeline.cpp @ Breakpointer
+  breakpointer-pipeline: the runlevels of breakpointer_run.pl in one
+  process. breakpointer.cpp, breakmis.cpp and breakvali.cpp are compiled
+  in here, each in a namespace of its own (bp, bm and bv), and their mains
+  are called in turn with the arguments breakpointer_run.pl gives the
+  binaries; the stdout of a stage goes to the output file of its runlevel.
+
+  When runlevel 1 and 2 both run, the regions go from the window scan to
+  the mismatch screening as structs in the same pass over the BAM files
+  (breakpointer --misout), so the BAM files, their indexes and the
+  reference dictionary are opened once for both. Runlevel 3 gets the
+  regions screened by runlevel 2 as structs (misseeds) and, with --umrbam,
+  the BAM files runlevel 1 or 2 left open (bamkept); a runlevel before it
+  that was not run here (its output exists) is read from its file, as in
+  the script. The wall time and peak memory after each runlevel are
+  written to <basename>.timing.json in the output directory, also when a
+  stage ends the process (the summary is written at exit then, with the
+  stage it was in as failed or exited).
+
+  (c) 2011 - Sun Ruping
+  Dept. Vingron (Computational Mol. Bio.)
+  Max-Planck-Institute for Molecular Genetics
+  Ihnestr. 73, D-14195, Berlin, Germany
+
+  current affiliation: Department of Systems Biology, Columbia University, NY, USA
+  EMAIL: rs3412@columbia.edu
+
+  Breakpointer is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License.
+
+******************************************************************************/
+
+// everything the stages include, outside of their namespaces
+#include <api/BamReader.h>
+#include <api/BamMultiReader.h>
+#include <iostream>
+#include <fstream>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdarg>
+#include <cmath>
+#include <vector>
+#include <deque>
+#include <map>
+#include <set>
+#include <string>
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+#include <stdint.h>
+#include <getopt.h>
+#include <glob.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include "mathstats.h"
+#include "pileup.h"
+#include "bincache.h"
+#include "strutil.h"
+#include "mismatch.h"
+#include "regindex.h"
+#include "bamin.h"
+#include "seqin.h"
+#include "regbin.h"
+#include "outbuf.h"
+#include "wintrace.h"
+
+#define main stage_main
+namespace bp {
+#include "breakpointer.cpp"
+}
+namespace bm {
+#include "breakmis.cpp"
+}
+namespace bv {
+#include "breakvali.cpp"
+}
+#undef main
+
+#include "ifpl.h"
+
+using namespace std;
+
+//a runlevel as it went, for the timing summary
+struct stagetime {
+  string runlevel;
+  string stage;
+  string output;
+  string status;                 //run, exists (skipped), noexecute, failed (returned non-zero) or exited
+  double seconds;
+  long maxrss;                   //peak resident size of the process after it, kB
+};
+
+//the timing summary, written at the end or at exit when a stage ends the process
+string timing;                   //its file, empty once it is written
+string timebase;                 //the basename in it
+double timestart = 0;
+vector <struct stagetime> times;
+struct stagetime *running = NULL;     //the stage being run
+double runstart = 0;
+
+inline double now();
+inline set <unsigned int> runlevels(const char *spec);
+inline bool exists(const string &fname);
+inline void stage_run(struct stagetime &st, int (*stage)(int, char **), const vector <string> &args, const string &out, bool noexecute);
+inline bool timing_write();
+void timing_exit();
+inline string json_string(const string &str);
+
+int main (int argc, char *argv[]) {
+
+  struct parameters *param = 0;
+  param = interface(param, argc, argv);
+
+  set <unsigned int> runlevel = runlevels(param->runlevel);
+  string mapfile = (param->mapping_f != 0) ? param->mapping_f : "";
+  if (mapfile == "") {
+    cerr << "warning: no mapping file is given, stop running." << endl;
+    usage();
+    exit(0);
+  }
+  if (access(mapfile.c_str(), R_OK) != 0) {
+    cerr << "warning: " << mapfile << " is not readable or not present." << endl;
+    exit(0);
+  }
+
+  string out_dir = (param->outdir != 0) ? param->outdir : "./";
+  if (access(out_dir.c_str(), W_OK) != 0) {
+    cerr << out_dir << " is not writable" << endl;
+    exit(0);
+  }
+  string basename = (param->basename != 0) ? param->basename : "";
+  if (basename == "") {
+    string::size_type slash = mapfile.find_last_of('/');
+    basename = (slash == string::npos) ? mapfile : mapfile.substr(slash + 1);
+  }
+  cerr << "output directory is " << out_dir << "." << endl;
+  cerr << "output basename is " << basename << "." << endl;
+
+  string unmapped = (param->unmap_f != 0) ? param->unmap_f : "";
+  bool umrbam = (param->umrbam == 1);
+  if (unmapped == "" && !umrbam) {
+    cerr << "warning: no unmapped reads file is given, runlevel3 will be skipped" << endl;
+    runlevel.erase(3);
+  }
+  else if (unmapped != "" && access(unmapped.c_str(), R_OK) != 0) {
+    cerr << "warning: " << unmapped << " is not readable or not present." << endl;
+    exit(0);
+  }
+
+  string mistag = (param->mistag != 0) ? param->mistag : "MD";
+  string qualclip = (param->qualclip == 1) ? "phred33" : "no";
+  char number[32];
+
+  string endskew    = out_dir + "/" + basename + ".endskew";
+  string endskewmis = out_dir + "/" + basename + ".endskew.mis.gff";
+  string vali       = out_dir + "/" + basename + ".endskew.mis.vali.gff";
+  timing    = out_dir + "/" + basename + ".timing.json";
+  timebase  = basename;
+  timestart = now();
+  atexit(timing_exit);
+
+  // what runlevel 3 takes from the runlevels before it in this process
+  bool validate = (runlevel.count(3) && !exists(vali));
+  vector <struct misseed> misseeds;    // the regions screened by runlevel 2
+  bool screened = false;
+  struct bamin bam;                    // the BAM files, for --umrbam
+  bool bamopen = false;
+
+//-------------------------------------------------------------------------------------------------------+
+// runlevel 1 (and 2 in the same pass)                                                                   |
+//-------------------------------------------------------------------------------------------------------+
+  bool fused = false;
+  if (runlevel.count(1)) {
+    cerr << "RUNLEVEL 1: scan the read alignment, searching for depth skewed regions" << endl;
+    vector <string> args;
+    args.push_back("breakpointer");
+    args.push_back("--mapping");
+    args.push_back(mapfile);
+    if (param->windowsize != 0) {
+      snprintf(number, sizeof(number), "%u", param->windowsize);
+      args.push_back("--windowsize");
+      args.push_back(number);
+    }
+    if (param->readlen != 0) {
+      snprintf(number, sizeof(number), "%u", param->readlen);
+      args.push_back("--readlen");
+      args.push_back(number);
+    }
+    if (param->unique != 0) args.push_back("--unique");
+    if (runlevel.count(2) && !exists(endskewmis) && !exists(endskew)) {  // runlevel 2 in the same pass
+      fused = true;
+      args.push_back("--misout");
+      args.push_back(endskewmis);
+      args.push_back("--qualclip");
+      args.push_back(qualclip);
+      args.push_back("--mistag");
+      args.push_back(mistag);
+    }
+    if (param->iothreads != 0) {
+      snprintf(number, sizeof(number), "%u", param->iothreads);
+      args.push_back("--io-threads");
+      args.push_back(number);
+    }
+
+    struct stagetime st;
+    st.runlevel = fused ? "1,2" : "1";
+    st.stage    = "breakpointer";
+    st.output   = fused ? endskew + " " + endskewmis : endskew;
+    if (exists(endskew)) {
+      cerr << endskew << " exists, skip running RUNLEVEL 1" << endl;
+      st.status = "exists";
+      st.seconds = 0;
+      st.maxrss = 0;
+    }
+    else {
+      bp::misseeds = (fused && validate) ? &misseeds : NULL;
+      bp::bamkept  = (validate && umrbam) ? &bam : NULL;
+      stage_run(st, bp::stage_main, args, endskew, param->noexecute == 1);
+      screened = (bp::misseeds != NULL && st.status == "run");
+      bamopen  = (bp::bamkept != NULL && st.status == "run");
+    }
+    times.push_back(st);
+    cerr << "RUNLEVEL 1 done" << endl;
+  }
+
+//-------------------------------------------------------------------------------------------------------+
+// runlevel 2 on its own                                                                                 |
+//-------------------------------------------------------------------------------------------------------+
+  if (runlevel.count(2) && !fused) {
+    cerr << "RUNLEVEL 2: mismatch screening for each depth skewed region" << endl;
+    if (access(endskew.c_str(), R_OK) != 0) cerr << "warning: " << endskew << " is not readable!" << endl;
+    vector <string> args;
+    args.push_back("breakmis");
+    args.push_back("--region");
+    args.push_back(endskew);
+    args.push_back("--mapping");
+    args.push_back(mapfile);
+    if (param->readlen != 0) {
+      snprintf(number, sizeof(number), "%u", param->readlen);
+      args.push_back("--readlen");
+      args.push_back(number);
+    }
+    if (param->unique != 0) args.push_back("--unique");
+    args.push_back("--qualclip");
+    args.push_back(qualclip);
+    args.push_back("--mistag");
+    args.push_back(mistag);
+    if (param->iothreads != 0) {
+      snprintf(number, sizeof(number), "%u", param->iothreads);
+      args.push_back("--io-threads");
+      args.push_back(number);
+    }
+
+    struct stagetime st;
+    st.runlevel = "2";
+    st.stage    = "breakmis";
+    st.output   = endskewmis;
+    if (exists(endskewmis)) {
+      cerr << endskewmis << " exists, skip running RUNLEVEL 2" << endl;
+      st.status = "exists";
+      st.seconds = 0;
+      st.maxrss = 0;
+    }
+    else {
+      bm::misseeds = validate ? &misseeds : NULL;
+      bm::bamkept  = (validate && umrbam && !bamopen) ? &bam : NULL;
+      stage_run(st, bm::stage_main, args, endskewmis, param->noexecute == 1);
+      screened = (bm::misseeds != NULL && st.status == "run");
+      if (bm::bamkept != NULL && st.status == "run") bamopen = true;
+    }
+    times.push_back(st);
+    cerr << "RUNLEVEL 2 done" << endl;
+  }
+
+//-------------------------------------------------------------------------------------------------------+
+// runlevel 3                                                                                            |
+//-------------------------------------------------------------------------------------------------------+
+  if (runlevel.count(3)) {
+    cerr << "RUNLEVEL 3: validation using unmapped reads" << endl;
+    if (access(endskewmis.c_str(), R_OK) != 0 && param->noexecute == 0) {
+      cerr << "warning: " << endskewmis << " is not readable." << endl;
+      exit(0);
+    }
+    vector <string> args;
+    args.push_back("breakvali");
+    if (unmapped != "") {
+      args.push_back("--umr");
+      args.push_back(unmapped);
+    }
+    if (umrbam) {                      // the unmapped reads at the end of the BAM files
+      args.push_back("--mapping");
+      args.push_back(mapfile);
+      if (param->softclip == 1) args.push_back("--softclip");
+    }
+    snprintf(number, sizeof(number), "%u", (param->readlen != 0) ? param->readlen : 36);
+    args.push_back("--readlen");
+    args.push_back(number);
+    args.push_back("--ermis");
+    args.push_back(endskewmis);
+    if (param->iothreads != 0) {
+      snprintf(number, sizeof(number), "%u", param->iothreads);
+      args.push_back("--threads");
+      args.push_back(number);
+    }
+    args.push_back("--verbose");
+
+    struct stagetime st;
+    st.runlevel = "3";
+    st.stage    = "breakvali";
+    st.output   = vali;
+    if (exists(vali)) {
+      cerr << vali << " exists, skip running RUNLEVEL 3" << endl;
+      st.status = "exists";
+      st.seconds = 0;
+      st.maxrss = 0;
+    }
+    else {
+      bv::misseeds = screened ? &misseeds : NULL;   // --ermis is not read then
+      bv::bamkept  = bamopen ? &bam : NULL;
+      stage_run(st, bv::stage_main, args, vali, param->noexecute == 1);
+    }
+    times.push_back(st);
+    cerr << "RUNLEVEL 3 done" << endl;
+  }
+
+//-------------------------------------------------------------------------------------------------------+
+// timing summary                                                                                        |
+//-------------------------------------------------------------------------------------------------------+
+  if (bamopen) bamin_close(bam);
+  if (!timing_write()) exit(1);
+  cerr << "DONE." << endl;
+
+  delete_param(param);
+  return 0;
+
+} //main
+
+inline double now() {
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+inline set <unsigned int> runlevels(const char *spec) {
+
+  // "1", "2,3", "1-3", "2-" (to 20) or "-2" (from 1) as breakpointer_run.pl takes them, 1-3 if not given
+  set <unsigned int> levels;
+  string all = (spec != 0) ? spec : "";
+  if (all == "" || all == "0") {
+    for (unsigned int i = 1; i <= 3; i++) levels.insert(i);
+    return levels;
+  }
+  string::size_type from = 0;
+  while (from <= all.size()) {
+    string::size_type comma = all.find(',', from);
+    string r = all.substr(from, (comma == string::npos) ? string::npos : comma - from);
+    from = (comma == string::npos) ? all.size() + 1 : comma + 1;
+
+    unsigned int a = 1, b = 20;
+    if (!r.empty() && isdigit(r[0])) a = atoi(r.c_str());
+    string::size_type dash = r.rfind('-');
+    if (dash != string::npos && dash + 1 < r.size() && r.find_first_not_of("0123456789", dash + 1) == string::npos) b = atoi(r.c_str() + dash + 1);
+    else if (r.find('-') == string::npos) b = a;
+    for (unsigned int i = a; i <= b; i++) levels.insert(i);
+  }
+  return levels;
+}
+
+inline bool exists(const string &fname) {
+  return access(fname.c_str(), F_OK) == 0;
+}
+
+inline void stage_run(struct stagetime &st, int (*stage)(int, char **), const vector <string> &args, const string &out, bool noexecute) {
+
+  // calls the main of a stage with its stdout going to out, its time goes to st
+  st.status  = noexecute ? "noexecute" : "run";
+  st.seconds = 0;
+  st.maxrss  = 0;
+  string cmd;
+  for (unsigned int i = 0; i < args.size(); i++) cmd += args[i] + " ";
+  cerr << cmd << ">" << out << endl;
+  if (noexecute) return;
+
+  vector < vector <char> > store(args.size());   // writable, the stages may cut them up
+  vector <char *> argv;
+  for (unsigned int i = 0; i < args.size(); i++) {
+    store[i].assign(args[i].begin(), args[i].end());
+    store[i].push_back('\0');
+    argv.push_back(&store[i][0]);
+  }
+  argv.push_back(NULL);
+
+  fflush(stdout);
+  int saved = dup(1);
+  int fd = open(out.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+  if (saved < 0 || fd < 0) {
+    cerr << "can not write " << out << endl;
+    exit(1);
+  }
+  dup2(fd, 1);
+  close(fd);
+
+  optind = 0;                          // a fresh getopt scan for the stage
+  running  = &st;                      // until it returns, an exit() in it is the exit of the stage
+  runstart = now();
+  int ret = stage(args.size(), &argv[0]);
+  cout.flush();
+  fflush(stdout);
+  st.seconds = now() - runstart;
+  dup2(saved, 1);
+  close(saved);
+
+  struct rusage ru;
+  getrusage(RUSAGE_SELF, &ru);
+  st.maxrss = ru.ru_maxrss;
+  running = NULL;
+  if (ret != 0) {
+    cerr << args[0] << " failed (" << ret << ")" << endl;
+    st.status = "failed";
+    times.push_back(st);
+    exit(ret);
+  }
+}
+
+inline bool timing_write() {
+
+  // the stages so far, once
+  if (timing == "") return true;
+  string fname = timing;
+  timing = "";
+  FILE *tf = fopen(fname.c_str(), "w");
+  if (tf == NULL) {
+    cerr << "can not write the timing summary to " << fname << endl;
+    return false;
+  }
+  fprintf(tf, "{\n  \"basename\": %s,\n  \"stages\": [\n", json_string(timebase).c_str());
+  for (unsigned int i = 0; i < times.size(); i++) {
+    const struct stagetime &st = times[i];
+    fprintf(tf, "    {\"runlevel\": %s, \"stage\": %s, \"output\": %s, \"status\": %s, \"seconds\": %.3f, \"maxrss_kb\": %ld}%s\n",
+            json_string(st.runlevel).c_str(), json_string(st.stage).c_str(), json_string(st.output).c_str(),
+            json_string(st.status).c_str(), st.seconds, st.maxrss, (i + 1 < times.size()) ? "," : "");
+  }
+  fprintf(tf, "  ],\n  \"seconds\": %.3f\n}\n", now() - timestart);
+  fclose(tf);
+  cerr << "timing summary written to " << fname << endl;
+  return true;
+}
+
+void timing_exit() {
+
+  // the process ends before the summary is written: a stage (or the pipeline) called exit()
+  if (running != NULL) {
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    running->status  = "exited";
+    running->seconds = now() - runstart;
+    running->maxrss  = ru.ru_maxrss;
+    times.push_back(*running);
+    running = NULL;
+  }
+  timing_write();
+}
+
+inline string json_string(const string &str) {
+  string quoted = "\"";
+  for (unsigned int i = 0; i < str.size(); i++) {
+    if (str[i] == '"' || str[i] == '\\') quoted += '\\';
+    quoted += str[i];
+  }
+  return quoted + "\"";
+}
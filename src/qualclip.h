@@ -0,0 +1,107 @@
+/*
+
+ Copyright (C) 2011 Sun Ruping <rs3412@columbia.edu>
+
+ This file is part of Breakpointer.
+
+ Breakpointer is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License.
+
+ qualclip.h: the quality clipping of the mismatch screening. A base is
+ good at quality >= 5; the read keeps the span from the first to the last
+ run of >= 5 good bases. The encoding is resolved once into the lowest
+ good quality character (qual_min), then each 64 bases become a bit mask
+ (SSE2 or AVX2 compares when compiled in, scalar otherwise) and the runs
+ are found on the masks: bit i of m & m>>1 & .. & m>>4 is set when bases
+ i..i+4 are all good.
+
+*/
+
+#ifndef BREAKPOINTER_QUALCLIP_H
+#define BREAKPOINTER_QUALCLIP_H
+
+#include <string>
+#include <stdint.h>
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+#define QUAL_NOCLIP -1000         // qual_min when clipping is turned off
+
+inline int qual_min(const std::string &qual_clip);
+inline uint64_t qual_word(const char *qual, unsigned int n, int minqual);
+inline void qual_runs(uint64_t w, uint64_t next, unsigned int offset, int &first, int &last);
+inline bool qual_trim(const char *qual, unsigned int length, int minqual, unsigned int &clipleft, unsigned int &clipright);
+
+
+inline int qual_min(const std::string &qual_clip) {
+  if (qual_clip == "no") return QUAL_NOCLIP;
+  if (qual_clip == "phred64" || qual_clip == "solexa64") return 64 + 5;
+  return 33 + 5;                  // phred33
+}
+
+inline uint64_t qual_word(const char *qual, unsigned int n, int minqual) {
+
+  // bit i set when qual[i] >= minqual, n <= 64; compared as (signed) char like int(qual[i]) did
+  uint64_t w = 0;
+  unsigned int i = 0;
+#if defined(__AVX2__)
+  if (n == 64) {
+    __m256i lo = _mm256_set1_epi8((char)(minqual - 1));
+    uint32_t a = _mm256_movemask_epi8(_mm256_cmpgt_epi8(_mm256_loadu_si256((const __m256i *)qual), lo));
+    uint32_t b = _mm256_movemask_epi8(_mm256_cmpgt_epi8(_mm256_loadu_si256((const __m256i *)(qual + 32)), lo));
+    return (uint64_t)a | ((uint64_t)b << 32);
+  }
+#elif defined(__SSE2__)
+  if (n == 64) {
+    __m128i lo = _mm_set1_epi8((char)(minqual - 1));
+    for (; i < 64; i += 16) {
+      uint32_t m = _mm_movemask_epi8(_mm_cmpgt_epi8(_mm_loadu_si128((const __m128i *)(qual + i)), lo));
+      w |= (uint64_t)m << i;
+    }
+    return w;
+  }
+#endif
+  for (; i < n; i++) {
+    if ((int)qual[i] >= minqual) w |= (uint64_t)1 << i;
+  }
+  return w;
+}
+
+inline void qual_runs(uint64_t w, uint64_t next, unsigned int offset, int &first, int &last) {
+
+  // the first and last base of w starting 5 good ones, next holds the bases after w
+  uint64_t r = w & ((w >> 1) | (next << 63)) & ((w >> 2) | (next << 62))
+                 & ((w >> 3) | (next << 61)) & ((w >> 4) | (next << 60));
+  if (r == 0) return;
+  if (first < 0) first = offset + __builtin_ctzll(r);
+  last = offset + 63 - __builtin_clzll(r);
+}
+
+inline bool qual_trim(const char *qual, unsigned int length, int minqual, unsigned int &clipleft, unsigned int &clipright) {
+
+  // bases clipped at either end, true if any
+  int first = -1;
+  int last  = -1;
+  uint64_t prev = 0;
+  unsigned int base = 0;
+  for (; base < length; base += 64) {
+    unsigned int n = (length - base < 64) ? length - base : 64;
+    uint64_t w = qual_word(qual + base, n, minqual);
+    if (base > 0) qual_runs(prev, w, base - 64, first, last);
+    prev = w;
+  }
+  if (base > 0) qual_runs(prev, 0, base - 64, first, last);
+
+  if (first < 0) {                // no run of good bases, all clipped
+    clipleft  = length;
+    clipright = length;
+  }
+  else {
+    clipleft  = first;
+    clipright = length - (last + 5);  // the last run ends at its 5th base, or it would start later
+  }
+  return (clipleft != 0 || clipright != 0);
+}
+
+#endif
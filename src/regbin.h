@@ -0,0 +1,184 @@
+/*
+
+ Copyright (C) 2011 Sun Ruping <rs3412@columbia.edu>
+
+ This file is part of Breakpointer.
+
+ Breakpointer is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License.
+
+ regbin.h: the binary form of the region file (breakpointer --binout). A
+ header carries the run parameters and the reference dictionary of the
+ BAM files, the regions follow as fixed width records of 32 bytes: the
+ reference id, start, end and size, then the average depth, ratios and
+ score as 32 bit floats, as breakpointer has them before printing (the
+ text form rounds them to three decimals). All numbers are little endian,
+ as in BAM. The records start at an 8 byte boundary, so the mapped file
+ is read in place without any parsing; regbin_line writes a record as
+ the line of the text form.
+
+   "BPRB"  magic
+   uint32  version (1)
+   uint32  windowsize, read length (0 variable), unique, reference count
+   per reference: uint32 name length, the name, uint32 reference length
+   zero padding to a multiple of 8
+   records until the end of the file
+
+*/
+
+#ifndef BREAKPOINTER_REGBIN_H
+#define BREAKPOINTER_REGBIN_H
+
+#include <string>
+#include <vector>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define REGBIN_VERSION 1
+
+struct regrec {
+  int32_t refid;
+  uint32_t start;
+  uint32_t end;
+  uint32_t dis;
+  float depth;
+  float ratio1;
+  float ratio2;
+  float score;
+};
+
+//a mapped binary region file
+struct regbin {
+  const char *map;
+  size_t size;
+  unsigned int windowsize;
+  unsigned int readlen;
+  unsigned int unique;
+  std::vector <std::string> names;     // the reference dictionary
+  std::vector <uint32_t> lens;
+  const struct regrec *recs;
+  size_t nrec;
+};
+
+inline void regbin_header(std::string &out, unsigned int windowsize, unsigned int readlen, unsigned int unique,
+                          const std::vector <std::string> &names, const std::vector <uint32_t> &lens);
+inline void regbin_put(std::string &out, uint32_t v);
+inline bool regbin_is(const char *fname);
+inline bool regbin_open(struct regbin &rb, const char *fname);
+inline void regbin_close(struct regbin &rb);
+inline int regbin_line(const struct regbin &rb, const struct regrec &rec, bool exact, char *buf, size_t n);
+inline float regbin_round(float v);
+
+
+inline void regbin_header(std::string &out, unsigned int windowsize, unsigned int readlen, unsigned int unique,
+                          const std::vector <std::string> &names, const std::vector <uint32_t> &lens) {
+  out.append("BPRB", 4);
+  regbin_put(out, REGBIN_VERSION);
+  regbin_put(out, windowsize);
+  regbin_put(out, readlen);
+  regbin_put(out, unique);
+  regbin_put(out, names.size());
+  for (unsigned int r = 0; r < names.size(); r++) {
+    regbin_put(out, names[r].size());
+    out.append(names[r]);
+    regbin_put(out, lens[r]);
+  }
+  while (out.size() % 8 != 0) out.push_back('\0');
+}
+
+inline void regbin_put(std::string &out, uint32_t v) {
+  out.append((const char *)&v, 4);
+}
+
+inline bool regbin_is(const char *fname) {
+  FILE *fp = fopen(fname, "rb");
+  if (fp == NULL) return false;
+  char magic[4];
+  size_t got = fread(magic, 1, 4, fp);
+  fclose(fp);
+  return got == 4 && memcmp(magic, "BPRB", 4) == 0;
+}
+
+inline bool regbin_open(struct regbin &rb, const char *fname) {
+
+  rb.map  = NULL;
+  rb.size = 0;
+  rb.nrec = 0;
+  int fd = open(fname, O_RDONLY);
+  if (fd < 0) return false;
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size < 24) {
+    close(fd);
+    return false;
+  }
+  void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED) return false;
+  madvise(map, st.st_size, MADV_SEQUENTIAL);
+  rb.map  = (const char *)map;
+  rb.size = st.st_size;
+
+  uint32_t head[6];                    // magic, version, windowsize, readlen, unique, references
+  memcpy(head, rb.map, 24);
+  if (memcmp(rb.map, "BPRB", 4) != 0 || head[1] != REGBIN_VERSION) {
+    regbin_close(rb);
+    return false;
+  }
+  rb.windowsize = head[2];
+  rb.readlen    = head[3];
+  rb.unique     = head[4];
+  size_t off = 24;
+  for (uint32_t r = 0; r < head[5]; r++) {
+    uint32_t len;
+    if (off + 4 > rb.size) break;
+    memcpy(&len, rb.map + off, 4);
+    if (off + 8 + len > rb.size) break;
+    rb.names.push_back(std::string(rb.map + off + 4, len));
+    memcpy(&len, rb.map + off + 4 + len, 4);
+    rb.lens.push_back(len);
+    off += 8 + rb.names.back().size();
+  }
+  if (rb.names.size() != head[5]) {    // cut short
+    regbin_close(rb);
+    return false;
+  }
+  off = (off + 7) / 8 * 8;
+  if (off > rb.size) off = rb.size;
+  rb.recs = (const struct regrec *)(rb.map + off);
+  rb.nrec = (rb.size - off) / sizeof(struct regrec);
+  return true;
+}
+
+inline void regbin_close(struct regbin &rb) {
+  if (rb.map != NULL) munmap((void *)rb.map, rb.size);
+  rb.map  = NULL;
+  rb.size = 0;
+  rb.nrec = 0;
+}
+
+inline int regbin_line(const struct regbin &rb, const struct regrec &rec, bool exact, char *buf, size_t n) {
+
+  // the line of the text form (no newline), or with exact the floats as they are
+  const char *chr = (rec.refid >= 0 && (size_t)rec.refid < rb.names.size()) ? rb.names[rec.refid].c_str() : "*";
+  if (exact) {
+    return snprintf(buf, n, "%s\t%d\t%d\t%d\t%.9g\t%.9g\t%.9g\t%.9g", chr, rec.start, rec.end, rec.dis,
+                    rec.depth, rec.ratio1, rec.ratio2, rec.score);
+  }
+  return snprintf(buf, n, "%s\t%d\t%d\t%d\t%.3f\t%.3f\t%.3f\t%.3f", chr, rec.start, rec.end, rec.dis,
+                  rec.depth, rec.ratio1, rec.ratio2, rec.score);
+}
+
+inline float regbin_round(float v) {
+
+  // v as it is read back from its %.3f: the float times 1000 is exact in a double,
+  // rint rounds it half to even as printf does
+  return (float)(rint((double)v * 1000.) / 1000.);
+}
+
+#endif
@@ -0,0 +1,75 @@
+/*
+
+ Copyright (C) 2011 Sun Ruping <rs3412@columbia.edu>
+
+ This file is part of Breakpointer.
+
+ Breakpointer is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License.
+
+ regindex.h: the overlap lookup of breakmis. The regions of one chromosome
+ are kept sorted by start, next to a running maximum of their ends. The
+ regions overlapping [s, e] all sit below the first start > e (binary
+ search), and the walk down from there stops at the first maxend < s, so a
+ read finds its regions in O(log n + hits) for the non-overlapping regions
+ breakpointer writes. Only plain integer arrays are touched per read.
+
+*/
+
+#ifndef BREAKPOINTER_REGINDEX_H
+#define BREAKPOINTER_REGINDEX_H
+
+#include <vector>
+#include <deque>
+#include <algorithm>
+#include "mismatch.h"
+
+struct regindex {
+  std::vector <unsigned int> start;    // region starts, ascending
+  std::vector <unsigned int> end;      // region ends
+  std::vector <unsigned int> maxend;   // maxend[i] = max(end[0..i])
+};
+
+inline bool region_before(const struct region &a, const struct region &b);
+inline void regindex_build(struct regindex &ri, std::deque <struct region> &regions);
+inline void regindex_find(const struct regindex &ri, unsigned int from, unsigned int s, unsigned int e, std::vector <unsigned int> &hits);
+
+
+inline bool region_before(const struct region &a, const struct region &b) {
+  return a.start < b.start;
+}
+
+inline void regindex_build(struct regindex &ri, std::deque <struct region> &regions) {
+
+  // breakpointer writes the regions in order, only sort when they are not
+  unsigned int i = 1;
+  for (; i < regions.size(); i++) {
+    if (regions[i].start < regions[i-1].start) break;
+  }
+  if (i < regions.size()) std::stable_sort(regions.begin(), regions.end(), region_before);
+
+  ri.start.resize(regions.size());
+  ri.end.resize(regions.size());
+  ri.maxend.resize(regions.size());
+  unsigned int maxend = 0;
+  for (i = 0; i < regions.size(); i++) {
+    ri.start[i] = regions[i].start;
+    ri.end[i]   = regions[i].end;
+    if (regions[i].end > maxend) maxend = regions[i].end;
+    ri.maxend[i] = maxend;
+  }
+}
+
+inline void regindex_find(const struct regindex &ri, unsigned int from, unsigned int s, unsigned int e, std::vector <unsigned int> &hits) {
+
+  // the regions with index >= from overlapping [s, e], highest index first
+  hits.clear();
+  unsigned int i = std::upper_bound(ri.start.begin(), ri.start.end(), e) - ri.start.begin();
+  while (i > from) {
+    i--;
+    if (ri.maxend[i] < s) break;       // no region at or below i gets to s
+    if (ri.end[i] >= s) hits.push_back(i);
+  }
+}
+
+#endif
@@ -0,0 +1,76 @@
+/*
+
+ Copyright (C) 2011 Sun Ruping <rs3412@columbia.edu>
+
+ This file is part of Breakpointer.
+
+ Breakpointer is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License.
+
+ seqin.h: the input of a reads file (FASTA or FASTQ) for breakvali, plain,
+ gzip or bgzip. A bgzip file (gzip members with the BC extra field) is
+ inflated through bgzf.h on a pool of threads; plain gzip and plain text
+ go through zlib's gzread, which passes text through as it is. The bytes
+ come out in large pieces, cutting them into lines is left to the caller.
+
+*/
+
+#ifndef BREAKPOINTER_SEQIN_H
+#define BREAKPOINTER_SEQIN_H
+
+#include <string>
+#include <cstdio>
+#include <cstring>
+#include <zlib.h>
+#include "bgzf.h"
+
+struct seqin {
+  bool isbgzf;
+  gzFile gz;                           // plain text or plain gzip
+  struct bgzf bg;
+};
+
+inline bool seqin_open(struct seqin &in, const std::string &fname, unsigned int threads);
+inline void seqin_close(struct seqin &in);
+inline size_t seqin_read(struct seqin &in, char *dest, size_t n);
+inline bool seqin_isbgzf(const std::string &fname);
+
+
+inline bool seqin_open(struct seqin &in, const std::string &fname, unsigned int threads) {
+
+  in.isbgzf = seqin_isbgzf(fname);
+  in.gz = NULL;
+  if (in.isbgzf) return bgzf_open(in.bg, fname, threads);
+
+  in.gz = gzopen(fname.c_str(), "rb");
+  if (in.gz == NULL) return false;
+  gzbuffer(in.gz, 1 << 20);
+  return true;
+}
+
+inline void seqin_close(struct seqin &in) {
+  if (in.isbgzf) bgzf_close(in.bg);
+  else if (in.gz != NULL) gzclose(in.gz);
+}
+
+inline size_t seqin_read(struct seqin &in, char *dest, size_t n) {
+
+  // up to n bytes, 0 at the end of the file
+  if (in.isbgzf) return bgzf_read(in.bg, dest, n);
+  int got = gzread(in.gz, dest, n);
+  return (got > 0) ? got : 0;
+}
+
+inline bool seqin_isbgzf(const std::string &fname) {
+
+  // the gzip header of a BGZF block: FEXTRA set and a BC subfield first
+  FILE *fp = fopen(fname.c_str(), "rb");
+  if (fp == NULL) return false;
+  unsigned char head[16];
+  size_t got = fread(head, 1, 16, fp);
+  fclose(fp);
+  return got == 16 && head[0] == 31 && head[1] == 139 && head[2] == 8 && (head[3] & 4) != 0
+      && head[12] == 66 && head[13] == 67;
+}
+
+#endif
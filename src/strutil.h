@@ -0,0 +1,51 @@
+/*
+
+ Copyright (C) 2011 Sun Ruping <rs3412@columbia.edu>
+
+ This file is part of Breakpointer.
+
+ Breakpointer is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License.
+
+ strutil.h: the small string helpers shared by breakpointer and breakmis.
+
+*/
+
+#ifndef BREAKPOINTER_STRUTIL_H
+#define BREAKPOINTER_STRUTIL_H
+
+#include <string>
+#include <vector>
+#include <sstream>
+
+inline std::string int2str(unsigned int &i);
+inline std::string flo2str(float &f);
+inline void splitstring(const std::string &str, std::vector<std::string> &elements, const std::string &delimiter);
+
+
+inline std::string int2str(unsigned int &i){
+  std::string s;
+  std::stringstream ss(s);
+  ss << i;
+  return ss.str();
+}
+
+inline std::string flo2str(float &f){
+  std::string s;
+  std::stringstream ss(s);
+  ss << f;
+  return ss.str();
+}
+
+inline void splitstring(const std::string &str, std::vector<std::string> &elements, const std::string &delimiter) {
+  std::string::size_type lastPos = str.find_first_not_of(delimiter, 0);
+  std::string::size_type pos     = str.find_first_of(delimiter, lastPos);
+
+  while (std::string::npos != pos || std::string::npos != lastPos) {
+    elements.push_back(str.substr(lastPos, pos - lastPos));
+    lastPos = str.find_first_not_of(delimiter, pos);
+    pos = str.find_first_of(delimiter, lastPos);
+  }
+}
+
+#endif
@@ -0,0 +1,368 @@
+/*
+
+ Copyright (C) 2011 Sun Ruping <rs3412@columbia.edu>
+
+ This file is part of Breakpointer.
+
+ Breakpointer is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License.
+
+ wintrace.h: the window trace of breakpointer (--window-trace), the
+ windows --indiprint prints, in binary. The windows of a reference are
+ collected in blocks of up to WT_BLOCK, column by column: the starts as
+ zigzag varint deltas, the window spans (end - start) and the depth,
+ start and end counts as varints, the scores as doubles. The ratios are
+ not kept, they are worked out again from the counts as breakpointer
+ does, so the text of --indiprint comes back exactly (wt_text).
+
+ A full block is handed to a writer thread, which encodes it and writes
+ it out, the scan only appends to the columns. With --threads the blocks
+ of different references interleave in the file, the blocks of one
+ reference stay in order.
+
+   "BPWT"  magic
+   uint32  version (1), windowsize, read length (0 variable), reference count
+   per reference: uint32 name length, the name, uint32 reference length
+   blocks until the end of the file:
+   uint32  bytes of the block after this, reference id, windows,
+           first start, last start, the byte length of each varint column (5)
+   double  the highest score of the block
+   the five varint columns, then the scores
+
+ The first and last start and the highest score let a reader skip a
+ block without decoding it.
+
+*/
+
+#ifndef BREAKPOINTER_WINTRACE_H
+#define BREAKPOINTER_WINTRACE_H
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <cstdio>
+#include <cstring>
+#include <stdint.h>
+#include <pthread.h>
+#include "outbuf.h"
+
+#define WT_VERSION 1
+#define WT_BLOCK   65536               // windows per block
+#define WT_QUEUE   16                  // blocks waiting for the writer at most
+
+//the windows of a block, column by column
+struct wtblock {
+  int refid;
+  std::vector <uint32_t> start;
+  std::vector <uint32_t> span;         // end - start
+  std::vector <uint32_t> depth;
+  std::vector <uint32_t> deps;
+  std::vector <uint32_t> depe;
+  std::vector <double> score;
+};
+
+struct wtwriter {
+  FILE *fp;
+  std::deque <struct wtblock *> queue;
+  bool stop;
+  unsigned long long windows;
+  unsigned long long bytes;
+  pthread_t thread;
+  pthread_mutex_t lock;
+  pthread_cond_t  more;                // the writer waits for a block
+  pthread_cond_t  room;                // the scans wait for the writer
+};
+
+//a block read back
+struct wtread {
+  int refid;
+  uint32_t windows;
+  uint32_t first;
+  uint32_t last;
+  double maxscore;
+  uint32_t collen[5];                  // bytes of the varint columns
+  uint32_t rest;                       // bytes of the columns and scores
+  struct wtblock block;
+};
+
+struct wtreader {
+  FILE *fp;
+  unsigned int windowsize;
+  unsigned int readlen;
+  std::vector <std::string> names;
+  std::vector <uint32_t> lens;
+  std::string data;                    // the columns of the current block
+};
+
+inline void wt_open(struct wtwriter &wt, FILE *fp, unsigned int windowsize, unsigned int readlen,
+                    const std::vector <std::string> &names, const std::vector <uint32_t> &lens);
+inline void wt_add(struct wtwriter &wt, struct wtblock &b, int refid, unsigned int start, unsigned int end,
+                   unsigned int depth, unsigned int deps, unsigned int depe, double score);
+inline void wt_flush(struct wtwriter &wt, struct wtblock &b);
+inline void wt_close(struct wtwriter &wt);
+inline void *wt_worker(void *arg);
+inline void wt_encode(const struct wtblock &b, std::string &out);
+inline void wt_u32(std::string &out, uint32_t v);
+inline void wt_varint(std::string &out, uint32_t v);
+inline uint32_t wt_getvar(const char *&p, const char *end);
+inline bool wt_readopen(struct wtreader &rd, const char *fname);
+inline bool wt_next(struct wtreader &rd, struct wtread &blk);
+inline bool wt_skip(struct wtreader &rd, struct wtread &blk);
+inline bool wt_columns(struct wtreader &rd, struct wtread &blk);
+inline void wt_text(std::string &s, const std::string &chr, unsigned int start, unsigned int end,
+                    unsigned int depth, unsigned int deps, unsigned int depe, double score);
+
+
+inline void wt_open(struct wtwriter &wt, FILE *fp, unsigned int windowsize, unsigned int readlen,
+                    const std::vector <std::string> &names, const std::vector <uint32_t> &lens) {
+
+  wt.fp = fp;
+  wt.stop = false;
+  wt.windows = 0;
+  wt.bytes = 0;
+  std::string head("BPWT", 4);
+  wt_u32(head, WT_VERSION);
+  wt_u32(head, windowsize);
+  wt_u32(head, readlen);
+  wt_u32(head, names.size());
+  for (unsigned int r = 0; r < names.size(); r++) {
+    wt_u32(head, names[r].size());
+    head.append(names[r]);
+    wt_u32(head, lens[r]);
+  }
+  fwrite(head.data(), 1, head.size(), fp);
+  wt.bytes = head.size();
+
+  pthread_mutex_init(&wt.lock, NULL);
+  pthread_cond_init(&wt.more, NULL);
+  pthread_cond_init(&wt.room, NULL);
+  pthread_create(&wt.thread, NULL, wt_worker, &wt);
+}
+
+inline void wt_add(struct wtwriter &wt, struct wtblock &b, int refid, unsigned int start, unsigned int end,
+                   unsigned int depth, unsigned int deps, unsigned int depe, double score) {
+
+  if (!b.start.empty() && (b.refid != refid || b.start.size() == WT_BLOCK)) wt_flush(wt, b);
+  b.refid = refid;
+  b.start.push_back(start);
+  b.span.push_back(end - start);
+  b.depth.push_back(depth);
+  b.deps.push_back(deps);
+  b.depe.push_back(depe);
+  b.score.push_back(score);
+}
+
+inline void wt_flush(struct wtwriter &wt, struct wtblock &b) {
+
+  // the windows of b go to the writer, b is empty again
+  if (b.start.empty()) return;
+  struct wtblock *full = new struct wtblock;
+  full->refid = b.refid;
+  full->start.swap(b.start);
+  full->span.swap(b.span);
+  full->depth.swap(b.depth);
+  full->deps.swap(b.deps);
+  full->depe.swap(b.depe);
+  full->score.swap(b.score);
+
+  pthread_mutex_lock(&wt.lock);
+  while (wt.queue.size() >= WT_QUEUE) pthread_cond_wait(&wt.room, &wt.lock);
+  wt.queue.push_back(full);
+  pthread_cond_signal(&wt.more);
+  pthread_mutex_unlock(&wt.lock);
+}
+
+inline void wt_close(struct wtwriter &wt) {
+  pthread_mutex_lock(&wt.lock);
+  wt.stop = true;
+  pthread_cond_signal(&wt.more);
+  pthread_mutex_unlock(&wt.lock);
+  pthread_join(wt.thread, NULL);
+  pthread_mutex_destroy(&wt.lock);
+  pthread_cond_destroy(&wt.more);
+  pthread_cond_destroy(&wt.room);
+  fflush(wt.fp);
+}
+
+inline void *wt_worker(void *arg) {
+
+  struct wtwriter &wt = *((struct wtwriter *)arg);
+  std::string out;
+  while (1) {
+    pthread_mutex_lock(&wt.lock);
+    while (wt.queue.empty() && !wt.stop) pthread_cond_wait(&wt.more, &wt.lock);
+    if (wt.queue.empty()) {            // stopped and nothing left
+      pthread_mutex_unlock(&wt.lock);
+      break;
+    }
+    struct wtblock *b = wt.queue.front();
+    wt.queue.pop_front();
+    pthread_cond_broadcast(&wt.room);
+    pthread_mutex_unlock(&wt.lock);
+
+    out.clear();
+    wt_encode(*b, out);
+    fwrite(out.data(), 1, out.size(), wt.fp);
+    wt.windows += b->start.size();
+    wt.bytes   += out.size();
+    delete b;
+  }
+  return NULL;
+}
+
+inline void wt_encode(const struct wtblock &b, std::string &out) {
+
+  std::string cols[5];
+  uint32_t prev = b.start.front();
+  double maxscore = b.score.front();
+  uint32_t last = prev;
+  for (size_t i = 0; i < b.start.size(); i++) {
+    int32_t delta = (int32_t)(b.start[i] - prev);   // ascending, zigzag for safety
+    wt_varint(cols[0], ((uint32_t)delta << 1) ^ (uint32_t)(delta >> 31));
+    prev = b.start[i];
+    if (b.start[i] > last) last = b.start[i];
+    wt_varint(cols[1], b.span[i]);
+    wt_varint(cols[2], b.depth[i]);
+    wt_varint(cols[3], b.deps[i]);
+    wt_varint(cols[4], b.depe[i]);
+    if (b.score[i] > maxscore) maxscore = b.score[i];
+  }
+
+  size_t size = 4 * 9 + 8;
+  for (int c = 0; c < 5; c++) size += cols[c].size();
+  size += 8 * b.score.size();
+
+  wt_u32(out, size);
+  wt_u32(out, b.refid);
+  wt_u32(out, b.start.size());
+  wt_u32(out, b.start.front());
+  wt_u32(out, last);
+  for (int c = 0; c < 5; c++) wt_u32(out, cols[c].size());
+  out.append((const char *)&maxscore, 8);
+  for (int c = 0; c < 5; c++) out.append(cols[c]);
+  out.append((const char *)&b.score[0], 8 * b.score.size());
+}
+
+inline void wt_u32(std::string &out, uint32_t v) {
+  out.append((const char *)&v, 4);
+}
+
+inline void wt_varint(std::string &out, uint32_t v) {
+  while (v >= 0x80) {
+    out.push_back((char)(v | 0x80));
+    v >>= 7;
+  }
+  out.push_back((char)v);
+}
+
+inline uint32_t wt_getvar(const char *&p, const char *end) {
+  uint32_t v = 0;
+  for (int shift = 0; p < end && shift < 35; shift += 7) {
+    unsigned char c = *p++;
+    v |= (uint32_t)(c & 0x7f) << shift;
+    if (c < 0x80) break;
+  }
+  return v;
+}
+
+inline bool wt_readopen(struct wtreader &rd, const char *fname) {
+
+  rd.fp = fopen(fname, "rb");
+  if (rd.fp == NULL) return false;
+  uint32_t head[5];                    // magic, version, windowsize, readlen, references
+  if (fread(head, 4, 5, rd.fp) != 5 || memcmp(head, "BPWT", 4) != 0 || head[1] != WT_VERSION) {
+    fclose(rd.fp);
+    return false;
+  }
+  rd.windowsize = head[2];
+  rd.readlen    = head[3];
+  for (uint32_t r = 0; r < head[4]; r++) {
+    uint32_t len;
+    if (fread(&len, 4, 1, rd.fp) != 1) return false;
+    std::string name(len, '\0');
+    if (len > 0 && fread(&name[0], 1, len, rd.fp) != len) return false;
+    if (fread(&len, 4, 1, rd.fp) != 1) return false;
+    rd.names.push_back(name);
+    rd.lens.push_back(len);
+  }
+  return true;
+}
+
+inline bool wt_next(struct wtreader &rd, struct wtread &blk) {
+
+  // the head of the next block, false at the end of the file;
+  // its columns are taken with wt_columns or passed by wt_skip
+  uint32_t head[10];
+  if (fread(head, 4, 10, rd.fp) != 10) return false;
+  if (fread(&blk.maxscore, 8, 1, rd.fp) != 1) return false;
+  blk.refid   = head[1];
+  blk.windows = head[2];
+  blk.first   = head[3];
+  blk.last    = head[4];
+  for (int c = 0; c < 5; c++) blk.collen[c] = head[5 + c];
+  blk.rest    = head[0] - 4 * 9 - 8;
+  return true;
+}
+
+inline bool wt_skip(struct wtreader &rd, struct wtread &blk) {
+  return fseek(rd.fp, blk.rest, SEEK_CUR) == 0;
+}
+
+inline bool wt_columns(struct wtreader &rd, struct wtread &blk) {
+
+  rd.data.resize(blk.rest);
+  if (blk.rest > 0 && fread(&rd.data[0], 1, blk.rest, rd.fp) != blk.rest) return false;
+  const char *p = rd.data.data();
+  const char *colend = p;
+  struct wtblock &b = blk.block;
+  b.refid = blk.refid;
+  size_t n = blk.windows;
+  std::vector <uint32_t> *cols[5] = {&b.start, &b.span, &b.depth, &b.deps, &b.depe};
+  for (int c = 0; c < 5; c++) {
+    colend += blk.collen[c];
+    cols[c]->resize(n);
+    for (size_t i = 0; i < n; i++) (*cols[c])[i] = wt_getvar(p, colend);
+    p = colend;
+  }
+  uint32_t prev = blk.first;
+  for (size_t i = 0; i < n; i++) {     // the starts back from the zigzag deltas
+    uint32_t z = b.start[i];
+    int32_t delta = (int32_t)(z >> 1) ^ -(int32_t)(z & 1);
+    prev += delta;
+    b.start[i] = prev;
+  }
+  b.score.resize(n);
+  if (n > 0) memcpy(&b.score[0], p, 8 * n);
+  return true;
+}
+
+inline void wt_text(std::string &s, const std::string &chr, unsigned int start, unsigned int end,
+                    unsigned int depth, unsigned int deps, unsigned int depe, double score) {
+
+  // the line --indiprint writes for the window, the ratios as print_endepth works them out
+  float fdepth = depth;
+  float starts = deps;
+  float ends   = depe;
+  float ratio1 = (starts+ends)/fdepth;
+  float ratio2 = starts/(starts+ends);
+  s += chr;
+  s += '\t';
+  out_int(s, (int)start);
+  s += '\t';
+  out_int(s, (int)end);
+  s += '\t';
+  out_int(s, (int)depth);
+  s += '\t';
+  out_int(s, (int)deps);
+  s += '\t';
+  out_int(s, (int)depe);
+  s += '\t';
+  out_fixed(s, ratio1, 3);
+  s += '\t';
+  out_fixed(s, ratio2, 3);
+  s += '\t';
+  out_fixed(s, score, 5);
+  s += '\n';
+}
+
+#endif